@@ -0,0 +1,478 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/mem_config.h"
+
+#define PROGRAM_NAME        "distbench"
+#define PROGRAM_DESCRIPTION "Compare lookup cost, balance and remapping of server distributions."
+#define PROGRAM_VERSION     "1.0"
+
+#define DEFAULT_KEYS        1000000ul
+#define DEFAULT_MAX_SERVERS 256ul
+
+#include "options.hpp"
+#include "time.hpp"
+
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+static unsigned long num_keys = DEFAULT_KEYS;
+static unsigned long max_servers = DEFAULT_MAX_SERVERS;
+
+struct distribution_mode {
+  const char *name;
+  uint64_t distribution;
+};
+
+static const distribution_mode modes[] = {
+    {"modulo-hash", MEMCACHED_DISTRIBUTION_MODULA},
+    {"ketama", MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA},
+    {"jump", MEMCACHED_DISTRIBUTION_JUMP},
+    {"rendezvous", MEMCACHED_DISTRIBUTION_RENDEZVOUS},
+    {"maglev", MEMCACHED_DISTRIBUTION_MAGLEV},
+};
+
+// servers are 10.0.0.1, 10.0.0.2, ...
+static memcached_return_t add_server(memcached_st *memc, unsigned long i) {
+  std::ostringstream host;
+  host << "10.0." << i / 256 << "." << i % 256;
+  return memcached_server_add(memc, host.str().c_str(), 11211);
+}
+
+// a client with servers which are never connected to
+static memcached_st *create_cluster(uint64_t distribution, unsigned long servers) {
+  auto memc = memcached_create(nullptr);
+  if (!memc) {
+    return nullptr;
+  }
+  for (auto i = 1ul; i <= servers; ++i) {
+    if (!memcached_success(add_server(memc, i))) {
+      memcached_free(memc);
+      return nullptr;
+    }
+  }
+  if (!memcached_success(memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_DISTRIBUTION, distribution))) {
+    memcached_free(memc);
+    return nullptr;
+  }
+  return memc;
+}
+
+// ketama client whose servers are pushed at once, so the continuum is built once
+static memcached_st *create_ketama(unsigned long servers) {
+  memcached_server_st *list = nullptr;
+  for (auto i = 1ul; i <= servers; ++i) {
+    std::ostringstream host;
+    host << "10.0." << i / 256 << "." << i % 256;
+    memcached_return_t rc;
+    list = memcached_server_list_append(list, host.str().c_str(), 11211, &rc);
+    if (!memcached_success(rc)) {
+      memcached_server_list_free(list);
+      return nullptr;
+    }
+  }
+  auto memc = memcached_create(nullptr);
+  if (memc
+      && (!memcached_success(memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_DISTRIBUTION,
+                                                    MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA))
+          || !memcached_success(memcached_server_push(memc, list))))
+  {
+    memcached_free(memc);
+    memc = nullptr;
+  }
+  memcached_server_list_free(list);
+  return memc;
+}
+
+// the plain binary search over the continuum which the indexed lookup replaced
+static uint32_t continuum_binary_search(const memcached_st *memc, uint32_t hash) {
+  auto continuum = memc->ketama.continuum;
+  uint32_t left = 0, right = memc->ketama.continuum_points_counter;
+  while (left < right) {
+    auto middle = left + (right - left) / 2;
+    if (continuum[middle].value < hash) {
+      left = middle + 1;
+    } else {
+      right = middle;
+    }
+  }
+  return continuum[right == memc->ketama.continuum_points_counter ? 0 : right].index;
+}
+
+// lookup: ns per memcached_generate_hash(), hash: ns of its key hashing alone,
+// search: lookup - hash, binary_search: ns of the plain search for the same hashes,
+// mismatches: keys the two searches route to different servers (must be 0),
+// build: us to push all servers, add: us to add one more server to the continuum
+static bool continuum_bench(const client_options &opt, const std::vector<std::string> &keys) {
+  std::cout << std::fixed << std::setprecision(3)
+            << "servers,points,lookup_ns,hash_ns,search_ns,binary_search_ns,mismatches,build_us,"
+               "add_us\n";
+
+  std::vector<uint32_t> hashes(keys.size()), servers_of(keys.size());
+  auto failed = false;
+  for (auto servers : {100ul, 1000ul, 10000ul}) {
+    auto start = time_clock::now();
+    auto memc = create_ketama(servers);
+    auto build = time_clock::now() - start;
+    if (!memc) {
+      if (!opt.isset("quiet")) {
+        std::cerr << "Failed to set up ketama with " << servers << " servers.\n";
+      }
+      return false;
+    }
+
+    start = time_clock::now();
+    for (auto i = 0ul; i < keys.size(); ++i) {
+      servers_of[i] = memcached_generate_hash(memc, keys[i].data(), keys[i].size());
+    }
+    auto lookup = time_clock::now() - start;
+
+    auto hashkit = memcached_get_hashkit(memc);
+    start = time_clock::now();
+    for (auto i = 0ul; i < keys.size(); ++i) {
+      hashes[i] = hashkit_digest(hashkit, keys[i].data(), keys[i].size());
+    }
+    auto hash = time_clock::now() - start;
+
+    auto mismatches = 0ul;
+    start = time_clock::now();
+    for (auto i = 0ul; i < keys.size(); ++i) {
+      if (continuum_binary_search(memc, hashes[i]) != servers_of[i]) {
+        ++mismatches;
+      }
+    }
+    auto search = time_clock::now() - start;
+
+    auto points = memc->ketama.continuum_points_counter;
+    start = time_clock::now();
+    if (!memcached_success(add_server(memc, servers + 1))) {
+      if (!opt.isset("quiet")) {
+        std::cerr << "Failed to grow ketama to " << servers + 1 << " servers.\n";
+      }
+      memcached_free(memc);
+      return false;
+    }
+    auto add = time_clock::now() - start;
+
+    auto per_key = [&keys](time_clock::duration d) {
+      return time_format_ns(d).count() / double(keys.size());
+    };
+    std::cout << servers << "," << points << "," << per_key(lookup) << "," << per_key(hash) << ","
+              << per_key(lookup) - per_key(hash) << "," << per_key(search) << "," << mismatches
+              << "," << time_format_us(build).count() << "," << time_format_us(add).count()
+              << "\n";
+    failed = failed || mismatches;
+
+    memcached_free(memc);
+  }
+
+  return !failed;
+}
+
+// single: ns per key of memcached_generate_hash() called for every key of the batch,
+// batch: ns per key of memcached_generate_hash_batch(), speedup: single / batch,
+// mismatches: keys the two route to different servers (must be 0)
+static bool batch_bench(const client_options &opt, const std::vector<std::string> &keys) {
+  std::cout << std::fixed << std::setprecision(3)
+            << "mode,namespace,batch,single_ns,batch_ns,speedup,mismatches\n";
+
+  std::vector<const char *> key_ptr(keys.size());
+  std::vector<size_t> key_length(keys.size());
+  for (auto i = 0ul; i < keys.size(); ++i) {
+    key_ptr[i] = keys[i].data();
+    key_length[i] = keys[i].size();
+  }
+
+  std::vector<uint32_t> single(keys.size()), batched(keys.size());
+  auto failed = false;
+  for (const auto &mode : {modes[0], modes[1]}) {
+    for (auto with_namespace : {false, true}) {
+      auto memc = create_cluster(mode.distribution, 64);
+      if (memc && with_namespace
+          && (!memcached_success(memcached_callback_set(memc, MEMCACHED_CALLBACK_NAMESPACE,
+                                                        "distbench:"))
+              || !memcached_success(
+                  memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_HASH_WITH_PREFIX_KEY, 1))))
+      {
+        memcached_free(memc);
+        memc = nullptr;
+      }
+      if (!memc) {
+        if (!opt.isset("quiet")) {
+          std::cerr << "Failed to set up " << mode.name << " with 64 servers.\n";
+        }
+        return false;
+      }
+
+      for (auto batch = 16ul; batch <= 1024ul; batch *= 2) {
+        auto count = keys.size() / batch * batch;
+
+        auto start = time_clock::now();
+        for (auto i = 0ul; i < count; ++i) {
+          single[i] = memcached_generate_hash(memc, key_ptr[i], key_length[i]);
+        }
+        auto one = time_clock::now() - start;
+
+        start = time_clock::now();
+        for (auto i = 0ul; i < count; i += batch) {
+          memcached_generate_hash_batch(memc, &key_ptr[i], &key_length[i], batch, &batched[i]);
+        }
+        auto all = time_clock::now() - start;
+
+        auto mismatches = 0ul;
+        for (auto i = 0ul; i < count; ++i) {
+          if (single[i] != batched[i]) {
+            ++mismatches;
+          }
+        }
+
+        auto single_ns = time_format_ns(one).count() / double(count);
+        auto batch_ns = time_format_ns(all).count() / double(count);
+        std::cout << mode.name << "," << with_namespace << "," << batch << "," << single_ns << ","
+                  << batch_ns << "," << single_ns / batch_ns << "," << mismatches << "\n";
+        failed = failed || mismatches;
+      }
+
+      memcached_free(memc);
+    }
+  }
+
+  return !failed;
+}
+
+// the character loops and strtoul() which memcached_scan_value_header() replaced
+static bool legacy_value_header(const char *line, memcached_value_header_st &header) {
+  const char *ptr = line + 6, *next;
+  header.key = ptr;
+  for (; !(iscntrl(*ptr) || isspace(*ptr)); ptr++) {
+  }
+  header.key_length = size_t(ptr - header.key);
+  ptr++;
+  for (next = ptr; isdigit(*ptr); ptr++) {
+  }
+  errno = 0;
+  header.flags = uint32_t(strtoul(next, const_cast<char **>(&ptr), 10));
+  ptr++;
+  for (next = ptr; isdigit(*ptr); ptr++) {
+  }
+  header.value_length = strtoull(next, const_cast<char **>(&ptr), 10);
+  header.cas = 0;
+  if (*ptr != '\r') {
+    ptr++;
+    for (next = ptr; isdigit(*ptr); ptr++) {
+    }
+    header.cas = strtoull(next, const_cast<char **>(&ptr), 10);
+  }
+  return errno == 0;
+}
+
+// ns: per header line, mismatches: generated lines parsed to other values, and for vector, also
+// randomly damaged lines which it and the scalar parser judge differently (must be 0)
+static bool parse_bench(const std::vector<std::string> &keys) {
+  std::cout << std::fixed << std::setprecision(3) << "parser,lines,ns,mismatches\n";
+
+  std::mt19937_64 random(keys.size());
+  std::vector<std::string> lines(keys.size()), damaged(keys.size());
+  std::vector<memcached_value_header_st> expected(keys.size());
+  for (auto i = 0ul; i < keys.size(); ++i) {
+    auto &header = expected[i];
+    header.flags = random() % 4 ? 0 : uint32_t(random());
+    header.value_length = random() % 4 ? 48 : random() >> (random() % 64);
+    header.cas = random() % 2 ? random() >> (random() % 64) : 0;
+    std::ostringstream line;
+    line << "VALUE " << keys[i] << " " << header.flags << " " << header.value_length;
+    if (header.cas) {
+      line << " " << header.cas;
+    }
+    line << "\r\n";
+    lines[i] = line.str();
+    header.key = lines[i].data() + 6;
+    header.key_length = keys[i].size();
+
+    damaged[i] = lines[i];
+    auto pos = random() % damaged[i].size();
+    switch (random() % 3) {
+    case 0:
+      damaged[i][pos] = char(random());
+      break;
+    case 1:
+      damaged[i].resize(pos);
+      break;
+    default:
+      damaged[i].insert(pos, 1 + random() % 24, char('0' + random() % 10));
+    }
+  }
+
+  auto same = [](const memcached_value_header_st &a, const memcached_value_header_st &b) {
+    return a.key == b.key && a.key_length == b.key_length && a.flags == b.flags
+        && a.value_length == b.value_length && a.cas == b.cas;
+  };
+
+  std::vector<memcached_value_header_st> parsed(keys.size());
+  auto failed = false;
+  auto report = [&](const char *parser, time_clock::duration elapsed, unsigned long mismatches) {
+    for (auto i = 0ul; i < keys.size(); ++i) {
+      if (!same(parsed[i], expected[i])) {
+        ++mismatches;
+      }
+    }
+    std::cout << parser << "," << keys.size() << ","
+              << time_format_ns(elapsed).count() / double(keys.size()) << "," << mismatches
+              << "\n";
+    failed = failed || mismatches;
+  };
+
+  auto start = time_clock::now();
+  for (auto i = 0ul; i < keys.size(); ++i) {
+    legacy_value_header(lines[i].data(), parsed[i]);
+  }
+  report("legacy", time_clock::now() - start, 0);
+
+  start = time_clock::now();
+  for (auto i = 0ul; i < keys.size(); ++i) {
+    memcached_scan_value_header<false>(lines[i].data(), lines[i].size(), parsed[i]);
+  }
+  report("scalar", time_clock::now() - start, 0);
+
+  start = time_clock::now();
+  for (auto i = 0ul; i < keys.size(); ++i) {
+    memcached_scan_value_header<true>(lines[i].data(), lines[i].size(), parsed[i]);
+  }
+  auto elapsed = time_clock::now() - start;
+
+  auto disagree = 0ul;
+  for (const auto &line : damaged) {
+    memcached_value_header_st scalar{}, vector{};
+    bool scalar_ok = memcached_scan_value_header<false>(line.data(), line.size(), scalar);
+    bool vector_ok = memcached_scan_value_header<true>(line.data(), line.size(), vector);
+    if (scalar_ok != vector_ok || (scalar_ok && !same(scalar, vector))) {
+      ++disagree;
+    }
+  }
+  report("vector", elapsed, disagree);
+
+  return !failed;
+}
+
+int main(int argc, char *argv[]) {
+  client_options opt{PROGRAM_NAME, PROGRAM_VERSION, PROGRAM_DESCRIPTION};
+
+  for (const auto &def : opt.defaults) {
+    // parse() looks up "debug"
+    if (!strcmp(def.opt.name, "help") || !strcmp(def.opt.name, "version")
+        || !strcmp(def.opt.name, "quiet") || !strcmp(def.opt.name, "debug")) {
+      opt.add(def);
+    }
+  }
+  opt.add("keys", 'k', required_argument, "Number of keys to route (default: 1000000).");
+  opt.add("max-servers", 'S', required_argument,
+          "Largest cluster, sizes double from 2 (default: 256).");
+  opt.add("continuum", 'c', no_argument,
+          "Compare the indexed ketama continuum search with a binary search instead.");
+  opt.add("batch", 'b', no_argument,
+          "Compare routing multi-get batches of 16 to 1024 keys at once with key by key instead.");
+  opt.add("parse", 'p', no_argument,
+          "Compare parsing VALUE response lines with SIMD and SWAR, scalar and with strtoul()"
+          "\n\t\tinstead.");
+
+  if (!opt.parse(argc, argv)) {
+    exit(EXIT_FAILURE);
+  }
+  if (opt.isset("keys")) {
+    num_keys = std::stoul(opt.argof("keys"));
+  }
+  if (opt.isset("max-servers")) {
+    max_servers = std::stoul(opt.argof("max-servers"));
+  }
+
+  std::vector<std::string> keys(num_keys);
+  for (auto i = 0ul; i < num_keys; ++i) {
+    std::ostringstream oss;
+    oss << "KEY_" << std::setfill('0') << std::setw(11) << i;
+    keys[i] = oss.str();
+  }
+
+  if (opt.isset("continuum")) {
+    exit(continuum_bench(opt, keys) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  if (opt.isset("batch")) {
+    exit(batch_bench(opt, keys) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  if (opt.isset("parse")) {
+    exit(parse_bench(keys) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  // lookup: ns per memcached_generate_hash(), balance: busiest server / average,
+  // remapped: share of keys that move when one server is added (ideal: 1/(n+1)),
+  // rebuild: us to add that server, including the rebuild of the distribution
+  std::cout << std::fixed << std::setprecision(3)
+            << "mode,servers,lookup_ns,balance,remapped,ideal_remapped,rebuild_us\n";
+
+  std::vector<uint32_t> before(num_keys);
+  for (const auto &mode : modes) {
+    for (auto servers = 2ul; servers <= max_servers; servers *= 2) {
+      auto memc = create_cluster(mode.distribution, servers);
+      if (!memc) {
+        if (!opt.isset("quiet")) {
+          std::cerr << "Failed to set up " << mode.name << " with " << servers << " servers.\n";
+        }
+        exit(EXIT_FAILURE);
+      }
+
+      std::vector<uint64_t> load(servers);
+      auto start = time_clock::now();
+      for (auto i = 0ul; i < num_keys; ++i) {
+        before[i] = memcached_generate_hash(memc, keys[i].data(), keys[i].size());
+      }
+      auto elapsed = time_clock::now() - start;
+
+      for (auto i = 0ul; i < num_keys; ++i) {
+        ++load[before[i]];
+      }
+      uint64_t busiest = 0;
+      for (auto l : load) {
+        busiest = std::max(busiest, l);
+      }
+
+      start = time_clock::now();
+      if (!memcached_success(add_server(memc, servers + 1))) {
+        if (!opt.isset("quiet")) {
+          std::cerr << "Failed to grow " << mode.name << " to " << servers + 1 << " servers.\n";
+        }
+        exit(EXIT_FAILURE);
+      }
+      auto rebuild = time_clock::now() - start;
+
+      auto moved = 0ul;
+      for (auto i = 0ul; i < num_keys; ++i) {
+        if (memcached_generate_hash(memc, keys[i].data(), keys[i].size()) != before[i]) {
+          ++moved;
+        }
+      }
+
+      std::cout << mode.name << "," << servers << ","
+                << time_format_ns(elapsed).count() / double(num_keys) << ","
+                << double(busiest) * double(servers) / double(num_keys) << ","
+                << double(moved) / double(num_keys) << "," << 1.0 / double(servers + 1) << ","
+                << time_format_us(rebuild).count() << "\n";
+
+      memcached_free(memc);
+    }
+  }
+
+  exit(EXIT_SUCCESS);
+}
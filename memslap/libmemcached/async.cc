@@ -0,0 +1,661 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/common.h"
+#include "libmemcached/string.hpp"
+#include "p9y/clock_gettime.hpp"
+#include "p9y/poll.hpp"
+
+/* Connections waited for per memcached_async_poll(), the others in later calls */
+#define ASYNC_POLL_SERVERS 100
+
+static uint32_t async_depth(const memcached_extension_st *extension) {
+  return extension->async.depth ? extension->async.depth : MEMCACHED_ASYNC_DEPTH_DEFAULT;
+}
+
+static int64_t async_clock() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return int64_t(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+/* Takes the request at index from the ring of instance, and runs the callback for it */
+static void async_complete(memcached_instance_st *instance, uint32_t index,
+                           memcached_async_result_st &result) {
+  memcached_extension_st *extension = memcached_extension(instance->root);
+  memcached_async_slot_st *slots = instance->async.slots;
+  uint32_t size = instance->async.size;
+
+  memcached_async_slot_st slot = slots[(instance->async.head + index) % size];
+  // responses out of order close the gap from the oldest end
+  for (uint32_t x = index; x > 0; --x) {
+    slots[(instance->async.head + x) % size] = slots[(instance->async.head + x - 1) % size];
+  }
+  instance->async.head = (instance->async.head + 1) % size;
+  instance->async.count--;
+  instance->async.since = 0;
+  extension->async.pending--;
+  extension->async.completed++;
+
+  result.op = slot.op;
+  result.user_data = slot.user_data;
+  extension->async.callback(instance->root, &result, extension->async.context);
+}
+
+/* Completes every request of instance with rc, after its connection failed */
+static void async_fail(memcached_instance_st *instance, memcached_return_t rc) {
+  while (instance->async.count) {
+    memcached_async_result_st result = {};
+    result.rc = rc;
+    async_complete(instance, 0, result);
+  }
+}
+
+void memcached_async_release(memcached_instance_st *instance) {
+  if (instance->async.count) {
+    if (memcached_extension_st *extension = memcached_extension(instance->root)) {
+      extension->async.pending -= instance->async.count;
+    }
+  }
+  libmemcached_free(instance->root, instance->async.slots);
+  instance->async.slots = NULL;
+  instance->async.size = 0;
+  instance->async.head = 0;
+  instance->async.count = 0;
+  instance->async.since = 0;
+}
+
+static bool async_find(const memcached_instance_st *instance, uint32_t opaque, uint32_t &index) {
+  for (index = 0; index < instance->async.count; ++index) {
+    if (instance->async.slots[(instance->async.head + index) % instance->async.size].opaque
+        == opaque) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static memcached_return_t async_skip(memcached_instance_st *instance, size_t length) {
+  char hole[SMALL_STRING_LEN];
+  while (length) {
+    size_t nr = length > sizeof(hole) ? sizeof(hole) : length;
+    memcached_return_t rc = memcached_safe_read(instance, hole, nr);
+    if (memcached_failed(rc)) {
+      return rc;
+    }
+    length -= nr;
+  }
+  return MEMCACHED_SUCCESS;
+}
+
+/* Reads a value, and the trailing bytes after it, into the result of the handle */
+static memcached_return_t async_read_value(memcached_instance_st *instance, size_t length,
+                                           size_t trailing, memcached_async_result_st &result) {
+  Memcached *root = instance->root;
+  memcached_result_st *value = &root->result;
+  memcached_result_reset(value);
+  value->item_flags = result.flags;
+
+  memcached_return_t rc;
+  if (memcached_is_compressed(root, result.flags)) {
+    char *buffer = memcached_compression_buffer(root, length + trailing);
+    if (buffer == NULL) {
+      return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+    if (memcached_failed(rc = memcached_safe_read(instance, buffer, length + trailing))) {
+      return rc;
+    }
+    // a value that fails to inflate is reported, the connection is fine
+    result.rc = memcached_decompress(instance, buffer, length, value);
+  } else {
+    if (memcached_failed(memcached_string_check(&value->value, length + trailing))) {
+      return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+    char *buffer = memcached_string_value_mutable(&value->value);
+    if (memcached_failed(rc = memcached_safe_read(instance, buffer, length + trailing))) {
+      return rc;
+    }
+    memcached_string_set_length(&value->value, length);
+  }
+
+  result.value = memcached_result_value(value);
+  result.value_length = memcached_result_length(value);
+  result.flags = value->item_flags;
+  return MEMCACHED_SUCCESS;
+}
+
+static memcached_return_t async_binary_status(uint16_t status) {
+  switch (status) {
+  case PROTOCOL_BINARY_RESPONSE_SUCCESS:
+    return MEMCACHED_SUCCESS;
+
+  case PROTOCOL_BINARY_RESPONSE_KEY_ENOENT:
+    return MEMCACHED_NOTFOUND;
+
+  case PROTOCOL_BINARY_RESPONSE_KEY_EEXISTS:
+    return MEMCACHED_DATA_EXISTS;
+
+  case PROTOCOL_BINARY_RESPONSE_NOT_STORED:
+    return MEMCACHED_NOTSTORED;
+
+  case PROTOCOL_BINARY_RESPONSE_E2BIG:
+    return MEMCACHED_E2BIG;
+
+  case PROTOCOL_BINARY_RESPONSE_ENOMEM:
+    return MEMCACHED_SERVER_MEMORY_ALLOCATION_FAILURE;
+
+  default:
+    return MEMCACHED_SERVER_ERROR;
+  }
+}
+
+static memcached_return_t async_read_binary(memcached_instance_st *instance) {
+  protocol_binary_response_header header;
+  memcached_return_t rc;
+  if (memcached_failed(rc = memcached_safe_read(instance, &header.bytes, sizeof(header.bytes)))) {
+    return rc;
+  }
+  if (header.response.magic != PROTOCOL_BINARY_RES) {
+    return memcached_set_error(*instance, MEMCACHED_UNKNOWN_READ_FAILURE, MEMCACHED_AT);
+  }
+
+  uint16_t keylen = ntohs(header.response.keylen);
+  uint16_t status = ntohs(header.response.status);
+  uint32_t bodylen = ntohl(header.response.bodylen);
+  uint32_t index;
+  if (async_find(instance, ntohl(header.response.opaque), index) == false
+      or bodylen < uint32_t(header.response.extlen) + keylen)
+  {
+    return memcached_set_error(*instance, MEMCACHED_UNKNOWN_READ_FAILURE, MEMCACHED_AT,
+                               memcached_literal_param("Response to no request in flight"));
+  }
+
+  memcached_async_result_st result = {};
+  result.rc = async_binary_status(status);
+  result.cas = memcached_ntohll(header.response.cas);
+  if (status == PROTOCOL_BINARY_RESPONSE_SUCCESS and header.response.extlen >= sizeof(uint32_t)) {
+    uint32_t flags;
+    if (memcached_failed(rc = memcached_safe_read(instance, &flags, sizeof(flags)))
+        or memcached_failed(
+            rc = async_skip(instance, header.response.extlen - sizeof(flags) + keylen)))
+    {
+      return rc;
+    }
+    result.flags = ntohl(flags);
+    if (memcached_failed(rc = async_read_value(
+                             instance, bodylen - header.response.extlen - keylen, 0, result)))
+    {
+      return rc;
+    }
+  } else if (memcached_failed(rc = async_skip(instance, bodylen))) {
+    return rc;
+  }
+
+  async_complete(instance, index, result);
+  return MEMCACHED_SUCCESS;
+}
+
+static memcached_return_t async_read_meta(memcached_instance_st *instance) {
+  char buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
+  size_t total_read;
+  memcached_return_t rc = memcached_io_readline(instance, buffer, sizeof(buffer), total_read);
+  if (memcached_failed(rc)) {
+    return rc;
+  }
+
+  memcached_value_header_st header;
+  bool value = total_read >= 3 and buffer[0] == 'V' and buffer[1] == 'A';
+  bool parsed = value ? memcached_scan_meta_header<true>(buffer, total_read, header)
+                      : memcached_scan_meta_status<true>(buffer, total_read, header);
+
+  // errors carry no opaque, and answer the oldest request as the server keeps the order
+  uint32_t index = 0;
+  if (parsed and header.opaque) {
+    const char *ptr = header.opaque;
+    const char *end = header.opaque + header.opaque_length;
+    uint64_t opaque;
+    if (memcached_scan_uint<true>(ptr, end, opaque) == false or ptr != end
+        or async_find(instance, uint32_t(opaque), index) == false)
+    {
+      return memcached_set_error(*instance, MEMCACHED_UNKNOWN_READ_FAILURE, MEMCACHED_AT,
+                                 memcached_literal_param("Response to no request in flight"));
+    }
+  }
+
+  memcached_async_result_st result = {};
+  if (parsed) {
+    result.flags = header.flags;
+    result.cas = header.cas;
+    if (value) {
+      result.rc = MEMCACHED_SUCCESS;
+      if (memcached_failed(rc = async_read_value(instance, size_t(header.value_length), 2, result)))
+      {
+        return rc;
+      }
+    } else if (buffer[0] == 'H' and buffer[1] == 'D') {
+      result.rc = MEMCACHED_SUCCESS;
+    } else if ((buffer[0] == 'E' and buffer[1] == 'N') or (buffer[0] == 'N' and buffer[1] == 'F')) {
+      result.rc = MEMCACHED_NOTFOUND;
+    } else if (buffer[0] == 'N' and buffer[1] == 'S') {
+      result.rc = MEMCACHED_NOTSTORED;
+    } else if (buffer[0] == 'E' and buffer[1] == 'X') {
+      result.rc = MEMCACHED_DATA_EXISTS;
+    } else {
+      result.rc = MEMCACHED_SERVER_ERROR;
+    }
+  } else if (total_read >= memcached_literal_param_size("SERVER_ERROR")
+             and memcmp(buffer, memcached_literal_param("SERVER_ERROR")) == 0)
+  {
+    result.rc = MEMCACHED_SERVER_ERROR;
+  } else if (total_read >= memcached_literal_param_size("CLIENT_ERROR")
+             and memcmp(buffer, memcached_literal_param("CLIENT_ERROR")) == 0)
+  {
+    result.rc = MEMCACHED_CLIENT_ERROR;
+  } else if (total_read >= memcached_literal_param_size("ERROR")
+             and memcmp(buffer, memcached_literal_param("ERROR")) == 0)
+  {
+    result.rc = MEMCACHED_ERROR;
+  } else {
+    return memcached_set_error(*instance, MEMCACHED_UNKNOWN_READ_FAILURE, MEMCACHED_AT);
+  }
+
+  async_complete(instance, index, result);
+  return MEMCACHED_SUCCESS;
+}
+
+/* Completes one request of instance, or all of them with the error of a failed read */
+static memcached_return_t async_read_one(memcached_instance_st *instance) {
+  memcached_return_t rc = memcached_is_binary(instance->root) ? async_read_binary(instance)
+                                                                : async_read_meta(instance);
+  if (memcached_failed(rc)) {
+    memcached_io_reset(instance);
+    async_fail(instance, rc);
+  }
+  return rc;
+}
+
+static memcached_return_t async_send_binary(memcached_instance_st *instance,
+                                            memcached_async_op_t op, const char *key,
+                                            size_t key_length, const char *value,
+                                            size_t value_length, time_t expiration,
+                                            uint32_t flags, uint32_t &opaque) {
+  Memcached *ptr = instance->root;
+  protocol_binary_request_set request = {};
+  size_t send_length = sizeof(request.message.header);
+
+  initialize_binary_request(instance, request.message.header);
+  opaque = instance->request_id;
+  request.message.header.request.opaque = htonl(opaque);
+  request.message.header.request.keylen =
+      htons(uint16_t(key_length + memcached_array_size(ptr->_namespace)));
+  request.message.header.request.datatype = PROTOCOL_BINARY_RAW_BYTES;
+  switch (op) {
+  case MEMCACHED_ASYNC_GET:
+    request.message.header.request.opcode = PROTOCOL_BINARY_CMD_GET;
+    break;
+
+  case MEMCACHED_ASYNC_SET:
+    request.message.header.request.opcode = PROTOCOL_BINARY_CMD_SET;
+    request.message.header.request.extlen = 8;
+    request.message.body.flags = htonl(flags);
+    request.message.body.expiration = htonl(uint32_t(expiration));
+    send_length = sizeof(request.bytes);
+    break;
+
+  case MEMCACHED_ASYNC_DELETE:
+    request.message.header.request.opcode = PROTOCOL_BINARY_CMD_DELETE;
+    break;
+  }
+  request.message.header.request.bodylen =
+      htonl(uint32_t(key_length + memcached_array_size(ptr->_namespace) + value_length
+                     + request.message.header.request.extlen));
+
+  libmemcached_io_vector_st vector[] = {
+      {NULL, 0},
+      {request.bytes, send_length},
+      {memcached_array_string(ptr->_namespace), memcached_array_size(ptr->_namespace)},
+      {key, key_length},
+      {value, value_length}};
+
+  return memcached_vdo(instance, vector, 5, false);
+}
+
+static memcached_return_t async_send_meta(memcached_instance_st *instance,
+                                          memcached_async_op_t op, const char *key,
+                                          size_t key_length, const char *value,
+                                          size_t value_length, time_t expiration,
+                                          uint32_t flags, uint32_t &opaque) {
+  Memcached *ptr = instance->root;
+  opaque = ++instance->request_id;
+
+  char buffer[4 * (MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH + 3) + 16];
+  int length;
+  const char *command;
+  switch (op) {
+  case MEMCACHED_ASYNC_GET:
+    command = "mg ";
+    length = snprintf(buffer, sizeof(buffer), " v f O%" PRIu32 "%s\r\n", opaque,
+                      ptr->flags.support_cas ? " c" : "");
+    break;
+
+  case MEMCACHED_ASYNC_SET:
+    command = "ms ";
+    length = snprintf(buffer, sizeof(buffer), " %llu F%" PRIu32 " T%lld O%" PRIu32 "\r\n",
+                      (unsigned long long) value_length, flags, (long long) expiration, opaque);
+    break;
+
+  case MEMCACHED_ASYNC_DELETE:
+  default:
+    command = "md ";
+    length = snprintf(buffer, sizeof(buffer), " O%" PRIu32 "\r\n", opaque);
+    break;
+  }
+  if (size_t(length) >= sizeof(buffer) or length < 0) {
+    return memcached_set_error(
+        *instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT,
+        memcached_literal_param("snprintf(MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH)"));
+  }
+
+  libmemcached_io_vector_st vector[] = {
+      {NULL, 0},
+      {command, 3},
+      {memcached_array_string(ptr->_namespace), memcached_array_size(ptr->_namespace)},
+      {key, key_length},
+      {buffer, size_t(length)},
+      {value, value_length},
+      {"\r\n", size_t(op == MEMCACHED_ASYNC_SET ? 2 : 0)}};
+
+  return memcached_vdo(instance, vector, 7, false);
+}
+
+static memcached_return_t async_submit(memcached_st *shell, memcached_async_op_t op,
+                                       const char *key, size_t key_length, const char *value,
+                                       size_t value_length, time_t expiration, uint32_t flags,
+                                       void *user_data) {
+  Memcached *ptr = memcached2Memcached(shell);
+  memcached_return_t rc;
+  if (memcached_failed(rc = initialize_query(ptr, true))) {
+    return rc;
+  }
+
+  if (memcached_is_udp(ptr)
+      or (memcached_is_binary(ptr) == false and memcached_is_meta(ptr) == false))
+  {
+    return memcached_set_error(
+        *ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+        memcached_literal_param("Asynchronous requests need the binary or meta protocol over TCP"));
+  }
+  if (memcached_is_encrypted(ptr)) {
+    return memcached_set_error(
+        *ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+        memcached_literal_param("Operation not allowed while encryption is enabled"));
+  }
+
+  memcached_extension_st *extension = memcached_extension(ptr);
+  if (extension == NULL or extension->async.callback == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("No memcached_async_set_callback()"));
+  }
+
+  if (memcached_failed(rc = memcached_key_test(*ptr, (const char **) &key, &key_length, 1))) {
+    return memcached_last_error(ptr);
+  }
+
+  if (op == MEMCACHED_ASYNC_SET
+      and memcached_failed(rc = memcached_compress(ptr, value, value_length, flags)))
+  {
+    return rc;
+  }
+
+  uint32_t server_key = memcached_generate_hash_with_redistribution(ptr, key, key_length);
+  memcached_instance_st *instance = memcached_instance_fetch(ptr, server_key);
+
+  // the responses of a closed connection are not coming
+  if (instance->async.count and instance->fd == INVALID_SOCKET) {
+    async_fail(instance, MEMCACHED_CONNECTION_FAILURE);
+  }
+
+  if (instance->async.count == 0 and instance->async.size != async_depth(extension)) {
+    memcached_async_slot_st *slots = libmemcached_xrealloc(
+        ptr, instance->async.slots, async_depth(extension), memcached_async_slot_st);
+    if (slots == NULL) {
+      return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+    instance->async.slots = slots;
+    instance->async.size = async_depth(extension);
+    instance->async.head = 0;
+  }
+
+  // a full connection completes its oldest requests first
+  while (instance->async.count == instance->async.size) {
+    extension->async.waits++;
+    if (instance->write_buffer_offset and memcached_io_write(instance) == false) {
+      memcached_io_reset(instance);
+      async_fail(instance, MEMCACHED_WRITE_FAILURE);
+      break;
+    }
+    if (memcached_failed(async_read_one(instance))) {
+      break;
+    }
+  }
+
+  uint32_t opaque;
+  if (memcached_is_binary(ptr)) {
+    rc = async_send_binary(instance, op, key, key_length, value, value_length, expiration, flags,
+                           opaque);
+  } else {
+    rc = async_send_meta(instance, op, key, key_length, value, value_length, expiration, flags,
+                         opaque);
+  }
+  if (memcached_failed(rc)) {
+    // the connection was reset
+    async_fail(instance, rc);
+    return rc;
+  }
+  // the response is completed here rather than by memcached_response()
+  if (memcached_is_replying(ptr)) {
+    memcached_server_response_decrement(instance);
+  }
+
+  memcached_async_slot_st &slot =
+      instance->async.slots[(instance->async.head + instance->async.count) % instance->async.size];
+  slot.opaque = opaque;
+  slot.op = op;
+  slot.user_data = user_data;
+  if (instance->async.count == 0) {
+    instance->async.since = 0;
+  }
+  instance->async.count++;
+  extension->async.pending++;
+  extension->async.submitted++;
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_async_set_callback(memcached_st *shell, memcached_async_fn callback,
+                                                void *context) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  extension->async.callback = callback;
+  extension->async.context = context;
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_async_set_depth(memcached_st *shell, uint32_t depth) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL or depth == 0) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  extension->async.depth = depth;
+
+  return MEMCACHED_SUCCESS;
+}
+
+uint32_t memcached_async_get_depth(const memcached_st *shell) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      return async_depth(extension);
+    }
+  }
+
+  return MEMCACHED_ASYNC_DEPTH_DEFAULT;
+}
+
+memcached_return_t memcached_async_get(memcached_st *ptr, const char *key, size_t key_length,
+                                       void *user_data) {
+  return async_submit(ptr, MEMCACHED_ASYNC_GET, key, key_length, NULL, 0, 0, 0, user_data);
+}
+
+memcached_return_t memcached_async_set(memcached_st *ptr, const char *key, size_t key_length,
+                                       const char *value, size_t value_length, time_t expiration,
+                                       uint32_t flags, void *user_data) {
+  return async_submit(ptr, MEMCACHED_ASYNC_SET, key, key_length, value, value_length, expiration,
+                      flags, user_data);
+}
+
+memcached_return_t memcached_async_delete(memcached_st *ptr, const char *key, size_t key_length,
+                                          void *user_data) {
+  return async_submit(ptr, MEMCACHED_ASYNC_DELETE, key, key_length, NULL, 0, 0, 0, user_data);
+}
+
+memcached_return_t memcached_async_poll(memcached_st *shell, int timeout, uint32_t *completed) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (completed) {
+    *completed = 0;
+  }
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_extension_st *extension = memcached_extension(ptr);
+  if (extension == NULL or extension->async.pending == 0) {
+    return MEMCACHED_SUCCESS;
+  }
+  extension->async.polls++;
+  uint64_t before = extension->async.completed;
+
+  // send what was queued, and see which connections already hold responses
+  struct pollfd fds[ASYNC_POLL_SERVERS];
+  uint32_t servers[ASYNC_POLL_SERVERS];
+  nfds_t host_index = 0;
+  bool buffered = false;
+  for (uint32_t x = 0; x < memcached_server_count(ptr) and host_index < ASYNC_POLL_SERVERS; ++x) {
+    memcached_instance_st *instance = memcached_instance_fetch(ptr, x);
+    if (instance->async.count == 0) {
+      continue;
+    }
+    if (instance->fd == INVALID_SOCKET) {
+      async_fail(instance, MEMCACHED_CONNECTION_FAILURE);
+      continue;
+    }
+    if (instance->write_buffer_offset and memcached_io_write(instance) == false) {
+      memcached_io_reset(instance);
+      async_fail(instance, MEMCACHED_WRITE_FAILURE);
+      continue;
+    }
+
+    buffered = buffered or instance->read_buffer_length;
+    fds[host_index].fd = instance->fd;
+    fds[host_index].events = POLLIN;
+    fds[host_index].revents = 0;
+    servers[host_index++] = x;
+  }
+
+  memcached_return_t rc = MEMCACHED_SUCCESS;
+  int64_t start = 0, now = 0;
+  if (host_index) {
+    start = async_clock();
+    memcached_epoll_count_poll(ptr);
+    if (poll(fds, host_index, buffered ? 0 : timeout) == -1) {
+      rc = memcached_set_errno(*ptr, get_socket_errno(), MEMCACHED_AT);
+    }
+    now = async_clock();
+  }
+
+  // the responses in the read buffer, and those of one more read
+  for (nfds_t x = 0; x < host_index; ++x) {
+    memcached_instance_st *instance = memcached_instance_fetch(ptr, servers[x]);
+    if (instance->async.count == 0 or instance->fd != fds[x].fd) {
+      continue;
+    }
+    if (instance->read_buffer_length == 0 and fds[x].revents == 0) {
+      // a connection silent for the poll timeout is not going to answer
+      if (instance->async.since == 0) {
+        instance->async.since = start;
+      }
+      if (ptr->poll_timeout >= 0 and now - instance->async.since >= ptr->poll_timeout) {
+        memcached_io_reset(instance);
+        async_fail(instance, MEMCACHED_TIMEOUT);
+        rc = memcached_set_error(*instance, MEMCACHED_TIMEOUT, MEMCACHED_AT);
+      }
+      continue;
+    }
+    do {
+      if (memcached_failed(async_read_one(instance))) {
+        break;
+      }
+    } while (instance->async.count and instance->read_buffer_length);
+  }
+
+  if (completed) {
+    *completed = uint32_t(extension->async.completed - before);
+  }
+
+  return rc;
+}
+
+uint32_t memcached_async_pending(const memcached_st *shell) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      return extension->async.pending;
+    }
+  }
+
+  return 0;
+}
+
+void memcached_async_stat(const memcached_st *shell, struct memcached_async_stat_st *stat) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      stat->submitted = extension->async.submitted;
+      stat->completed = extension->async.completed;
+      stat->waits = extension->async.waits;
+      stat->polls = extension->async.polls;
+    }
+  }
+}
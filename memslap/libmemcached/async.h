@@ -0,0 +1,111 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Pipelined requests with completion callbacks.
+ *
+ * memcached_async_get(), memcached_async_set() and memcached_async_delete()
+ * queue a request on the connection of its key and return without waiting
+ * for the response. At most the depth of memcached_async_set_depth() requests
+ * are in flight per connection: a request beyond that first completes the
+ * oldest ones there. memcached_async_poll() sends what was queued and
+ * completes the requests whose responses arrived, passing the callback of
+ * the handle the user data each was submitted with. Responses are matched
+ * to their requests by the opaque of the binary protocol or the O flag of
+ * the meta protocol (see meta.h), so the text protocol and UDP are
+ * not supported. Blocking calls must not be made on the handle while
+ * requests are in flight.
+ */
+
+#define MEMCACHED_ASYNC_DEPTH_DEFAULT 16
+
+enum memcached_async_op_t { MEMCACHED_ASYNC_GET, MEMCACHED_ASYNC_SET, MEMCACHED_ASYNC_DELETE };
+
+struct memcached_async_result_st {
+  enum memcached_async_op_t op;
+  memcached_return_t rc; /* MEMCACHED_NOTFOUND for a miss */
+  void *user_data;
+  const char *value;     /* of a hit, gone after the callback */
+  size_t value_length;
+  uint32_t flags;
+  uint64_t cas;
+};
+
+/* Runs in memcached_async_poll() and submissions: it must not submit or poll itself */
+typedef void (*memcached_async_fn)(const memcached_st *ptr,
+                                   const struct memcached_async_result_st *result,
+                                   void *context);
+
+struct memcached_async_stat_st {
+  uint64_t submitted;
+  uint64_t completed;
+  uint64_t waits; /* submissions that completed others on a full connection first */
+  uint64_t polls; /* memcached_async_poll() calls */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LIBMEMCACHED_API
+memcached_return_t memcached_async_set_callback(memcached_st *ptr, memcached_async_fn callback,
+                                                void *context);
+
+/**
+ * Requests in flight per connection, MEMCACHED_ASYNC_DEPTH_DEFAULT unless
+ * set. Takes effect on connections without requests in flight.
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_async_set_depth(memcached_st *ptr, uint32_t depth);
+
+LIBMEMCACHED_API
+uint32_t memcached_async_get_depth(const memcached_st *ptr);
+
+LIBMEMCACHED_API
+memcached_return_t memcached_async_get(memcached_st *ptr, const char *key, size_t key_length,
+                                       void *user_data);
+
+LIBMEMCACHED_API
+memcached_return_t memcached_async_set(memcached_st *ptr, const char *key, size_t key_length,
+                                       const char *value, size_t value_length, time_t expiration,
+                                       uint32_t flags, void *user_data);
+
+LIBMEMCACHED_API
+memcached_return_t memcached_async_delete(memcached_st *ptr, const char *key, size_t key_length,
+                                          void *user_data);
+
+/**
+ * Sends the queued requests and completes those with responses, waiting up
+ * to timeout milliseconds for the first one (-1: as long as it takes, 0: not
+ * at all). *completed, if given, is the number of callbacks run. A failed
+ * connection completes its requests with its error, and one that has not
+ * answered for MEMCACHED_BEHAVIOR_POLL_TIMEOUT milliseconds of polls is reset
+ * and completes them with MEMCACHED_TIMEOUT.
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_async_poll(memcached_st *ptr, int timeout, uint32_t *completed);
+
+/* Requests in flight on all connections */
+LIBMEMCACHED_API
+uint32_t memcached_async_pending(const memcached_st *ptr);
+
+LIBMEMCACHED_API
+void memcached_async_stat(const memcached_st *ptr, struct memcached_async_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,26 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/* A request of memcached_async_*() in flight, see async.h */
+struct memcached_async_slot_st {
+  uint32_t opaque;
+  enum memcached_async_op_t op;
+  void *user_data;
+};
+
+/* Frees the requests of an instance that is going away, without completing them */
+void memcached_async_release(memcached_instance_st *instance);
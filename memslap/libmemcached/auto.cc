@@ -67,6 +67,45 @@ static memcached_return_t text_incr_decr(memcached_instance_st *instance, const
   return memcached_vdo(instance, vector, 7, true);
 }
 
+/*
+  "ma <key> D<offset> M<I|D> v", with "N<expiration> J<initial>" to create a
+  missing key unless expiration is MEMCACHED_EXPIRATION_NOT_ADD, see meta.h
+*/
+static memcached_return_t meta_incr_decr(memcached_instance_st *instance, const bool is_incr,
+                                         const char *key, size_t key_length, const uint64_t offset,
+                                         const uint64_t initial, const uint32_t expiration) {
+  char buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
+
+  int send_length;
+  if (expiration == MEMCACHED_EXPIRATION_NOT_ADD) {
+    send_length = snprintf(buffer, sizeof(buffer), " D%" PRIu64 " M%c v", offset,
+                           is_incr ? 'I' : 'D');
+  } else {
+    send_length = snprintf(buffer, sizeof(buffer), " D%" PRIu64 " M%c v N%" PRIu32 " J%" PRIu64,
+                           offset, is_incr ? 'I' : 'D', expiration, initial);
+  }
+  if (size_t(send_length) >= sizeof(buffer) or send_length < 0) {
+    return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT,
+                               memcached_literal_param("snprintf(MEMCACHED_DEFAULT_COMMAND_SIZE)"));
+  }
+
+  libmemcached_io_vector_st vector[] = {
+      {NULL, 0},
+      {memcached_literal_param("ma ")},
+      {memcached_array_string(instance->root->_namespace),
+       memcached_array_size(instance->root->_namespace)},
+      {key, key_length},
+      {buffer, size_t(send_length)},
+      {memcached_literal_param("\r\n")}};
+
+  memcached_return_t rc = memcached_vdo(instance, vector, 6, true);
+  if (memcached_success(rc)) {
+    memcached_meta_expect_reply(instance);
+  }
+
+  return rc;
+}
+
 static memcached_return_t binary_incr_decr(memcached_instance_st *instance,
                                            protocol_binary_command cmd, const char *key,
                                            const size_t key_length, const uint64_t offset,
@@ -145,6 +184,9 @@ static memcached_return_t increment_decrement_by_key(const protocol_binary_comma
   if (memcached_is_binary(memc)) {
     rc = binary_incr_decr(instance, command, key, key_length, uint64_t(offset), 0,
                           MEMCACHED_EXPIRATION_NOT_ADD, reply);
+  } else if (memcached_is_meta(memc)) {
+    rc = meta_incr_decr(instance, command == PROTOCOL_BINARY_CMD_INCREMENT, key, key_length,
+                        uint64_t(offset), 0, MEMCACHED_EXPIRATION_NOT_ADD);
   } else {
     rc = text_incr_decr(instance, command == PROTOCOL_BINARY_CMD_INCREMENT ? true : false, key,
                         key_length, offset, reply);
@@ -190,6 +232,9 @@ increment_decrement_with_initial_by_key(const protocol_binary_command command, M
     rc = binary_incr_decr(instance, command, key, key_length, offset, initial, uint32_t(expiration),
                           reply);
 
+  } else if (memcached_is_meta(memc)) {
+    rc = meta_incr_decr(instance, command == PROTOCOL_BINARY_CMD_INCREMENT, key, key_length,
+                        offset, initial, uint32_t(expiration));
   } else {
     rc = memcached_set_error(
         *memc, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
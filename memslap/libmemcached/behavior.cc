@@ -98,6 +98,18 @@ memcached_return_t memcached_behavior_set(memcached_st *shell, const memcached_b
   case MEMCACHED_BEHAVIOR_BINARY_PROTOCOL:
     send_quit(
         ptr); // We need t shutdown all of the connections to make sure we do the correct protocol
+    if (data == MEMCACHED_PROTOCOL_META) {
+      memcached_extension_st *extension = memcached_extension_fetch(ptr);
+      if (extension == NULL) {
+        return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+      }
+      extension->meta = true;
+      ptr->flags.binary_protocol = false;
+      break;
+    }
+    if (memcached_extension_st *extension = memcached_extension(ptr)) {
+      extension->meta = false;
+    }
     if (data) {
       ptr->flags.verify_key = false;
     }
@@ -147,6 +159,9 @@ memcached_return_t memcached_behavior_set(memcached_st *shell, const memcached_b
     break;
 
   case MEMCACHED_BEHAVIOR_DISTRIBUTION:
+    if (data > MEMCACHED_DISTRIBUTION_EXTENDED) {
+      return memcached_set_extended_distribution(ptr, data);
+    }
     return memcached_behavior_set_distribution(ptr, (memcached_server_distribution_t) data);
 
   case MEMCACHED_BEHAVIOR_KETAMA: {
@@ -305,6 +320,9 @@ uint64_t memcached_behavior_get(memcached_st *shell, const memcached_behavior_t
     return ptr->io_key_prefetch;
 
   case MEMCACHED_BEHAVIOR_BINARY_PROTOCOL:
+    if (memcached_is_meta(ptr)) {
+      return MEMCACHED_PROTOCOL_META;
+    }
     return ptr->flags.binary_protocol;
 
   case MEMCACHED_BEHAVIOR_SUPPORT_CAS:
@@ -335,6 +353,9 @@ uint64_t memcached_behavior_get(memcached_st *shell, const memcached_behavior_t
     return false;
 
   case MEMCACHED_BEHAVIOR_DISTRIBUTION:
+    if (uint32_t distribution = memcached_extended_distribution(ptr)) {
+      return distribution;
+    }
     return ptr->distribution;
 
   case MEMCACHED_BEHAVIOR_KETAMA:
@@ -513,6 +534,9 @@ memcached_return_t memcached_behavior_set_distribution(memcached_st *shell,
           *ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
           memcached_literal_param("Invalid memcached_server_distribution_t"));
     }
+    if (memcached_extension_st *extension = memcached_extension(ptr)) {
+      extension->distribution = 0;
+    }
     ptr->distribution = type;
 
     return run_distribution(ptr);
@@ -0,0 +1,75 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Live migration of virtual buckets (memcached_bucket_set()).
+ *
+ * memcached_bucket_migrate() moves a bucket to another server at once.
+ * Until memcached_bucket_migrate_done() is called for it, a memcached_get()
+ * that misses on the new server is retried on the previous one, and with the
+ * meta protocol a hit there is added to the new server. Deletes go to both
+ * servers, everything else goes to the new one. memcached_bucket_migrate_copy()
+ * copies the items of all migrating buckets meanwhile. Both keep the time the
+ * items have left.
+ *
+ * Clones share the bucket map of their source, so one thread can migrate
+ * buckets while others keep serving requests.
+ */
+
+struct memcached_bucket_migration_stat_st {
+  uint64_t forward_reads; /* gets retried on the previous server */
+  uint64_t forward_hits;  /* retries which found the key */
+  uint64_t copied;        /* items copied by memcached_bucket_migrate_copy() */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Start moving a bucket to server, the position of a server of the handle.
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_bucket_migrate(memcached_st *ptr, uint32_t bucket, uint32_t server);
+
+/**
+ * Start moving every bucket to its server in the forward map of memcached_bucket_set().
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_bucket_migrate_forward(memcached_st *ptr);
+
+/**
+ * Copy the items of all migrating buckets from their previous server to the new one.
+ * Items already on the new server are kept. Keys and their expiration are listed with
+ * memcached_dump_items() on connections of a clone.
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_bucket_migrate_copy(memcached_st *ptr);
+
+/**
+ * Make the new server the only owner of the bucket.
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_bucket_migrate_done(memcached_st *ptr, uint32_t bucket);
+
+LIBMEMCACHED_API
+void memcached_bucket_migration_stat(const memcached_st *ptr,
+                                     struct memcached_bucket_migration_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,47 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Connection buffers of the servers of a handle.
+ *
+ * Read and write buffers are allocated on the first request to a server and
+ * freed when its connection closes. They start at 512 bytes: the read buffer
+ * doubles after a read filled it and halves when the largest of 64 reads
+ * used less than a quarter of it; the write buffer doubles when a batch of
+ * requests fills it. Neither grows beyond MEMCACHED_MAX_BUFFER. Values that
+ * do not fit the read buffer are read straight into their destination.
+ */
+
+struct memcached_buffer_stat_st {
+  uint32_t servers;
+  uint32_t connected;
+  uint64_t server_bytes; /* the server structures and their hostnames */
+  uint64_t read_bytes;   /* read buffers currently allocated */
+  uint64_t write_bytes;  /* write buffers currently allocated */
+  uint64_t direct_reads; /* reads of values bypassing the read buffer */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LIBMEMCACHED_API
+void memcached_buffer_stat(const memcached_st *ptr, struct memcached_buffer_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
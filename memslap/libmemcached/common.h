@@ -84,6 +84,7 @@ memcached_instance_st *memcached_instance_fetch(memcached_st *ptr, uint32_t serv
 #  include "libmemcached/behavior.hpp"
 #  include "libmemcached/sasl.hpp"
 #  include "libmemcached/server_list.hpp"
+#  include "libmemcached/extension.hpp"
 #endif
 
 #include "libmemcached/internal.h"
@@ -91,6 +92,22 @@ memcached_instance_st *memcached_instance_fetch(memcached_st *ptr, uint32_t serv
 #include "libmemcached/libmemcached_probes.h"
 #include "libmemcached/byteorder.h"
 #include "libmemcached/initialize_query.h"
+#include "libmemcached/hotkey.h"
+#include "libmemcached/compression.h"
+#include "libmemcached/hedge.h"
+#include "libmemcached/replica_read.h"
+#include "libmemcached/epoll.h"
+#include "libmemcached/get_into.h"
+#include "libmemcached/pool_allocator.h"
+#include "libmemcached/buffers.h"
+#include "libmemcached/meta.h"
+#include "libmemcached/async.h"
+#include "libmemcached/mux.h"
+#include "libmemcached/udp.h"
+#include "libmemcached/read_through.h"
+#include "libmemcached/dump_items.h"
+#include "libmemcached/distribution.h"
+#include "libmemcached/bucket_migration.h"
 
 #ifdef __cplusplus
 #  include "libmemcached/response.h"
@@ -106,6 +123,15 @@ memcached_instance_st *memcached_instance_fetch(memcached_st *ptr, uint32_t serv
 #  include "libmemcached/key.hpp"
 #  include "libmemcached/result.h"
 #  include "libmemcached/version.hpp"
+#  include "libmemcached/compression.hpp"
+#  include "libmemcached/hedge.hpp"
+#  include "libmemcached/replica_read.hpp"
+#  include "libmemcached/epoll.hpp"
+#  include "libmemcached/scan.hpp"
+#  include "libmemcached/meta.hpp"
+#  include "libmemcached/async.hpp"
+#  include "libmemcached/distribution.hpp"
+#  include "libmemcached/prng.hpp"
 #endif
 
 #include "libmemcached/continuum.hpp"
@@ -0,0 +1,189 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/common.h"
+#include "libmemcached/compression.hpp"
+
+#if HAVE_ZLIB
+#  include <zlib.h>
+#endif
+
+/*
+  Compressed values are prefixed with their original length in network byte
+  order, so the result can be sized once and inflated in a single call.
+*/
+#define COMPRESSION_HEADER_SIZE sizeof(uint32_t)
+
+memcached_return_t memcached_set_compression(memcached_st *shell, size_t threshold, int level) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+#if HAVE_ZLIB
+  if (level < Z_DEFAULT_COMPRESSION or level > Z_BEST_COMPRESSION) {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("Invalid compression level"));
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  extension->compression.threshold = threshold;
+  extension->compression.level = level;
+
+  return MEMCACHED_SUCCESS;
+#else
+  (void) threshold;
+  (void) level;
+  return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+                             memcached_literal_param("Compression requires zlib"));
+#endif
+}
+
+size_t memcached_get_compression_threshold(const memcached_st *shell) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      return extension->compression.threshold;
+    }
+  }
+
+  return 0;
+}
+
+void memcached_compression_stat(const memcached_st *shell,
+                                struct memcached_compression_stat_st *stat) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      stat->values_compressed = extension->compression.values_compressed;
+      stat->bytes_in = extension->compression.bytes_in;
+      stat->bytes_out = extension->compression.bytes_out;
+      stat->values_decompressed = extension->compression.values_decompressed;
+    }
+  }
+}
+
+memcached_return_t memcached_compress(Memcached *ptr, const char *&value, size_t &value_length,
+                                      uint32_t &flags) {
+#if HAVE_ZLIB
+  memcached_extension_st *extension = memcached_extension(ptr);
+  if (extension == NULL or extension->compression.threshold == 0
+      or value_length < extension->compression.threshold or value_length > UINT32_MAX)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  uLong bound = compressBound(uLong(value_length));
+  char *buffer = memcached_extension_buffer(ptr, extension, COMPRESSION_HEADER_SIZE + bound);
+  if (buffer == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  uLongf compressed_length = bound;
+  if (compress2((Bytef *) buffer + COMPRESSION_HEADER_SIZE, &compressed_length,
+                (const Bytef *) value, uLong(value_length), extension->compression.level)
+      != Z_OK)
+  {
+    // not fatal, the value is simply stored as is
+    return MEMCACHED_SUCCESS;
+  }
+
+  if (COMPRESSION_HEADER_SIZE + compressed_length >= value_length) {
+    return MEMCACHED_SUCCESS;
+  }
+
+  uint32_t original_length = htonl(uint32_t(value_length));
+  memcpy(buffer, &original_length, COMPRESSION_HEADER_SIZE);
+
+  extension->compression.values_compressed++;
+  extension->compression.bytes_in += value_length;
+  extension->compression.bytes_out += COMPRESSION_HEADER_SIZE + compressed_length;
+
+  value = buffer;
+  value_length = COMPRESSION_HEADER_SIZE + compressed_length;
+  flags |= MEMCACHED_COMPRESSION_FLAG;
+#else
+  (void) ptr;
+  (void) value;
+  (void) value_length;
+  (void) flags;
+#endif
+
+  return MEMCACHED_SUCCESS;
+}
+
+char *memcached_compression_buffer(Memcached *ptr, size_t length) {
+  memcached_extension_st *extension = memcached_extension(ptr);
+  if (extension == NULL) {
+    return NULL;
+  }
+
+  return memcached_extension_buffer(ptr, extension, length);
+}
+
+memcached_return_t memcached_decompress(memcached_instance_st *instance, const char *source,
+                                        size_t source_length, memcached_result_st *result) {
+#if HAVE_ZLIB
+  uint32_t original_length;
+  if (source_length < COMPRESSION_HEADER_SIZE) {
+    return memcached_set_error(*instance, MEMCACHED_UNKNOWN_READ_FAILURE, MEMCACHED_AT,
+                               memcached_literal_param("Truncated compressed value"));
+  }
+  memcpy(&original_length, source, COMPRESSION_HEADER_SIZE);
+  original_length = ntohl(original_length);
+
+  memcached_result_reset_value(result);
+  // one more byte for the terminating null the fetch API hands out
+  if (memcached_failed(memcached_string_check(&result->value, size_t(original_length) + 1))) {
+    return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  char *value = memcached_string_value_mutable(&result->value);
+  uLongf value_length = original_length;
+  if (uncompress((Bytef *) value, &value_length, (const Bytef *) source + COMPRESSION_HEADER_SIZE,
+                 uLong(source_length - COMPRESSION_HEADER_SIZE))
+          != Z_OK
+      or value_length != original_length)
+  {
+    return memcached_set_error(*instance, MEMCACHED_UNKNOWN_READ_FAILURE, MEMCACHED_AT,
+                               memcached_literal_param("uncompress() failed"));
+  }
+
+  value[value_length] = 0;
+  memcached_string_set_length(&result->value, value_length);
+  result->item_flags &= ~MEMCACHED_COMPRESSION_FLAG;
+
+  if (memcached_extension_st *extension = memcached_extension(instance->root)) {
+    extension->compression.values_decompressed++;
+  }
+
+  return MEMCACHED_SUCCESS;
+#else
+  (void) source;
+  (void) source_length;
+  (void) result;
+  return memcached_set_error(*instance, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+                             memcached_literal_param("Compression requires zlib"));
+#endif
+}
@@ -0,0 +1,64 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Transparent value compression.
+ *
+ * Once enabled, values of at least `threshold` bytes stored with set, add,
+ * replace or cas are deflated before they are sent, if that makes them
+ * smaller. Such items carry MEMCACHED_COMPRESSION_FLAG in their flags.
+ * Values fetched with the flag set are inflated directly into the result and
+ * the flag is removed again. Handles without compression enabled return
+ * these items untouched.
+ */
+
+/* Reserved item flag, kept within the 16 bits older servers preserve */
+#define MEMCACHED_COMPRESSION_FLAG (1U << 15)
+/* zlib level used unless overridden, favours speed over ratio */
+#define MEMCACHED_COMPRESSION_LEVEL_DEFAULT 1
+
+struct memcached_compression_stat_st {
+  uint64_t values_compressed;   /* values sent compressed */
+  uint64_t bytes_in;            /* size of those values before compression */
+  uint64_t bytes_out;           /* size of those values after compression */
+  uint64_t values_decompressed; /* values inflated on fetch */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Enable compression of values of at least threshold bytes.
+ *
+ * @param threshold minimum value size to compress, 0 disables compression
+ * @param level zlib compression level (1-9), or -1 for the zlib default
+ * @return MEMCACHED_NOT_SUPPORTED if the library was built without zlib
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_set_compression(memcached_st *ptr, size_t threshold, int level);
+
+LIBMEMCACHED_API
+size_t memcached_get_compression_threshold(const memcached_st *ptr);
+
+LIBMEMCACHED_API
+void memcached_compression_stat(const memcached_st *ptr,
+                                struct memcached_compression_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,40 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+  Deflate value into the handle's scratch buffer if compression is enabled
+  and worth it; value, value_length and flags are updated accordingly.
+*/
+memcached_return_t memcached_compress(Memcached *ptr, const char *&value, size_t &value_length,
+                                      uint32_t &flags);
+
+static inline bool memcached_is_compressed(const Memcached *ptr, uint32_t flags) {
+  if (flags & MEMCACHED_COMPRESSION_FLAG) {
+    const memcached_extension_st *extension = memcached_extension(ptr);
+    return extension and extension->compression.threshold;
+  }
+  return false;
+}
+
+/* Scratch buffer to receive a compressed value of the given length into */
+char *memcached_compression_buffer(Memcached *ptr, size_t length);
+
+/*
+  Inflate source into the value of result and clear the compression flag.
+*/
+memcached_return_t memcached_decompress(memcached_instance_st *instance, const char *source,
+                                        size_t source_length, memcached_result_st *result);
@@ -0,0 +1,588 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/common.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+
+/* Average continuum points per bucket of the search index */
+#define CONTINUUM_POINTS_PER_BUCKET 2
+
+/* Smallest continuum whose points are hashed by several threads */
+#define CONTINUUM_PARALLEL_POINTS 16384
+#define CONTINUUM_THREADS_MAX     8
+
+/*
+  A continuum is never modified once built, so all handles built for the
+  same servers, e.g. clones, share one. A rebuild publishes a new continuum
+  and swaps the handle's reference, the last reference frees the old one.
+  Continuums are allocated with malloc(), as they outlive the handle which
+  built them.
+*/
+struct memcached_continuum_st {
+  uint32_t references; // under continuum_lock
+  uint32_t points;
+  uint32_t servers;
+  uint32_t shift;        // 32 - log2(buckets) of the search index
+  uint64_t signature;    // of the config and servers, 0 if not shared
+  uint64_t config;       // of the distribution and hash the points were computed with
+  memcached_continuum_item_st *item; // sorted by value, then index
+  uint64_t *server;      // per server: its signature, 0 if it has no points
+  uint32_t *value;       // the item values, searched without touching the items
+  uint32_t *start;       // per bucket of the top hash bits: first value in it, plus an end marker
+  uint32_t *distinct;    // per point: the next point of another server, itself if there is none
+};
+
+static std::mutex continuum_lock;
+static std::unordered_map<uint64_t, memcached_continuum_st *> continuum_published;
+
+static inline uint64_t continuum_signature(uint64_t signature, const void *data, size_t length) {
+  // FNV-1a
+  const unsigned char *byte = static_cast<const unsigned char *>(data);
+  for (size_t x = 0; x < length; ++x) {
+    signature = (signature ^ byte[x]) * 0x100000001b3ULL;
+  }
+  return signature;
+}
+
+static inline memcached_continuum_st *continuum_of(const memcached_continuum_item_st *item) {
+  return item ? reinterpret_cast<memcached_continuum_st *>(
+             reinterpret_cast<char *>(const_cast<memcached_continuum_item_st *>(item))
+             - sizeof(memcached_continuum_st))
+              : NULL;
+}
+
+static memcached_continuum_st *continuum_create(uint32_t points, uint32_t servers) {
+  uint32_t bits = 1;
+  while (bits < 24 and (uint64_t(1) << bits) * CONTINUUM_POINTS_PER_BUCKET < points) {
+    bits++;
+  }
+  size_t buckets = size_t(1) << bits;
+
+  // one allocation, items directly after the header
+  size_t size = sizeof(memcached_continuum_st) + points * sizeof(memcached_continuum_item_st)
+      + servers * sizeof(uint64_t) + (2 * points + buckets + 1) * sizeof(uint32_t);
+  memcached_continuum_st *continuum = static_cast<memcached_continuum_st *>(malloc(size));
+  if (continuum == NULL) {
+    return NULL;
+  }
+
+  continuum->references = 1;
+  continuum->points = points;
+  continuum->servers = servers;
+  continuum->shift = 32 - bits;
+  continuum->signature = 0;
+  continuum->config = 0;
+  continuum->item = reinterpret_cast<memcached_continuum_item_st *>(continuum + 1);
+  continuum->server = reinterpret_cast<uint64_t *>(continuum->item + points);
+  continuum->value = reinterpret_cast<uint32_t *>(continuum->server + servers);
+  continuum->start = continuum->value + points;
+  continuum->distinct = continuum->start + buckets + 1;
+
+  return continuum;
+}
+
+/* Buckets of the top hash bits narrow each search to the few values in them */
+static void continuum_index(memcached_continuum_st *continuum) {
+  uint32_t points = continuum->points;
+  uint32_t *value = continuum->value;
+  uint32_t *start = continuum->start;
+  uint32_t buckets = uint32_t(1) << (32 - continuum->shift);
+
+  for (uint32_t x = 0; x < points; ++x) {
+    value[x] = continuum->item[x].value;
+  }
+
+  uint32_t position = 0;
+  for (uint32_t bucket = 0; bucket < buckets; ++bucket) {
+    uint64_t first = uint64_t(bucket) << continuum->shift;
+    while (position < points and value[position] < first) {
+      ++position;
+    }
+    start[bucket] = position;
+  }
+  start[buckets] = points;
+
+  // backwards from a server change, so each point inherits the next of its run
+  const memcached_continuum_item_st *item = continuum->item;
+  uint32_t *distinct = continuum->distinct;
+  uint32_t last = points;
+  for (uint32_t x = 0; x < points; ++x) {
+    if (item[x].index != item[(x + 1) % points].index) {
+      last = x;
+    }
+  }
+  if (last == points) {
+    for (uint32_t x = 0; x < points; ++x) {
+      distinct[x] = x;
+    }
+    return;
+  }
+  for (uint32_t step = 0, x = last; step < points; ++step, x = x ? x - 1 : points - 1) {
+    uint32_t next = (x + 1) % points;
+    distinct[x] = item[x].index != item[next].index ? next : distinct[next];
+  }
+}
+
+/* Takes a reference to a published continuum, NULL if there is none */
+static memcached_continuum_st *continuum_acquire(uint64_t signature) {
+  std::lock_guard<std::mutex> guard(continuum_lock);
+  auto found = continuum_published.find(signature);
+  if (found == continuum_published.end()) {
+    return NULL;
+  }
+  found->second->references++;
+  return found->second;
+}
+
+/* Returns the continuum to use, which is another one if it was published meanwhile */
+static memcached_continuum_st *continuum_publish(memcached_continuum_st *continuum) {
+  if (continuum->signature == 0) {
+    return continuum;
+  }
+
+  memcached_continuum_st *published;
+  {
+    std::lock_guard<std::mutex> guard(continuum_lock);
+    auto inserted = continuum_published.emplace(continuum->signature, continuum);
+    if (inserted.second) {
+      return continuum;
+    }
+    published = inserted.first->second;
+    published->references++;
+  }
+
+  free(continuum);
+  return published;
+}
+
+static void continuum_release(memcached_continuum_st *continuum) {
+  {
+    std::lock_guard<std::mutex> guard(continuum_lock);
+    if (--continuum->references) {
+      return;
+    }
+    if (continuum->signature) {
+      auto found = continuum_published.find(continuum->signature);
+      if (found != continuum_published.end() and found->second == continuum) {
+        continuum_published.erase(found);
+      }
+    }
+  }
+  free(continuum);
+}
+
+static uint64_t continuum_server_signature(const memcached_instance_st &instance) {
+  uint64_t signature = 0xcbf29ce484222325ULL;
+  uint32_t port = instance.port();
+  signature = continuum_signature(signature, instance._hostname, strlen(instance._hostname));
+  signature = continuum_signature(signature, &port, sizeof(port));
+  signature = continuum_signature(signature, &instance.weight, sizeof(instance.weight));
+  return signature | 1; // 0 marks servers without points
+}
+
+static uint32_t continuum_server_points(const Memcached *ptr, const memcached_instance_st &instance,
+                                        uint64_t total_weight, uint32_t live_servers) {
+  if (memcached_is_weighted_ketama(ptr)) {
+    float pct = (float) instance.weight / (float) total_weight;
+    return (uint32_t)((::floor((float) (pct * MEMCACHED_POINTS_PER_SERVER_KETAMA / 4
+                                            * (float) live_servers
+                                        + 0.0000000001F)))
+                      * 4);
+  }
+  return MEMCACHED_POINTS_PER_SERVER;
+}
+
+static uint32_t ketama_server_hash(const char *key, size_t key_length, uint32_t alignment) {
+  unsigned char results[16];
+
+  libhashkit_md5_signature((unsigned char *) key, key_length, results);
+
+  return ((uint32_t)(results[3 + alignment * 4] & 0xFF) << 24)
+      | ((uint32_t)(results[2 + alignment * 4] & 0xFF) << 16)
+      | ((uint32_t)(results[1 + alignment * 4] & 0xFF) << 8) | (results[0 + alignment * 4] & 0xFF);
+}
+
+/* Fills in the points of one server, false if its name is too long */
+static bool continuum_server_hash(const Memcached *ptr, const memcached_instance_st &instance,
+                                  uint32_t host_index, uint32_t points,
+                                  memcached_continuum_item_st *item) {
+  uint32_t pointer_per_hash = memcached_is_weighted_ketama(ptr) ? 4 : 1;
+
+  for (uint32_t pointer_index = 0; pointer_index < points / pointer_per_hash; ++pointer_index) {
+    char sort_host[1 + MEMCACHED_NI_MAXHOST + 1 + MEMCACHED_NI_MAXSERV + 1 + MEMCACHED_NI_MAXSERV] =
+        "";
+    int sort_host_length;
+
+    if (ptr->distribution == MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA_SPY) {
+      // Spymemcached ketema key format is: hostname/ip:port-index
+      // If hostname is not available then: /ip:port-index
+      sort_host_length = snprintf(sort_host, sizeof(sort_host), "/%s:%u-%u", instance._hostname,
+                                  (uint32_t) instance.port(), pointer_index);
+    } else if (instance.port() == MEMCACHED_DEFAULT_PORT) {
+      sort_host_length =
+          snprintf(sort_host, sizeof(sort_host), "%s-%u", instance._hostname, pointer_index);
+    } else {
+      sort_host_length = snprintf(sort_host, sizeof(sort_host), "%s:%u-%u", instance._hostname,
+                                  (uint32_t) instance.port(), pointer_index);
+    }
+
+    if (size_t(sort_host_length) >= sizeof(sort_host) or sort_host_length < 0) {
+      return false;
+    }
+
+    if (pointer_per_hash == 4) {
+      for (uint32_t x = 0; x < pointer_per_hash; x++) {
+        item->index = host_index;
+        item++->value = ketama_server_hash(sort_host, (size_t) sort_host_length, x);
+      }
+    } else {
+      item->index = host_index;
+      item++->value = hashkit_digest(&ptr->hashkit, sort_host, (size_t) sort_host_length);
+    }
+  }
+
+  return true;
+}
+
+static inline bool continuum_item_less(const memcached_continuum_item_st &a,
+                                       const memcached_continuum_item_st &b) {
+  return a.value < b.value or (a.value == b.value and a.index < b.index);
+}
+
+/*
+  Stable LSD radix sort on the value. The items come in server order, so
+  equal values stay ordered by server index.
+*/
+static bool continuum_sort(Memcached *ptr, memcached_continuum_item_st *item, uint32_t points) {
+  memcached_continuum_item_st *scratch =
+      libmemcached_xvalloc(ptr, points, memcached_continuum_item_st);
+  if (scratch == NULL) {
+    return false;
+  }
+
+  memcached_continuum_item_st *from = item, *to = scratch;
+  for (uint32_t shift = 0; shift < 32; shift += 8) {
+    uint32_t offset[256] = {0};
+    for (uint32_t x = 0; x < points; ++x) {
+      offset[(from[x].value >> shift) & 0xFF]++;
+    }
+    if (offset[(from[0].value >> shift) & 0xFF] == points) {
+      continue;
+    }
+    for (uint32_t digit = 0, sum = 0; digit < 256; ++digit) {
+      uint32_t count = offset[digit];
+      offset[digit] = sum;
+      sum += count;
+    }
+    for (uint32_t x = 0; x < points; ++x) {
+      to[offset[(from[x].value >> shift) & 0xFF]++] = from[x];
+    }
+    std::swap(from, to);
+  }
+
+  if (from != item) {
+    memcpy(item, from, points * sizeof(memcached_continuum_item_st));
+  }
+  libmemcached_free(ptr, scratch);
+
+  return true;
+}
+
+/* Hashes the points of all servers, on several threads for large continuums */
+static bool continuum_hash(const Memcached *ptr, memcached_continuum_st *continuum,
+                           const uint32_t *first, uint64_t total_weight, uint32_t live_servers,
+                           bool parallel) {
+  const memcached_instance_st *list = memcached_instance_list(ptr);
+  uint32_t servers = continuum->servers;
+  std::atomic<bool> failed{false};
+
+  uint32_t threads = 1;
+  if (parallel and continuum->points >= CONTINUUM_PARALLEL_POINTS) {
+    threads = std::min(std::max(std::thread::hardware_concurrency(), 1u), servers);
+    threads = std::min(threads, uint32_t(CONTINUUM_THREADS_MAX));
+  }
+
+  auto share = [&](uint32_t thread) {
+    for (uint32_t host_index = thread; host_index < servers; host_index += threads) {
+      if (continuum->server[host_index]
+          and not continuum_server_hash(
+              ptr, list[host_index], host_index,
+              continuum_server_points(ptr, list[host_index], total_weight, live_servers),
+              continuum->item + first[host_index]))
+      {
+        failed = true;
+      }
+    }
+  };
+
+  std::thread worker[CONTINUUM_THREADS_MAX];
+  uint32_t spawned = 1;
+  for (; spawned < threads; ++spawned) {
+    try {
+      worker[spawned] = std::thread(share, spawned);
+    } catch (const std::system_error &) {
+      break;
+    }
+  }
+  for (uint32_t thread = spawned; thread < threads; ++thread) {
+    share(thread);
+  }
+  share(0);
+  for (uint32_t thread = 1; thread < spawned; ++thread) {
+    worker[thread].join();
+  }
+
+  return not failed;
+}
+
+/*
+  With a fixed number of points per server, a single server ejected,
+  restored or added only removes or merges its own points, without hashing
+  the others or sorting. NULL with rc MEMCACHED_SUCCESS if that does not
+  apply.
+*/
+static memcached_continuum_st *continuum_change(Memcached *ptr, const memcached_continuum_st *old,
+                                                const uint64_t *server, uint32_t servers,
+                                                memcached_return_t &rc) {
+  rc = MEMCACHED_SUCCESS;
+  if (memcached_is_weighted_ketama(ptr) or servers < old->servers) {
+    return NULL;
+  }
+
+  uint32_t changed = UINT32_MAX;
+  for (uint32_t x = 0; x < servers; ++x) {
+    uint64_t before = x < old->servers ? old->server[x] : 0;
+    if (before != server[x]) {
+      if (changed != UINT32_MAX or (before and server[x])) {
+        return NULL;
+      }
+      changed = x;
+    }
+  }
+  if (changed == UINT32_MAX) {
+    return NULL;
+  }
+
+  if (server[changed] == 0) {
+    uint32_t points = 0;
+    for (uint32_t x = 0; x < old->points; ++x) {
+      points += old->item[x].index != changed;
+    }
+
+    memcached_continuum_st *continuum = continuum_create(points, servers);
+    if (continuum == NULL) {
+      rc = memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+      return NULL;
+    }
+    std::remove_copy_if(old->item, old->item + old->points, continuum->item,
+                        [changed](const memcached_continuum_item_st &item) {
+                          return item.index == changed;
+                        });
+    return continuum;
+  }
+
+  memcached_continuum_item_st added[MEMCACHED_POINTS_PER_SERVER];
+  if (not continuum_server_hash(ptr, memcached_instance_list(ptr)[changed], changed,
+                                MEMCACHED_POINTS_PER_SERVER, added))
+  {
+    rc = memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT,
+                             memcached_literal_param("snprintf(sizeof(sort_host))"));
+    return NULL;
+  }
+  std::sort(added, added + MEMCACHED_POINTS_PER_SERVER, continuum_item_less);
+
+  memcached_continuum_st *continuum =
+      continuum_create(old->points + MEMCACHED_POINTS_PER_SERVER, servers);
+  if (continuum == NULL) {
+    rc = memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    return NULL;
+  }
+  std::merge(old->item, old->item + old->points, added, added + MEMCACHED_POINTS_PER_SERVER,
+             continuum->item, continuum_item_less);
+  return continuum;
+}
+
+static memcached_continuum_st *continuum_build(Memcached *ptr, const uint64_t *server,
+                                               uint32_t servers, uint32_t live_servers,
+                                               bool parallel, memcached_return_t &rc) {
+  const memcached_instance_st *list = memcached_instance_list(ptr);
+
+  uint64_t total_weight = 0;
+  if (memcached_is_weighted_ketama(ptr)) {
+    for (uint32_t host_index = 0; host_index < servers; ++host_index) {
+      if (server[host_index]) {
+        total_weight += list[host_index].weight;
+      }
+    }
+  }
+
+  uint32_t *first = libmemcached_xvalloc(ptr, servers + 1, uint32_t);
+  if (first == NULL) {
+    rc = memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    return NULL;
+  }
+  first[0] = 0;
+  for (uint32_t host_index = 0; host_index < servers; ++host_index) {
+    first[host_index + 1] = first[host_index]
+        + (server[host_index]
+               ? continuum_server_points(ptr, list[host_index], total_weight, live_servers)
+               : 0);
+  }
+
+  memcached_continuum_st *continuum = continuum_create(first[servers], servers);
+  if (continuum == NULL) {
+    libmemcached_free(ptr, first);
+    rc = memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    return NULL;
+  }
+  memcpy(continuum->server, server, servers * sizeof(uint64_t));
+
+  bool hashed = continuum_hash(ptr, continuum, first, total_weight, live_servers, parallel);
+  libmemcached_free(ptr, first);
+  if (not hashed) {
+    free(continuum);
+    rc = memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT,
+                             memcached_literal_param("snprintf(sizeof(sort_host))"));
+    return NULL;
+  }
+
+  if (not continuum_sort(ptr, continuum->item, continuum->points)) {
+    free(continuum);
+    rc = memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    return NULL;
+  }
+
+  rc = MEMCACHED_SUCCESS;
+  return continuum;
+}
+
+memcached_return_t memcached_continuum_update(Memcached *ptr, uint32_t live_servers,
+                                              bool is_auto_ejecting, time_t now) {
+  const memcached_instance_st *list = memcached_instance_list(ptr);
+  uint32_t servers = memcached_server_count(ptr);
+
+  uint64_t *server = libmemcached_xvalloc(ptr, servers, uint64_t);
+  if (server == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  for (uint32_t host_index = 0; host_index < servers; ++host_index) {
+    server[host_index] = is_auto_ejecting and list[host_index].next_retry > now
+        ? 0
+        : continuum_server_signature(list[host_index]);
+  }
+
+  // custom hash functions can be neither compared nor assumed to be thread safe
+  hashkit_hash_algorithm_t algorithm = hashkit_get_function(&ptr->hashkit);
+  bool custom = algorithm == HASHKIT_HASH_CUSTOM and not memcached_is_weighted_ketama(ptr);
+  uint64_t config = 0xcbf29ce484222325ULL;
+  uint32_t weighted = memcached_is_weighted_ketama(ptr);
+  config = continuum_signature(config, &ptr->distribution, sizeof(ptr->distribution));
+  config = continuum_signature(config, &weighted, sizeof(weighted));
+  config = continuum_signature(config, &algorithm, sizeof(algorithm));
+  config = continuum_signature(config, &ptr->hashkit.base_hash, sizeof(ptr->hashkit.base_hash));
+
+  uint64_t signature = 0;
+  if (not custom) {
+    signature = continuum_signature(config, &servers, sizeof(servers));
+    signature = continuum_signature(signature, server, servers * sizeof(uint64_t)) | 1;
+  }
+
+  memcached_return_t rc = MEMCACHED_SUCCESS;
+  memcached_continuum_st *old = continuum_of(ptr->ketama.continuum);
+  memcached_continuum_st *continuum = signature ? continuum_acquire(signature) : NULL;
+  bool built = continuum == NULL;
+
+  if (continuum == NULL and old and old->config == config) {
+    continuum = continuum_change(ptr, old, server, servers, rc);
+    if (continuum) {
+      memcpy(continuum->server, server, servers * sizeof(uint64_t));
+    }
+  }
+  if (continuum == NULL and memcached_success(rc)) {
+    continuum = continuum_build(ptr, server, servers, live_servers, not custom, rc);
+  }
+  libmemcached_free(ptr, server);
+  if (continuum == NULL) {
+    return rc;
+  }
+
+  if (built) {
+    continuum->config = config;
+    continuum->signature = signature;
+    continuum_index(continuum);
+    continuum = continuum_publish(continuum);
+  }
+
+  if (DEBUG) {
+    for (uint32_t x = 0; x + 1 < continuum->points; ++x) {
+      WATCHPOINT_ASSERT(continuum->item[x].value <= continuum->item[x + 1].value);
+    }
+  }
+
+  if (old) {
+    continuum_release(old);
+  }
+  ptr->ketama.continuum = continuum->item;
+  ptr->ketama.continuum_count = continuum->points;
+  ptr->ketama.continuum_points_counter = continuum->points;
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_continuum_release(Memcached *ptr) {
+  if (memcached_continuum_st *continuum = continuum_of(ptr->ketama.continuum)) {
+    continuum_release(continuum);
+  }
+  ptr->ketama.continuum = NULL;
+  ptr->ketama.continuum_count = 0;
+  ptr->ketama.continuum_points_counter = 0;
+}
+
+uint32_t memcached_continuum_position(const Memcached *ptr, uint32_t hash) {
+  const memcached_continuum_st *continuum = continuum_of(ptr->ketama.continuum);
+  if (continuum == NULL or continuum->points == 0) {
+    return 0;
+  }
+
+  const uint32_t *value = continuum->value;
+  const uint32_t *start = continuum->start + (hash >> continuum->shift);
+  const uint32_t *base = value + start[0];
+  uint32_t count = start[1] - start[0];
+
+  // branchless lower bound within the bucket, an empty bucket continues at the next one
+  if (count) {
+    while (count > 1) {
+      uint32_t half = count / 2;
+      base = base[half] < hash ? base + half : base;
+      count -= half;
+    }
+    base += *base < hash;
+  }
+
+  uint32_t position = uint32_t(base - value);
+  return position == continuum->points ? 0 : position;
+}
+
+uint32_t memcached_continuum_next_server(const Memcached *ptr, uint32_t position) {
+  return continuum_of(ptr->ketama.continuum)->distinct[position];
+}
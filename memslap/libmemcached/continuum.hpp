@@ -20,3 +20,16 @@ struct memcached_continuum_item_st {
   uint32_t index;
   uint32_t value;
 };
+
+/* Points ptr->ketama.continuum at a continuum for its live servers, see continuum.cc */
+memcached_return_t memcached_continuum_update(Memcached *ptr, uint32_t live_servers,
+                                              bool is_auto_ejecting, time_t now);
+
+/* Drops the handle's reference to its continuum */
+void memcached_continuum_release(Memcached *ptr);
+
+/* Position of the first continuum point at or after hash, wrapping to 0 */
+uint32_t memcached_continuum_position(const Memcached *ptr, uint32_t hash);
+
+/* Position of the next point after position owned by another server, position if there is none */
+uint32_t memcached_continuum_next_server(const Memcached *ptr, uint32_t position);
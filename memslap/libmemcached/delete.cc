@@ -14,6 +14,7 @@
 */
 
 #include "libmemcached/common.h"
+#include "libmemcached/virtual_bucket.h"
 
 memcached_return_t memcached_delete(memcached_st *shell, const char *key, size_t key_length,
                                     time_t expiration) {
@@ -36,6 +37,25 @@ static inline memcached_return_t ascii_delete(memcached_instance_st *instance, u
   return memcached_vdo(instance, vector, 6, is_buffering ? false : true);
 }
 
+/* "md <key>", with a status even without reply, see meta.h */
+static inline memcached_return_t meta_delete(memcached_instance_st *instance, const char *key,
+                                             const size_t key_length, const bool is_buffering) {
+  libmemcached_io_vector_st vector[] = {
+      {NULL, 0},
+      {memcached_literal_param("md ")},
+      {memcached_array_string(instance->root->_namespace),
+       memcached_array_size(instance->root->_namespace)},
+      {key, key_length},
+      {memcached_literal_param("\r\n")}};
+
+  memcached_return_t rc = memcached_vdo(instance, vector, 5, is_buffering ? false : true);
+  if (memcached_success(rc)) {
+    memcached_meta_expect_reply(instance);
+  }
+
+  return rc;
+}
+
 static inline memcached_return_t binary_delete(memcached_instance_st *instance, uint32_t server_key,
                                                const char *key, const size_t key_length,
                                                const bool reply, const bool is_buffering) {
@@ -91,6 +111,23 @@ memcached_return_t memcached_delete_by_key(memcached_st *shell, const char *grou
   Memcached *memc = memcached2Memcached(shell);
   LIBMEMCACHED_MEMCACHED_DELETE_START();
 
+  if (memc and memcached_virtual_bucket_migrating(memc)
+      and memcached_bucket_route(memc) == MEMCACHED_BUCKET_ROUTE_MASTER)
+  {
+    // the previous server of a migrating bucket must not serve the value again
+    const char *hash_key = group_key_length ? group_key : key;
+    size_t hash_key_length = group_key_length ? group_key_length : key_length;
+    memcached_extension_st *extension;
+    if (memcached_generate_forward(memc, hash_key, hash_key_length) != UINT32_MAX
+        and (extension = memcached_extension_fetch(memc)))
+    {
+      extension->bucket.route = MEMCACHED_BUCKET_ROUTE_FORWARD;
+      (void) memcached_delete_by_key(memc, group_key, group_key_length, key, key_length,
+                                     expiration);
+      extension->bucket.route = MEMCACHED_BUCKET_ROUTE_MASTER;
+    }
+  }
+
   memcached_return_t rc;
   if (memcached_fatal(rc = initialize_query(memc, true))) {
     return rc;
@@ -132,6 +169,8 @@ memcached_return_t memcached_delete_by_key(memcached_st *shell, const char *grou
 
   if (memcached_is_binary(memc)) {
     rc = binary_delete(instance, server_key, key, key_length, is_replying, is_buffering);
+  } else if (memcached_is_meta(memc)) {
+    rc = meta_delete(instance, key, key_length, is_buffering);
   } else {
     rc = ascii_delete(instance, server_key, key, key_length, is_replying, is_buffering);
   }
@@ -144,7 +183,7 @@ memcached_return_t memcached_delete_by_key(memcached_st *shell, const char *grou
     } else {
       char buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
       rc = memcached_response(instance, buffer, MEMCACHED_DEFAULT_COMMAND_SIZE, NULL);
-      if (rc == MEMCACHED_DELETED) {
+      if (rc == MEMCACHED_DELETED or (rc == MEMCACHED_SUCCESS and memcached_is_meta(memc))) {
         rc = MEMCACHED_SUCCESS;
         if (memc->delete_trigger) {
           memc->delete_trigger(memc, key, key_length);
@@ -0,0 +1,543 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/common.h"
+#include "p9y/gettimeofday.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/* Servers scored per pass of the rendezvous kernel */
+#define RENDEZVOUS_CHUNK 64
+
+/* Maglev table entries per server, the paper keeps imbalance around 1% from 100 on */
+#define MAGLEV_POINTS_PER_SERVER 100
+
+/* Requests per server after which bounded loads are halved, so they follow the recent rate */
+#define BOUNDED_LOAD_WINDOW 64
+
+/*
+  Jump consistent hash, "A Fast, Minimal Memory, Consistent Hash Algorithm",
+  Lamping & Veach 2014. Moving from n to n+1 buckets relocates 1/(n+1) of the
+  keys, all of them to the new bucket.
+*/
+static uint32_t jump_consistent_hash(uint64_t key, uint32_t buckets) {
+  int64_t b = -1, j = 0;
+
+  while (j < int64_t(buckets)) {
+    b = j;
+    key = key * 2862933555777941757ULL + 1;
+    j = int64_t(double(b + 1) * (double(1LL << 31) / double((key >> 33) + 1)));
+  }
+
+  return uint32_t(b);
+}
+
+/* murmur3 finalizer */
+static inline uint32_t rendezvous_mix(uint32_t h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+/*
+  Natural logarithm of x in (0, 1] from the float exponent and the atanh series
+  of the mantissa. Relative error is below 1e-6 and there are no branches.
+*/
+static inline float rendezvous_log(float x) {
+  int32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  // exponent relative to sqrt(1/2), so the mantissa lands in [sqrt(1/2), sqrt(2))
+  int32_t exponent = (bits - 0x3F3504F3) >> 23;
+  bits -= exponent << 23;
+  float m;
+  memcpy(&m, &bits, sizeof(m));
+
+  float s = (m - 1.0f) / (m + 1.0f), s2 = s * s;
+  return float(exponent) * 0.69314718f
+      + 2.0f * s * (1.0f + s2 * (1.0f / 3.0f + s2 * (1.0f / 5.0f + s2 * (1.0f / 7.0f))));
+}
+
+/*
+  Score servers for a key as the arrival time -ln(u) / weight of an
+  exponential race; the earliest wins, so servers win in proportion to their
+  weight. Seeds and costs are separate arrays and the loop has no branches,
+  so the compiler runs it on SIMD lanes.
+*/
+static void rendezvous_score(const uint32_t *__restrict seed, const float *__restrict cost,
+                             float *__restrict score, uint32_t count, uint32_t hash) {
+  for (uint32_t x = 0; x < count; ++x) {
+    uint32_t h = rendezvous_mix(hash ^ seed[x]);
+    // 23 random bits, offset by half a step to stay inside (0, 1)
+    float u = (float(h >> 9) + 0.5f) * (1.0f / 8388608.0f);
+    score[x] = -rendezvous_log(u) * cost[x];
+  }
+}
+
+static uint32_t rendezvous_dispatch(const memcached_extension_st *extension, uint32_t hash) {
+  float score[RENDEZVOUS_CHUNK];
+  float best = INFINITY;
+  uint32_t winner = 0;
+
+  for (uint32_t base = 0; base < extension->rendezvous.count; base += RENDEZVOUS_CHUNK) {
+    uint32_t count = std::min(uint32_t(RENDEZVOUS_CHUNK), extension->rendezvous.count - base);
+    rendezvous_score(extension->rendezvous.seed + base, extension->rendezvous.cost + base, score,
+                     count, hash);
+    for (uint32_t x = 0; x < count; ++x) {
+      if (score[x] < best) {
+        best = score[x];
+        winner = base + x;
+      }
+    }
+  }
+
+  return winner;
+}
+
+/*
+  Seeds only depend on the server names, so changing the server list moves
+  only the keys won by added or removed servers. Ejected servers are masked
+  with an infinite cost instead.
+*/
+static memcached_return_t rendezvous_update(Memcached *ptr, memcached_extension_st *extension) {
+  uint32_t count = memcached_server_count(ptr);
+  memcached_instance_st *list = memcached_instance_list(ptr);
+
+  struct timeval now;
+  if (gettimeofday(&now, NULL)) {
+    return memcached_set_errno(*ptr, errno, MEMCACHED_AT);
+  }
+
+  extension->rendezvous.count = 0;
+  if (count == 0) {
+    return MEMCACHED_SUCCESS;
+  }
+
+  uint32_t *seed = libmemcached_xrealloc(ptr, extension->rendezvous.seed, count, uint32_t);
+  if (seed == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  extension->rendezvous.seed = seed;
+
+  float *cost = libmemcached_xrealloc(ptr, extension->rendezvous.cost, count, float);
+  if (cost == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  extension->rendezvous.cost = cost;
+
+  bool is_auto_ejecting = _is_auto_eject_host(ptr);
+  ptr->ketama.next_distribution_rebuild = 0;
+
+  for (uint32_t x = 0; x < count; ++x) {
+    char name[MEMCACHED_NI_MAXHOST + 1 + MEMCACHED_NI_MAXSERV];
+    int name_length =
+        snprintf(name, sizeof(name), "%s:%u", list[x]._hostname, (uint32_t) list[x].port());
+    if (size_t(name_length) >= sizeof(name) or name_length < 0) {
+      return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT,
+                                 memcached_literal_param("snprintf(sizeof(name))"));
+    }
+    seed[x] = libhashkit_digest(name, size_t(name_length), HASHKIT_HASH_MD5);
+
+    if (is_auto_ejecting and list[x].next_retry > now.tv_sec) {
+      cost[x] = INFINITY;
+      if (ptr->ketama.next_distribution_rebuild == 0
+          or list[x].next_retry < ptr->ketama.next_distribution_rebuild)
+      {
+        ptr->ketama.next_distribution_rebuild = list[x].next_retry;
+      }
+    } else {
+      cost[x] = 1.0f / float(list[x].weight);
+    }
+  }
+  extension->rendezvous.count = count;
+
+  return MEMCACHED_SUCCESS;
+}
+
+/*
+  Maglev table sizes. Resizing moves most keys, so the table starts at the
+  65521 entries of the paper and only grows beyond 655 servers.
+*/
+static const uint32_t maglev_primes[] = {65521, 131071, 262139, 524287, 1048573, 2097143, 4194301};
+
+static inline uint64_t maglev_signature(uint64_t signature, uint32_t value) {
+  // FNV-1a over 32 bit words
+  return (signature ^ value) * 0x100000001b3ULL;
+}
+
+/*
+  Every live server walks its own permutation offset, offset + skip, ... of
+  the table in turn and takes the first entry still free, until the table is
+  full. The permutation depends only on the server name, so clients with the
+  same servers build the same table; patching an existing table in place
+  would not, which is why a change of the live set rebuilds it.
+*/
+static memcached_return_t maglev_update(Memcached *ptr, memcached_extension_st *extension) {
+  uint32_t count = memcached_server_count(ptr);
+  memcached_instance_st *list = memcached_instance_list(ptr);
+
+  struct timeval now;
+  if (gettimeofday(&now, NULL)) {
+    return memcached_set_errno(*ptr, errno, MEMCACHED_AT);
+  }
+
+  if (count == 0) {
+    extension->maglev.size = 0;
+    extension->maglev.signature = 0;
+    return MEMCACHED_SUCCESS;
+  }
+
+  uint32_t *offset = libmemcached_xrealloc(ptr, extension->maglev.offset, count, uint32_t);
+  if (offset == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  extension->maglev.offset = offset;
+
+  uint32_t *skip = libmemcached_xrealloc(ptr, extension->maglev.skip, count, uint32_t);
+  if (skip == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  extension->maglev.skip = skip;
+
+  uint32_t *next = libmemcached_xrealloc(ptr, extension->maglev.next, count, uint32_t);
+  if (next == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  extension->maglev.next = next;
+
+  bool is_auto_ejecting = _is_auto_eject_host(ptr);
+  ptr->ketama.next_distribution_rebuild = 0;
+
+  uint32_t live = 0;
+  uint64_t signature = 0xcbf29ce484222325ULL;
+  for (uint32_t x = 0; x < count; ++x) {
+    if (is_auto_ejecting and list[x].next_retry > now.tv_sec) {
+      if (ptr->ketama.next_distribution_rebuild == 0
+          or list[x].next_retry < ptr->ketama.next_distribution_rebuild)
+      {
+        ptr->ketama.next_distribution_rebuild = list[x].next_retry;
+      }
+      offset[x] = skip[x] = 0;
+      signature = maglev_signature(signature, 0);
+      continue;
+    }
+
+    char name[MEMCACHED_NI_MAXHOST + 1 + MEMCACHED_NI_MAXSERV];
+    int name_length =
+        snprintf(name, sizeof(name), "%s:%u", list[x]._hostname, (uint32_t) list[x].port());
+    if (size_t(name_length) >= sizeof(name) or name_length < 0) {
+      return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT,
+                                 memcached_literal_param("snprintf(sizeof(name))"));
+    }
+    offset[x] = libhashkit_digest(name, size_t(name_length), HASHKIT_HASH_MD5);
+    skip[x] = libhashkit_digest(name, size_t(name_length), HASHKIT_HASH_FNV1A_32) | 1; // 0 marks ejected
+    signature = maglev_signature(maglev_signature(signature, offset[x]), skip[x]);
+    live++;
+  }
+
+  if (live == 0) {
+    extension->maglev.size = 0;
+    extension->maglev.signature = 0;
+    return MEMCACHED_SUCCESS;
+  }
+
+  if (extension->maglev.size and signature == extension->maglev.signature) {
+    // same live servers in the same order
+    return MEMCACHED_SUCCESS;
+  }
+
+  uint32_t size = maglev_primes[sizeof(maglev_primes) / sizeof(maglev_primes[0]) - 1];
+  for (uint32_t prime : maglev_primes) {
+    if (prime >= uint64_t(live) * MAGLEV_POINTS_PER_SERVER) {
+      size = prime;
+      break;
+    }
+  }
+
+  uint32_t *table = libmemcached_xrealloc(ptr, extension->maglev.table, size, uint32_t);
+  if (table == NULL) {
+    extension->maglev.size = 0;
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  extension->maglev.table = table;
+  memset(table, 0xff, sizeof(uint32_t) * size);
+
+  for (uint32_t x = 0; x < count; ++x) {
+    if (skip[x]) {
+      offset[x] %= size;
+      skip[x] = skip[x] % (size - 1) + 1;
+    }
+    next[x] = offset[x];
+  }
+
+  for (uint32_t filled = 0; filled < size;) {
+    for (uint32_t x = 0; x < count and filled < size; ++x) {
+      if (skip[x] == 0) {
+        continue;
+      }
+      uint32_t entry = next[x];
+      while (table[entry] != UINT32_MAX) {
+        entry += skip[x];
+        entry = entry >= size ? entry - size : entry;
+      }
+      table[entry] = x;
+      entry += skip[x];
+      next[x] = entry >= size ? entry - size : entry;
+      filled++;
+    }
+  }
+
+  extension->maglev.size = size;
+  extension->maglev.signature = signature;
+
+  return MEMCACHED_SUCCESS;
+}
+
+/*
+  Next point of another server on the walk, so a run of points of one server
+  costs a single step. walked grows by the points passed, the whole ring once
+  only one server is left.
+*/
+static inline uint32_t bounded_load_step(const Memcached *ptr, uint32_t position,
+                                         uint32_t &walked) {
+  uint32_t points = ptr->ketama.continuum_points_counter;
+  uint32_t next = memcached_continuum_next_server(ptr, position);
+  walked += next > position ? next - position : next + points - position;
+  return next;
+}
+
+/* Server of the n-th distinct server, counting from 1, on the walk from position */
+static uint32_t bounded_load_probe(const Memcached *ptr, uint32_t position, uint32_t n) {
+  const memcached_continuum_item_st *continuum = ptr->ketama.continuum;
+  uint32_t seen[MEMCACHED_BOUNDED_LOAD_PROBES_MAX];
+  uint32_t distinct = 0;
+
+  for (uint32_t walked = 0; walked < ptr->ketama.continuum_points_counter;) {
+    uint32_t index = continuum[position].index;
+    if (std::find(seen, seen + distinct, index) == seen + distinct) {
+      seen[distinct++] = index;
+      if (distinct == n or distinct == MEMCACHED_BOUNDED_LOAD_PROBES_MAX) {
+        break;
+      }
+    }
+    position = bounded_load_step(ptr, position, walked);
+  }
+
+  return seen[distinct - 1];
+}
+
+/*
+  A server may take ceil((1 + epsilon) * (total + 1) / servers) requests; the
+  key goes to the first server of its walk still below that. Some server is
+  always below it unless servers were ejected, then the ring owner is used.
+*/
+static uint32_t bounded_load_dispatch(const Memcached *ptr,
+                                      const memcached_extension_st *extension, uint32_t hash) {
+  uint32_t position = memcached_continuum_position(ptr, hash);
+  if (extension->bounded.probe) {
+    return bounded_load_probe(ptr, position, extension->bounded.probe);
+  }
+
+  const memcached_continuum_item_st *continuum = ptr->ketama.continuum;
+  const memcached_instance_st *list = memcached_instance_list(ptr);
+  uint64_t capacity = uint64_t(ceil((1.0 + extension->bounded.epsilon)
+                                    * double(extension->bounded.total + 1)
+                                    / double(memcached_server_count(ptr))));
+
+  uint32_t next = position;
+  for (uint32_t walked = 0; walked < ptr->ketama.continuum_points_counter;) {
+    uint32_t index = continuum[next].index;
+    if (list[index].bounded_load < capacity) {
+      return index;
+    }
+    next = bounded_load_step(ptr, next, walked);
+  }
+
+  return continuum[position].index;
+}
+
+memcached_return_t memcached_set_extended_distribution(Memcached *ptr, uint64_t type) {
+  switch (type) {
+  case MEMCACHED_DISTRIBUTION_JUMP:
+  case MEMCACHED_DISTRIBUTION_RENDEZVOUS:
+  case MEMCACHED_DISTRIBUTION_BOUNDED_LOAD:
+  case MEMCACHED_DISTRIBUTION_MAGLEV:
+    break;
+
+  default:
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("Invalid memcached_server_distribution_t"));
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  // the standard distribution code sees plain modulo, or builds the continuum walked by bounded loads
+  memcached_set_weighted_ketama(ptr, false);
+  ptr->distribution = MEMCACHED_DISTRIBUTION_MODULA;
+  if (type == MEMCACHED_DISTRIBUTION_BOUNDED_LOAD) {
+    ptr->distribution = MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA;
+    if (extension->bounded.epsilon == 0) {
+      extension->bounded.epsilon = float(MEMCACHED_BOUNDED_LOAD_EPSILON_DEFAULT);
+    }
+  }
+  extension->distribution = uint32_t(type);
+
+  return run_distribution(ptr);
+}
+
+memcached_return_t memcached_run_extended_distribution(Memcached *ptr) {
+  switch (memcached_extended_distribution(ptr)) {
+  case MEMCACHED_DISTRIBUTION_JUMP:
+    break;
+
+  case MEMCACHED_DISTRIBUTION_RENDEZVOUS:
+    return rendezvous_update(ptr, memcached_extension(ptr));
+
+  case MEMCACHED_DISTRIBUTION_MAGLEV:
+    return maglev_update(ptr, memcached_extension(ptr));
+
+  case MEMCACHED_DISTRIBUTION_BOUNDED_LOAD: {
+    // the server list changed, start counting again
+    memcached_extension_st *extension = memcached_extension(ptr);
+    memcached_instance_st *list = memcached_instance_list(ptr);
+    for (uint32_t x = 0; x < memcached_server_count(ptr); ++x) {
+      list[x].bounded_load = 0;
+    }
+    extension->bounded.total = 0;
+    break;
+  }
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+uint32_t memcached_dispatch_extended(const Memcached *ptr, uint32_t distribution, uint32_t hash) {
+  switch (distribution) {
+  case MEMCACHED_DISTRIBUTION_JUMP:
+    return jump_consistent_hash(hash, memcached_server_count(ptr));
+
+  case MEMCACHED_DISTRIBUTION_RENDEZVOUS: {
+    const memcached_extension_st *extension = memcached_extension(ptr);
+    if (extension->rendezvous.count == memcached_server_count(ptr)) {
+      return rendezvous_dispatch(extension, hash);
+    }
+    // not built yet
+    return hash % memcached_server_count(ptr);
+  }
+
+  case MEMCACHED_DISTRIBUTION_MAGLEV: {
+    const memcached_extension_st *extension = memcached_extension(ptr);
+    if (extension->maglev.size) {
+      // multiply and shift instead of a division by the prime
+      return extension->maglev.table[(uint64_t(hash) * extension->maglev.size) >> 32];
+    }
+    // not built yet, or no live server
+    return hash % memcached_server_count(ptr);
+  }
+
+  case MEMCACHED_DISTRIBUTION_BOUNDED_LOAD:
+    if (ptr->ketama.continuum_points_counter) {
+      return bounded_load_dispatch(ptr, memcached_extension(ptr), hash);
+    }
+    return hash % memcached_server_count(ptr);
+  }
+
+  WATCHPOINT_ASSERT(0);
+  return hash % memcached_server_count(ptr);
+}
+
+void memcached_bounded_load_account(Memcached *ptr, uint32_t hash, uint32_t server_key) {
+  memcached_extension_st *extension = memcached_extension(ptr);
+  memcached_instance_st *list = memcached_instance_list(ptr);
+  uint32_t count = memcached_server_count(ptr);
+
+  extension->bounded.requests++;
+  if (extension->bounded.probe == 0 and ptr->ketama.continuum_points_counter
+      and ptr->ketama.continuum[memcached_continuum_position(ptr, hash)].index != server_key)
+  {
+    extension->bounded.overflows++;
+  }
+
+  list[server_key].bounded_load++;
+  if (++extension->bounded.total >= uint64_t(BOUNDED_LOAD_WINDOW) * count) {
+    extension->bounded.total = 0;
+    for (uint32_t x = 0; x < count; ++x) {
+      list[x].bounded_load /= 2;
+      extension->bounded.total += list[x].bounded_load;
+    }
+  }
+}
+
+uint32_t memcached_bounded_load_probes(const Memcached *ptr) {
+  const memcached_extension_st *extension = memcached_extension(ptr);
+  uint32_t probes = 1 + uint32_t(ceil(1.0 / extension->bounded.epsilon));
+
+  return std::min(std::min(probes, uint32_t(MEMCACHED_BOUNDED_LOAD_PROBES_MAX)),
+                  memcached_server_count(ptr));
+}
+
+memcached_return_t memcached_set_bounded_load(memcached_st *shell, double epsilon) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (not(epsilon > 0)) {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("epsilon must be greater than 0"));
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  extension->bounded.epsilon = float(epsilon);
+
+  return MEMCACHED_SUCCESS;
+}
+
+double memcached_get_bounded_load(const memcached_st *shell) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  const memcached_extension_st *extension = ptr ? memcached_extension(ptr) : NULL;
+  if (extension == NULL or extension->bounded.epsilon == 0) {
+    return MEMCACHED_BOUNDED_LOAD_EPSILON_DEFAULT;
+  }
+
+  return extension->bounded.epsilon;
+}
+
+void memcached_bounded_load_stat(const memcached_st *shell,
+                                 struct memcached_bounded_load_stat_st *stat) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      stat->requests = extension->bounded.requests;
+      stat->overflows = extension->bounded.overflows;
+      stat->probes = extension->bounded.probes;
+      stat->probe_hits = extension->bounded.probe_hits;
+    }
+  }
+}
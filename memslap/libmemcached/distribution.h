@@ -0,0 +1,109 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Distributions in addition to memcached_server_distribution_t.
+ *
+ * They are selected like the others, with
+ * memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_DISTRIBUTION, <value>), and
+ * reported by memcached_behavior_get(). memcached_behavior_get_distribution()
+ * only knows the standard ones and reports MEMCACHED_DISTRIBUTION_MODULA.
+ */
+#define MEMCACHED_DISTRIBUTION_EXTENDED 0x100
+
+/* Jump consistent hash (Lamping & Veach): no table, O(ln n) lookup */
+#define MEMCACHED_DISTRIBUTION_JUMP (MEMCACHED_DISTRIBUTION_EXTENDED + 1)
+/* Weighted rendezvous hashing: every server scores every key, server weights are honoured */
+#define MEMCACHED_DISTRIBUTION_RENDEZVOUS (MEMCACHED_DISTRIBUTION_EXTENDED + 2)
+/*
+ * Consistent hashing with bounded loads (Mirrokni, Thorup & Zadimoghaddam):
+ * the ketama continuum, but a server already serving more than (1 + epsilon)
+ * times the average share of the recent requests of the handle is skipped and
+ * the key walks on to the next server of the ring.
+ *
+ * A memcached_get() that misses retries the following servers of the same
+ * walk, ignoring load, up to 1 + 1/epsilon servers (at most
+ * MEMCACHED_BOUNDED_LOAD_PROBES_MAX). Keys that overflowed further than that,
+ * or were fetched with memcached_mget(), read as misses. A value rewritten
+ * while an earlier server of its walk was full can leave an older copy there
+ * until it expires or is evicted.
+ */
+#define MEMCACHED_DISTRIBUTION_BOUNDED_LOAD (MEMCACHED_DISTRIBUTION_EXTENDED + 3)
+
+#define MEMCACHED_BOUNDED_LOAD_EPSILON_DEFAULT 0.25
+#define MEMCACHED_BOUNDED_LOAD_PROBES_MAX      8
+
+struct memcached_bounded_load_stat_st {
+  uint64_t requests;   /* keys dispatched */
+  uint64_t overflows;  /* keys sent past their ring owner because it was full */
+  uint64_t probes;     /* gets repeated on a later server of the walk after a miss */
+  uint64_t probe_hits; /* probes that found the key */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Set the load bound of MEMCACHED_DISTRIBUTION_BOUNDED_LOAD.
+ *
+ * @param epsilon servers take at most (1 + epsilon) times the average load, must be > 0
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_set_bounded_load(memcached_st *ptr, double epsilon);
+
+LIBMEMCACHED_API
+double memcached_get_bounded_load(const memcached_st *ptr);
+
+LIBMEMCACHED_API
+void memcached_bounded_load_stat(const memcached_st *ptr,
+                                 struct memcached_bounded_load_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * Maglev hashing (Eisenbud et al.): a prime sized table of at least 65521 and
+ * at least 100 entries per server, filled from a permutation of the table per
+ * server. A lookup is a single table load. The table is only rebuilt when the
+ * set of live servers changes, and all clients build the same table for the
+ * same servers.
+ */
+#define MEMCACHED_DISTRIBUTION_MAGLEV (MEMCACHED_DISTRIBUTION_EXTENDED + 4)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Server of every key, like memcached_generate_hash() called on each of them.
+ *
+ * The default one-at-a-time hash is computed several keys at a time, and
+ * with MEMCACHED_BEHAVIOR_HASH_WITH_PREFIX_KEY the namespace is hashed once
+ * instead of being copied in front of every key.
+ *
+ * @param server_key receives number_of_keys server indices
+ */
+LIBMEMCACHED_API
+void memcached_generate_hash_batch(const memcached_st *ptr, const char *const *keys,
+                                   const size_t *key_length, size_t number_of_keys,
+                                   uint32_t *server_key);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,39 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/* The MEMCACHED_DISTRIBUTION_* of distribution.h in use, 0 for a standard one */
+static inline uint32_t memcached_extended_distribution(const Memcached *ptr) {
+  const memcached_extension_st *extension = memcached_extension(ptr);
+  return extension ? extension->distribution : 0;
+}
+
+memcached_return_t memcached_set_extended_distribution(Memcached *ptr, uint64_t type);
+
+/* Rebuild any state of the extended distribution after the server list changed */
+memcached_return_t memcached_run_extended_distribution(Memcached *ptr);
+
+uint32_t memcached_dispatch_extended(const Memcached *ptr, uint32_t distribution, uint32_t hash);
+
+static inline bool memcached_is_bounded_load(const Memcached *ptr) {
+  return memcached_extended_distribution(ptr) == MEMCACHED_DISTRIBUTION_BOUNDED_LOAD;
+}
+
+/* Charges a dispatched request to its server */
+void memcached_bounded_load_account(Memcached *ptr, uint32_t hash, uint32_t server_key);
+
+/* Number of servers on the walk of a key a get tries before reporting a miss */
+uint32_t memcached_bounded_load_probes(const Memcached *ptr);
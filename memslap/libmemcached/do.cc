@@ -24,6 +24,15 @@ static memcached_return_t _vdo_udp(memcached_instance_st *instance,
         memcached_literal_param("UDP messages was attempted, but vector was not setup for it"));
   }
 
+  // the buffer holds the datagram header, and is dropped when UDP was enabled later
+  if (instance->write_buffer == NULL) {
+    if (memcached_instance_write_buffer(instance) == false) {
+      return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+    instance->write_buffer_offset = UDP_DATAGRAM_HEADER_LENGTH;
+    memcached_io_init_udp_header(instance, 0);
+  }
+
   struct msghdr msg;
   memset(&msg, 0, sizeof(msg));
 
@@ -40,6 +49,7 @@ static memcached_return_t _vdo_udp(memcached_instance_st *instance,
 
   uint32_t retry = 5;
   while (--retry) {
+    memcached_io_count_send(instance->root);
     ssize_t sendmsg_length = ::sendmsg(instance->fd, &msg, 0);
     if (sendmsg_length > 0) {
       break;
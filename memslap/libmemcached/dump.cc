@@ -15,8 +15,22 @@
 
 #include "libmemcached/common.h"
 
-static memcached_return_t ascii_dump(Memcached *memc, memcached_dump_fn *callback, void *context,
-                                     uint32_t number_of_callbacks) {
+/* "[size b; expiration s]" after the key, both are left 0 if it is missing */
+static void ascii_dump_details(const char *details, memcached_dump_item_st &item) {
+  const char *begin = strchr(details, '[');
+  if (begin == NULL) {
+    return;
+  }
+  char *end;
+  item.size = size_t(strtoull(begin + 1, &end, 10));
+  const char *separator = strchr(end, ';');
+  if (separator) {
+    item.expiration = time_t(strtoull(separator + 1, NULL, 10));
+  }
+}
+
+static memcached_return_t ascii_dump(Memcached *memc, memcached_dump_item_fn callback,
+                                     void *context) {
   memcached_version(memc);
   /* MAX_NUMBER_OF_SLAB_CLASSES is defined to 200 in Memcached 1.4.10 */
   for (uint32_t x = 0; x < 200; x++) {
@@ -61,18 +75,20 @@ static memcached_return_t ascii_dump(Memcached *memc, memcached_dump_fn *callbac
         for (end_ptr = string_ptr; isgraph(*end_ptr); end_ptr++) {
         };
 
-        char *key = string_ptr;
-        key[(size_t)(end_ptr - string_ptr)] = 0;
-
-        for (uint32_t callback_counter = 0; callback_counter < number_of_callbacks;
-             callback_counter++) {
-          memcached_return_t callback_rc =
-              (*callback[callback_counter])(memc, key, (size_t)(end_ptr - string_ptr), context);
-          if (callback_rc != MEMCACHED_SUCCESS) {
-            // @todo build up a message for the error from the value
-            memcached_set_error(*instance, callback_rc, MEMCACHED_AT);
-            break;
-          }
+        memcached_dump_item_st item = {};
+        item.key = string_ptr;
+        item.key_length = (size_t)(end_ptr - string_ptr);
+        item.server_key = uint32_t(instance - memcached_instance_list(memc));
+        item.slab = x;
+        if (*end_ptr) {
+          ascii_dump_details(end_ptr + 1, item);
+        }
+        *end_ptr = 0;
+
+        memcached_return_t callback_rc = callback(memc, &item, context);
+        if (callback_rc != MEMCACHED_SUCCESS) {
+          // @todo build up a message for the error from the value
+          memcached_set_error(*instance, callback_rc, MEMCACHED_AT);
         }
       } else if (response_rc == MEMCACHED_END) {
         // All items have been returned
@@ -109,9 +125,26 @@ static memcached_return_t ascii_dump(Memcached *memc, memcached_dump_fn *callbac
   return memcached_has_current_error(*memc) ? MEMCACHED_SOME_ERRORS : MEMCACHED_SUCCESS;
 }
 
-memcached_return_t memcached_dump(memcached_st *shell, memcached_dump_fn *callback, void *context,
-                                  uint32_t number_of_callbacks) {
-  Memcached *ptr = memcached2Memcached(shell);
+struct dump_keys_st {
+  memcached_dump_fn *callback;
+  uint32_t number_of_callbacks;
+  void *context;
+};
+
+static memcached_return_t dump_keys(const memcached_st *ptr, const memcached_dump_item_st *item,
+                                    void *context) {
+  dump_keys_st *keys = static_cast<dump_keys_st *>(context);
+  for (uint32_t x = 0; x < keys->number_of_callbacks; x++) {
+    memcached_return_t rc = (*keys->callback[x])(ptr, item->key, item->key_length, keys->context);
+    if (rc != MEMCACHED_SUCCESS) {
+      return rc;
+    }
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+static memcached_return_t dump_start(Memcached *ptr) {
   memcached_return_t rc;
   if (memcached_failed(rc = initialize_query(ptr, true))) {
     return rc;
@@ -127,5 +160,28 @@ memcached_return_t memcached_dump(memcached_st *shell, memcached_dump_fn *callba
         memcached_literal_param("Binary protocol is not supported for memcached_dump()"));
   }
 
-  return ascii_dump(ptr, callback, context, number_of_callbacks);
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_dump(memcached_st *shell, memcached_dump_fn *callback, void *context,
+                                  uint32_t number_of_callbacks) {
+  Memcached *ptr = memcached2Memcached(shell);
+  memcached_return_t rc;
+  if (memcached_failed(rc = dump_start(ptr))) {
+    return rc;
+  }
+
+  dump_keys_st keys = {callback, number_of_callbacks, context};
+  return ascii_dump(ptr, dump_keys, &keys);
+}
+
+memcached_return_t memcached_dump_items(memcached_st *shell, memcached_dump_item_fn callback,
+                                        void *context) {
+  Memcached *ptr = memcached2Memcached(shell);
+  memcached_return_t rc;
+  if (memcached_failed(rc = dump_start(ptr))) {
+    return rc;
+  }
+
+  return ascii_dump(ptr, callback, context);
 }
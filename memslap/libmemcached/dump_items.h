@@ -0,0 +1,56 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Key listing with the item details of stats cachedump.
+ *
+ * memcached_dump() passes its callbacks the key only. memcached_dump_items()
+ * passes the whole "ITEM key [size b; expiration s]" line, plus the server
+ * and slab class it came from, so callers can tell how many items of each
+ * slab were listed. The server caps the cachedump output of a slab class at
+ * 2 MB, keys beyond that are not listed.
+ */
+
+struct memcached_dump_item_st {
+  const char *key;
+  size_t key_length;
+  size_t size;       /* of the value */
+  time_t expiration; /* absolute unix time, 0 for items which never expire */
+  uint32_t server_key;
+  uint32_t slab;
+};
+
+typedef memcached_return_t (*memcached_dump_item_fn)(const memcached_st *ptr,
+                                                     const struct memcached_dump_item_st *item,
+                                                     void *context);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * memcached_dump() passing callback the details of every item.
+ *
+ * Text protocol only, like memcached_dump().
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_dump_items(memcached_st *ptr, memcached_dump_item_fn callback,
+                                        void *context);
+
+#ifdef __cplusplus
+}
+#endif
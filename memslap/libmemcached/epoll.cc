@@ -0,0 +1,277 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/common.h"
+#include "p9y/poll.hpp"
+#include "p9y/clock_gettime.hpp"
+
+#ifdef __linux__
+#  include <sys/epoll.h>
+#endif
+
+/* Events taken per epoll_wait() */
+#define EPOLL_EVENTS 64
+
+/* Sockets of a closed or new epoll set are not in it */
+static void epoll_forget(Memcached *ptr) {
+  for (uint32_t x = 0; x < memcached_server_count(ptr); ++x) {
+    memcached_instance_st *instance = memcached_instance_fetch(ptr, x);
+    instance->epoll.registered = false;
+    instance->epoll.readable = false;
+  }
+}
+
+#ifdef __linux__
+
+/*
+  Sockets stay registered until they are closed. The event data is the
+  server index and the socket, so events of a socket closed since, whose
+  descriptor was reused by another server, are told apart.
+*/
+static bool epoll_register(Memcached *ptr, memcached_extension_st *extension,
+                           memcached_instance_st *instance) {
+  if (instance->epoll.registered) {
+    return true;
+  }
+
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+  event.data.u64 = (uint64_t(instance - memcached_instance_list(ptr)) << 32) | uint32_t(instance->fd);
+
+  extension->epoll.epoll_ctls++;
+  if (epoll_ctl(extension->epoll.fd, EPOLL_CTL_ADD, instance->fd, &event) == -1
+      and (errno != EEXIST
+           or epoll_ctl(extension->epoll.fd, EPOLL_CTL_MOD, instance->fd, &event) == -1))
+  {
+    return false;
+  }
+
+  instance->epoll.registered = true;
+  return true;
+}
+
+/* Marks the servers of the events readable, returns what epoll_wait() returned */
+static int epoll_collect(Memcached *ptr, memcached_extension_st *extension, int timeout) {
+  epoll_event events[EPOLL_EVENTS];
+
+  extension->epoll.epoll_waits++;
+  int active = epoll_wait(extension->epoll.fd, events, EPOLL_EVENTS, timeout);
+  for (int x = 0; x < active; ++x) {
+    uint32_t index = uint32_t(events[x].data.u64 >> 32);
+    if (index < memcached_server_count(ptr)) {
+      memcached_instance_st *instance = memcached_instance_fetch(ptr, index);
+      if (instance->epoll.registered and uint32_t(instance->fd) == uint32_t(events[x].data.u64)) {
+        instance->epoll.readable = true;
+      }
+    }
+  }
+
+  return active;
+}
+
+memcached_instance_st *memcached_epoll_readable(Memcached *ptr) {
+  memcached_extension_st *extension = memcached_extension(ptr);
+
+  while (true) {
+    memcached_instance_st *pending = NULL;
+    uint32_t pending_count = 0;
+
+    for (uint32_t x = 0; x < memcached_server_count(ptr); ++x) {
+      memcached_instance_st *instance = memcached_instance_fetch(ptr, x);
+
+      if (instance->read_buffer_length > 0 or (instance->response_count() and instance->epoll.readable))
+      {
+        return instance;
+      }
+
+      if (instance->response_count()) {
+        if (epoll_register(ptr, extension, instance) == false) {
+          // reading it blocks, but still makes progress
+          return instance;
+        }
+        pending = instance;
+        pending_count++;
+      }
+    }
+
+    /* We have 0 or 1 server with pending events.. */
+    if (pending_count < 2) {
+      return pending;
+    }
+
+    int active = epoll_collect(ptr, extension, ptr->poll_timeout);
+    if (active == -1) {
+      memcached_set_errno(*ptr, get_socket_errno(), MEMCACHED_AT);
+      return NULL;
+    }
+    if (active == 0) {
+      return NULL;
+    }
+  }
+}
+
+memcached_return_t memcached_epoll_wait_for_read(memcached_instance_st *instance) {
+  Memcached *ptr = instance->root;
+  memcached_extension_st *extension = memcached_extension(ptr);
+
+  if (epoll_register(ptr, extension, instance) == false) {
+    return memcached_io_poll(instance, POLLIN);
+  }
+
+  int32_t timeout = ptr->poll_timeout;
+  if (timeout == 0) {
+    return memcached_set_error(*instance, MEMCACHED_TIMEOUT, MEMCACHED_AT,
+                               memcached_literal_param("timeout was set to zero"));
+  }
+
+  timespec tspec{};
+  if (clock_gettime(CLOCK_MONOTONIC, &tspec)) {
+    return memcached_set_errno(*instance, errno, MEMCACHED_AT,
+                               memcached_literal_param("clock_gettime()"));
+  }
+  int64_t start = int64_t(tspec.tv_sec) * 1000 + tspec.tv_nsec / 1000000; // ms
+
+  // readiness of other servers seen meanwhile is kept for their turn
+  while (instance->epoll.readable == false) {
+    int remaining = -1;
+    if (timeout > 0) {
+      clock_gettime(CLOCK_MONOTONIC, &tspec);
+      remaining = int(timeout - (int64_t(tspec.tv_sec) * 1000 + tspec.tv_nsec / 1000000 - start));
+      if (remaining <= 0) {
+        return memcached_set_error(*instance, MEMCACHED_TIMEOUT, MEMCACHED_AT,
+                                   memcached_literal_param("time out"));
+      }
+    }
+
+    int active = epoll_collect(ptr, extension, remaining);
+    if (active == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return memcached_set_errno(*instance, errno, MEMCACHED_AT,
+                                 memcached_literal_param("epoll_wait()"));
+    }
+    if (active == 0) {
+      return memcached_set_error(*instance, MEMCACHED_TIMEOUT, MEMCACHED_AT,
+                                 memcached_literal_param("time out"));
+    }
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_epoll_open(Memcached *ptr, memcached_extension_st *extension) {
+  int fd = epoll_create1(EPOLL_CLOEXEC);
+  if (fd == -1) {
+    return memcached_set_errno(*ptr, errno, MEMCACHED_AT, memcached_literal_param("epoll_create1()"));
+  }
+
+  extension->epoll.fd = fd;
+  extension->epoll.enabled = true;
+  epoll_forget(ptr);
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_epoll_close(Memcached *, memcached_extension_st *extension) {
+  if (extension->epoll.enabled) {
+    close(extension->epoll.fd);
+    extension->epoll.enabled = false;
+  }
+}
+
+#else // no epoll
+
+memcached_instance_st *memcached_epoll_readable(Memcached *) {
+  return NULL;
+}
+
+memcached_return_t memcached_epoll_wait_for_read(memcached_instance_st *instance) {
+  return memcached_io_poll(instance, POLLIN);
+}
+
+memcached_return_t memcached_epoll_open(Memcached *ptr, memcached_extension_st *) {
+  return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+                             memcached_literal_param("epoll is not available"));
+}
+
+void memcached_epoll_close(Memcached *, memcached_extension_st *) {}
+
+#endif
+
+memcached_return_t memcached_set_epoll(memcached_st *shell, bool enable) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  if (enable == extension->epoll.enabled) {
+    return MEMCACHED_SUCCESS;
+  }
+
+  if (enable) {
+    return memcached_epoll_open(ptr, extension);
+  }
+
+  memcached_epoll_close(ptr, extension);
+  epoll_forget(ptr);
+
+  return MEMCACHED_SUCCESS;
+}
+
+bool memcached_get_epoll(const memcached_st *shell) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (ptr) {
+    return memcached_is_epoll(ptr);
+  }
+
+  return false;
+}
+
+void memcached_epoll_stat(const memcached_st *shell, struct memcached_epoll_stat_st *stat) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      stat->polls = extension->epoll.polls;
+      stat->epoll_waits = extension->epoll.epoll_waits;
+      stat->epoll_ctls = extension->epoll.epoll_ctls;
+    }
+  }
+}
+
+void memcached_io_stat(const memcached_st *shell, struct memcached_io_stat_st *stat) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      stat->sends = extension->io.sends;
+      stat->recvs = extension->io.recvs;
+    }
+  }
+}
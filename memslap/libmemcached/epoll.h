@@ -0,0 +1,66 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * epoll readiness tracking (Linux only).
+ *
+ * Without it, every response of a multi-get, and every wait for a single
+ * server, builds a pollfd array of the servers with pending responses and
+ * calls poll(). With epoll enabled, the handle keeps one epoll descriptor
+ * with the sockets of its servers registered once, edge-triggered, for as
+ * long as they stay connected. Waits for any server, as in
+ * memcached_fetch(), and waits for one server, as in purges, both take the
+ * readiness of all servers from it. Clones open their own descriptor.
+ */
+
+struct memcached_epoll_stat_st {
+  uint64_t polls;       /* poll() calls of the handle */
+  uint64_t epoll_waits; /* epoll_wait() calls */
+  uint64_t epoll_ctls;  /* sockets registered with epoll_ctl() */
+};
+
+/* System calls reading and writing the sockets of the handle */
+struct memcached_io_stat_st {
+  uint64_t sends; /* send() and sendmsg() calls */
+  uint64_t recvs; /* recv() calls */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Enable epoll readiness tracking, MEMCACHED_NOT_SUPPORTED where there is
+ * no epoll. The counters of memcached_epoll_stat() are kept for the handle
+ * once this was called, with either value.
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_set_epoll(memcached_st *ptr, bool enable);
+
+LIBMEMCACHED_API
+bool memcached_get_epoll(const memcached_st *ptr);
+
+LIBMEMCACHED_API
+void memcached_epoll_stat(const memcached_st *ptr, struct memcached_epoll_stat_st *stat);
+
+/* Kept like the counters of memcached_epoll_stat() */
+LIBMEMCACHED_API
+void memcached_io_stat(const memcached_st *ptr, struct memcached_io_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
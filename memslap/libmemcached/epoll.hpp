@@ -0,0 +1,49 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+static inline bool memcached_is_epoll(const Memcached *ptr) {
+  const memcached_extension_st *extension = memcached_extension(ptr);
+  return extension and extension->epoll.enabled;
+}
+
+static inline void memcached_epoll_count_poll(const Memcached *ptr) {
+  if (memcached_extension_st *extension = memcached_extension(ptr)) {
+    extension->epoll.polls++;
+  }
+}
+
+static inline void memcached_io_count_send(const Memcached *ptr) {
+  if (memcached_extension_st *extension = memcached_extension(ptr)) {
+    extension->io.sends++;
+  }
+}
+
+static inline void memcached_io_count_recv(const Memcached *ptr) {
+  if (memcached_extension_st *extension = memcached_extension(ptr)) {
+    extension->io.recvs++;
+  }
+}
+
+/* memcached_io_get_readable_server() through the epoll set */
+memcached_instance_st *memcached_epoll_readable(Memcached *ptr);
+
+/* Waits until instance is readable, after recv() ran dry */
+memcached_return_t memcached_epoll_wait_for_read(memcached_instance_st *instance);
+
+/* The epoll descriptor of a handle, with no socket registered yet */
+memcached_return_t memcached_epoll_open(Memcached *ptr, memcached_extension_st *extension);
+void memcached_epoll_close(Memcached *ptr, memcached_extension_st *extension);
@@ -0,0 +1,159 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/common.h"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+/*
+  The table is only written while handles are configured, cloned or freed.
+  Lookups are served from a per-thread cache which stays valid until the
+  table changes, so the per-request cost is one atomic load.
+*/
+static std::mutex extension_lock;
+static std::unordered_map<const memcached_st *, memcached_extension_st *> extension_table;
+static std::atomic<uint64_t> extension_generation{0};
+
+static thread_local struct {
+  const memcached_st *owner;
+  uint64_t generation;
+  memcached_extension_st *extension;
+} extension_cache = {NULL, 0, NULL};
+
+memcached_extension_st *memcached_extension(const memcached_st *ptr) {
+  uint64_t generation = extension_generation.load(std::memory_order_acquire);
+  if (generation == 0) {
+    return NULL;
+  }
+
+  if (extension_cache.owner == ptr and extension_cache.generation == generation) {
+    return extension_cache.extension;
+  }
+
+  std::lock_guard<std::mutex> guard(extension_lock);
+  auto found = extension_table.find(ptr);
+
+  extension_cache.owner = ptr;
+  extension_cache.generation = extension_generation.load(std::memory_order_relaxed);
+  extension_cache.extension = found == extension_table.end() ? NULL : found->second;
+
+  return extension_cache.extension;
+}
+
+memcached_extension_st *memcached_extension_fetch(memcached_st *ptr) {
+  memcached_extension_st *extension = memcached_extension(ptr);
+  if (extension) {
+    return extension;
+  }
+
+  extension = libmemcached_xmalloc(ptr, memcached_extension_st);
+  if (extension == NULL) {
+    return NULL;
+  }
+  memset(extension, 0, sizeof(*extension));
+
+  std::lock_guard<std::mutex> guard(extension_lock);
+  extension_table[ptr] = extension;
+  extension_generation.fetch_add(1, std::memory_order_release);
+
+  return extension;
+}
+
+char *memcached_extension_buffer(memcached_st *ptr, memcached_extension_st *extension,
+                                 size_t length) {
+  if (extension->buffer_size < length) {
+    char *buffer = libmemcached_xrealloc(ptr, extension->buffer, length, char);
+    if (buffer == NULL) {
+      return NULL;
+    }
+    extension->buffer = buffer;
+    extension->buffer_size = length;
+  }
+
+  return extension->buffer;
+}
+
+memcached_return_t memcached_extension_clone(memcached_st *destination,
+                                             const memcached_st *source) {
+  const memcached_extension_st *origin = memcached_extension(source);
+  if (origin == NULL) {
+    return MEMCACHED_SUCCESS;
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(destination);
+  if (extension == NULL) {
+    return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+  }
+
+  // settings only, counters and scratch space stay with each handle
+  extension->compression.threshold = origin->compression.threshold;
+  extension->compression.level = origin->compression.level;
+  extension->hedge.percentile = origin->hedge.percentile;
+  if (extension->replica_read.load == NULL) {
+    extension->replica_read.load = memcached_replica_load_share(origin->replica_read.load);
+  }
+  if (origin->epoll.enabled and extension->epoll.enabled == false) {
+    memcached_return_t rc = memcached_epoll_open(destination, extension);
+    if (memcached_failed(rc)) {
+      return rc;
+    }
+  }
+  extension->read_through.loader = origin->read_through.loader;
+  extension->read_through.context = origin->read_through.context;
+  extension->distribution = origin->distribution;
+  extension->meta = origin->meta;
+  extension->async.callback = origin->async.callback;
+  extension->async.context = origin->async.context;
+  extension->async.depth = origin->async.depth;
+  extension->udp.timeout = origin->udp.timeout;
+  extension->bounded.epsilon = origin->bounded.epsilon;
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_extension_free(memcached_st *ptr) {
+  memcached_extension_st *extension = NULL;
+
+  if (extension_generation.load(std::memory_order_acquire) == 0) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(extension_lock);
+    auto found = extension_table.find(ptr);
+    if (found == extension_table.end()) {
+      return;
+    }
+    extension = found->second;
+    extension_table.erase(found);
+    extension_generation.fetch_add(1, std::memory_order_release);
+  }
+
+  memcached_replica_load_release(extension->replica_read.load);
+  memcached_epoll_close(ptr, extension);
+  if (extension->udp.fallback) {
+    memcached_free(extension->udp.fallback);
+  }
+  libmemcached_free(ptr, extension->buffer);
+  libmemcached_free(ptr, extension->rendezvous.seed);
+  libmemcached_free(ptr, extension->rendezvous.cost);
+  libmemcached_free(ptr, extension->maglev.table);
+  libmemcached_free(ptr, extension->maglev.offset);
+  libmemcached_free(ptr, extension->maglev.skip);
+  libmemcached_free(ptr, extension->maglev.next);
+  libmemcached_free(ptr, extension);
+}
@@ -0,0 +1,183 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+#include "libmemcached/read_through.h"
+#include "libmemcached/get_into.h"
+#include "libmemcached/async.h"
+
+/* Where requests for keys of migrating virtual buckets go */
+enum memcached_bucket_route_t {
+  MEMCACHED_BUCKET_ROUTE_MASTER,  // the new server
+  MEMCACHED_BUCKET_ROUTE_PINNED,  // the new server, the migration logic is running
+  MEMCACHED_BUCKET_ROUTE_FORWARD, // the previous server
+};
+
+/*
+  Per-handle state for features whose settings do not fit into the public
+  memcached_st. Entries are created on first configuration, copied by
+  memcached_clone() and released by memcached_free().
+*/
+struct memcached_extension_st {
+  struct {
+    size_t threshold; // 0 disables compression
+    int level;
+    uint64_t values_compressed;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t values_decompressed;
+  } compression;
+
+  struct {
+    uint32_t percentile; // 0 disables hedging
+    uint32_t pending;    // servers with an unread losing answer
+    uint64_t rng;        // picks the replica to hedge to, 0 until the first get
+    uint64_t requests;
+    uint64_t hedged;
+    uint64_t replica_wins;
+    uint64_t wasted;
+  } hedge;
+
+  // least-loaded replica reads, see replica_read.h
+  struct {
+    struct memcached_replica_load_st *load; // shared by clones, NULL if disabled
+    uint32_t server; // of the single get in flight
+    bool pending;    // server and start are set
+    int64_t start;   // its send time in microseconds
+    uint64_t rng;    // picks the copies to compare, 0 until the first pick
+    uint64_t reads;
+    uint64_t replica_reads;
+  } replica_read;
+
+  // readiness through epoll, see epoll.h
+  struct {
+    bool enabled;
+    int fd; // epoll descriptor while enabled
+    uint64_t polls;
+    uint64_t epoll_waits;
+    uint64_t epoll_ctls;
+  } epoll;
+
+  // socket system calls, see memcached_io_stat() in epoll.h
+  struct {
+    uint64_t sends;
+    uint64_t recvs;
+  } io;
+
+  bool meta; // MEMCACHED_PROTOCOL_META, see meta.h
+
+  // pipelined requests, see async.h
+  struct {
+    memcached_async_fn callback;
+    void *context;
+    uint32_t depth;   // per connection, 0 for MEMCACHED_ASYNC_DEPTH_DEFAULT
+    uint32_t pending; // in flight on all connections
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t waits;
+    uint64_t polls;
+  } async;
+
+  // gets over UDP, see udp.h
+  struct {
+    uint32_t timeout;       // milliseconds, 0 for MEMCACHED_UDP_TIMEOUT_DEFAULT
+    memcached_st *fallback; // TCP clone for lost responses, made on first use
+    uint64_t requests;
+    uint64_t datagrams_received;
+    uint64_t lost;
+    uint64_t fallback_keys;
+  } udp;
+
+  // destination of the value of the get in flight, see get_into.h
+  struct {
+    bool active;
+    bool delivered;   // the value went there instead of into the result
+    char *buffer;     // memcached_get_into()
+    size_t size;
+    size_t length;    // of the delivered value
+    memcached_value_fn callback; // memcached_get_view()
+    void *context;
+    memcached_return_t rc; // of the callback
+  } sink;
+
+  struct {
+    memcached_read_through_fn loader;
+    void *context;
+    uint64_t loads;
+    uint64_t keys_missed;
+    uint64_t keys_loaded;
+  } read_through;
+
+  uint32_t distribution; // one of distribution.h, 0 for memcached_server_distribution_t
+
+  // per server state of MEMCACHED_DISTRIBUTION_RENDEZVOUS, as separate arrays for the scoring loop
+  struct {
+    uint32_t *seed;
+    float *cost; // 1 / weight, infinite for ejected servers
+    uint32_t count;
+  } rendezvous;
+
+  // virtual bucket migration, see bucket_migration.h
+  struct {
+    memcached_bucket_route_t route;
+    uint64_t forward_reads;
+    uint64_t forward_hits;
+    uint64_t copied;
+  } bucket;
+
+  // MEMCACHED_DISTRIBUTION_MAGLEV
+  struct {
+    uint32_t *table; // server per entry
+    uint32_t size;   // prime, 0 until built
+    uint32_t *offset; // per server: first entry of its permutation
+    uint32_t *skip;   // per server: step of its permutation, 0 for ejected servers
+    uint32_t *next;   // per server: fill cursor
+    uint64_t signature; // of the servers the table was built for
+  } maglev;
+
+  // MEMCACHED_DISTRIBUTION_BOUNDED_LOAD
+  struct {
+    float epsilon;   // 0 until configured, then MEMCACHED_BOUNDED_LOAD_EPSILON_DEFAULT
+    uint32_t probe;  // while a get probes the ring: 1 + position on the walk, else 0
+    uint64_t total;  // sum of the decayed server loads
+    uint64_t requests;
+    uint64_t overflows;
+    uint64_t probes;
+    uint64_t probe_hits;
+  } bounded;
+
+  // scratch space for encoding values, owned by the handle
+  char *buffer;
+  size_t buffer_size;
+};
+
+/* Returns NULL if nothing has been configured for the handle */
+memcached_extension_st *memcached_extension(const memcached_st *ptr);
+
+/* Returns the entry of the handle, creating it if needed */
+memcached_extension_st *memcached_extension_fetch(memcached_st *ptr);
+
+static inline memcached_bucket_route_t memcached_bucket_route(const memcached_st *ptr) {
+  const memcached_extension_st *extension = memcached_extension(ptr);
+  return extension ? extension->bucket.route : MEMCACHED_BUCKET_ROUTE_MASTER;
+}
+
+char *memcached_extension_buffer(memcached_st *ptr, memcached_extension_st *extension,
+                                 size_t length);
+
+memcached_return_t memcached_extension_clone(memcached_st *destination, const memcached_st *source);
+
+void memcached_extension_free(memcached_st *ptr);
@@ -23,27 +23,6 @@ char *memcached_fetch(memcached_st *shell, char *key, size_t *key_length, size_t
     error = &unused;
   }
 
-  if (memcached_is_udp(ptr)) {
-    if (value_length) {
-      *value_length = 0;
-    }
-
-    if (key_length) {
-      *key_length = 0;
-    }
-
-    if (flags) {
-      *flags = 0;
-    }
-
-    if (key) {
-      *key = 0;
-    }
-
-    *error = MEMCACHED_NOT_SUPPORTED;
-    return NULL;
-  }
-
   memcached_result_st *result_buffer = &ptr->result;
   result_buffer = memcached_fetch_result(ptr, result_buffer, error);
   if (result_buffer == NULL or memcached_failed(*error)) {
@@ -119,11 +98,6 @@ memcached_result_st *memcached_fetch_result(memcached_st *ptr, memcached_result_
     return NULL;
   }
 
-  if (memcached_is_udp(ptr)) {
-    *error = MEMCACHED_NOT_SUPPORTED;
-    return NULL;
-  }
-
   if (result == NULL) {
     // If we have already initialized (ie it is in use) our internal, we
     // create one.
@@ -14,13 +14,159 @@
 */
 
 #include "libmemcached/common.h"
+#include "libmemcached/virtual_bucket.h"
 #include "p9y/random.hpp"
 
+#include <algorithm>
+
+/* Entries of the per-key routing index a multi-get keeps on the stack */
+#define MGET_STACK_INDEX 256
+
 char *memcached_get(memcached_st *ptr, const char *key, size_t key_length, size_t *value_length,
                     uint32_t *flags, memcached_return_t *error) {
   return memcached_get_by_key(ptr, NULL, 0, key, key_length, value_length, flags, error);
 }
 
+/*
+  Let the get_key_failure callback produce a missing value and store it.
+*/
+static char *get_key_failure_fill(Memcached *ptr, const char *key, size_t key_length,
+                                  size_t *value_length, uint32_t *flags,
+                                  memcached_return_t *error) {
+  memcached_result_st key_failure_result;
+  memcached_result_st *result_ptr = memcached_result_create(ptr, &key_failure_result);
+  memcached_return_t rc = ptr->get_key_failure(ptr, key, key_length, result_ptr);
+
+  /* On all failure drop to returning NULL */
+  if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED) {
+    if (rc == MEMCACHED_BUFFERED) {
+      uint64_t latch; /* We use latch to track the state of the original socket */
+      latch = memcached_behavior_get(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS);
+      if (latch == 0) {
+        memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 1);
+      }
+
+      rc = memcached_set(ptr, key, key_length, (memcached_result_value(result_ptr)),
+                         (memcached_result_length(result_ptr)), result_ptr->item_expiration,
+                         (memcached_result_flags(result_ptr)));
+
+      if (rc == MEMCACHED_BUFFERED and latch == 0) {
+        memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 0);
+      }
+    } else {
+      rc = memcached_set(ptr, key, key_length, (memcached_result_value(result_ptr)),
+                         (memcached_result_length(result_ptr)), result_ptr->item_expiration,
+                         (memcached_result_flags(result_ptr)));
+    }
+
+    if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED) {
+      *error = rc;
+      if (value_length) {
+        *value_length = memcached_result_length(result_ptr);
+      }
+      if (flags) {
+        *flags = memcached_result_flags(result_ptr);
+      }
+      char *result_value = memcached_string_take_value(&result_ptr->value);
+      memcached_result_free(result_ptr);
+
+      return result_value;
+    }
+  }
+
+  memcached_result_free(result_ptr);
+  return NULL;
+}
+
+/*
+  MEMCACHED_DISTRIBUTION_BOUNDED_LOAD stores keys past their ring owner while
+  it is full, so a get walks the ring in the same order until the key is found.
+*/
+static char *bounded_load_get(Memcached *ptr, const char *key, size_t key_length,
+                              size_t *value_length, uint32_t *flags, memcached_return_t *error) {
+  memcached_extension_st *extension = memcached_extension(ptr);
+  memcached_trigger_key_fn key_failure = ptr->get_key_failure;
+  ptr->get_key_failure = NULL; // load once, after the last probe missed
+
+  uint32_t probes = memcached_bounded_load_probes(ptr);
+  char *value = NULL;
+  for (uint32_t x = 1; x <= probes; ++x) {
+    extension->bounded.probe = x;
+    value = memcached_get_by_key(ptr, NULL, 0, key, key_length, value_length, flags, error);
+    if (x > 1) {
+      extension->bounded.probes++;
+      if (value) {
+        extension->bounded.probe_hits++;
+      }
+    }
+    if (value or *error != MEMCACHED_NOTFOUND) {
+      break;
+    }
+  }
+  extension->bounded.probe = 0;
+  ptr->get_key_failure = key_failure;
+
+  if (value == NULL and *error == MEMCACHED_NOTFOUND and key_failure) {
+    return get_key_failure_fill(ptr, key, key_length, value_length, flags, error);
+  }
+
+  return value;
+}
+
+/*
+  While its virtual bucket is migrated a key may still only live on the
+  previous server, so a miss on the new one is retried there. With the meta
+  protocol a hit is added to the new server right away, with the time it
+  has left.
+*/
+static char *migrating_bucket_get(Memcached *ptr, const char *key, size_t key_length,
+                                  size_t *value_length, uint32_t *flags,
+                                  memcached_return_t *error) {
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    *error = memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    return NULL;
+  }
+
+  memcached_trigger_key_fn key_failure = ptr->get_key_failure;
+  ptr->get_key_failure = NULL; // load once, after the previous server missed as well
+
+  size_t length = 0;
+  uint32_t item_flags = 0;
+  extension->bucket.route = MEMCACHED_BUCKET_ROUTE_PINNED;
+  char *value = memcached_get_by_key(ptr, NULL, 0, key, key_length, &length, &item_flags, error);
+  if (value == NULL and *error == MEMCACHED_NOTFOUND
+      and memcached_generate_forward(ptr, key, key_length) != UINT32_MAX)
+  {
+    extension->bucket.forward_reads++;
+    extension->bucket.route = MEMCACHED_BUCKET_ROUTE_FORWARD;
+    value = memcached_get_by_key(ptr, NULL, 0, key, key_length, &length, &item_flags, error);
+    extension->bucket.route = MEMCACHED_BUCKET_ROUTE_PINNED;
+    if (value) {
+      extension->bucket.forward_hits++;
+      // only meta gets tell how long the item has left, others wait for the bucket copy
+      if (memcached_is_meta(ptr)) {
+        (void) memcached_add(ptr, key, key_length, value, length, ptr->result.item_expiration,
+                             item_flags);
+      }
+    }
+  }
+  extension->bucket.route = MEMCACHED_BUCKET_ROUTE_MASTER;
+  ptr->get_key_failure = key_failure;
+
+  if (value == NULL and *error == MEMCACHED_NOTFOUND and key_failure) {
+    return get_key_failure_fill(ptr, key, key_length, value_length, flags, error);
+  }
+
+  if (value_length) {
+    *value_length = length;
+  }
+  if (flags) {
+    *flags = item_flags;
+  }
+  return value;
+}
+
 static memcached_return_t mget_by_key_real(memcached_st *ptr, const char *group_key,
                                              size_t group_key_length, const char *const *keys,
                                              const size_t *key_length, size_t number_of_keys,
@@ -37,6 +183,22 @@ char *memcached_get_by_key(memcached_st *shell, const char *group_key, size_t gr
   uint64_t query_id = 0;
   if (ptr) {
     query_id = ptr->query_id;
+
+    if (group_key_length == 0 and ptr->get_key_failure == NULL and memcached_is_hedging(ptr)) {
+      return memcached_hedged_get(ptr, key, key_length, value_length, flags, error);
+    }
+
+    if (group_key_length == 0 and memcached_is_bounded_load(ptr)
+        and memcached_extension(ptr)->bounded.probe == 0)
+    {
+      return bounded_load_get(ptr, key, key_length, value_length, flags, error);
+    }
+
+    if (group_key_length == 0 and memcached_virtual_bucket_migrating(ptr)
+        and memcached_bucket_route(ptr) == MEMCACHED_BUCKET_ROUTE_MASTER)
+    {
+      return migrating_bucket_get(ptr, key, key_length, value_length, flags, error);
+    }
   }
 
   /* Request the key */
@@ -49,6 +211,7 @@ char *memcached_get_by_key(memcached_st *shell, const char *group_key, size_t gr
 
   if (memcached_failed(*error)) {
     if (ptr) {
+      memcached_replica_read_done(ptr);
       if (memcached_has_current_error(*ptr)) // Find the most accurate error
       {
         *error = memcached_last_error(ptr);
@@ -64,6 +227,7 @@ char *memcached_get_by_key(memcached_st *shell, const char *group_key, size_t gr
 
   char *value = memcached_fetch(ptr, NULL, NULL, value_length, flags, error);
   assert_msg(ptr->query_id == query_id + 1, "Programmer error, the query_id was not incremented.");
+  memcached_replica_read_done(ptr);
 
   /* This is for historical reasons */
   if (*error == MEMCACHED_END) {
@@ -71,48 +235,7 @@ char *memcached_get_by_key(memcached_st *shell, const char *group_key, size_t gr
   }
   if (value == NULL) {
     if (ptr->get_key_failure and *error == MEMCACHED_NOTFOUND) {
-      memcached_result_st key_failure_result;
-      memcached_result_st *result_ptr = memcached_result_create(ptr, &key_failure_result);
-      memcached_return_t rc = ptr->get_key_failure(ptr, key, key_length, result_ptr);
-
-      /* On all failure drop to returning NULL */
-      if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED) {
-        if (rc == MEMCACHED_BUFFERED) {
-          uint64_t latch; /* We use latch to track the state of the original socket */
-          latch = memcached_behavior_get(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS);
-          if (latch == 0) {
-            memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 1);
-          }
-
-          rc = memcached_set(ptr, key, key_length, (memcached_result_value(result_ptr)),
-                             (memcached_result_length(result_ptr)), 0,
-                             (memcached_result_flags(result_ptr)));
-
-          if (rc == MEMCACHED_BUFFERED and latch == 0) {
-            memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 0);
-          }
-        } else {
-          rc = memcached_set(ptr, key, key_length, (memcached_result_value(result_ptr)),
-                             (memcached_result_length(result_ptr)), 0,
-                             (memcached_result_flags(result_ptr)));
-        }
-
-        if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED) {
-          *error = rc;
-          if (value_length) {
-            *value_length = memcached_result_length(result_ptr);
-          }
-          if (flags) {
-            *flags = memcached_result_flags(result_ptr);
-          }
-          char *result_value = memcached_string_take_value(&result_ptr->value);
-          memcached_result_free(result_ptr);
-
-          return result_value;
-        }
-      }
-
-      memcached_result_free(result_ptr);
+      return get_key_failure_fill(ptr, key, key_length, value_length, flags, error);
     }
     assert_msg(ptr->query_id == query_id + 1,
                "Programmer error, the query_id was not incremented.");
@@ -123,6 +246,146 @@ char *memcached_get_by_key(memcached_st *shell, const char *group_key, size_t gr
   return value;
 }
 
+/* Gets which memcached_get_by_key() sends down paths of their own */
+static bool get_sink_bypassed(Memcached *ptr) {
+  return ptr->get_key_failure or memcached_is_hedging(ptr) or memcached_is_bounded_load(ptr)
+      or memcached_virtual_bucket_migrating(ptr);
+}
+
+/*
+  The single get of memcached_get_by_key(), with the value going to the sink
+  of the handle. Returns the result, NULL on a miss or an error.
+*/
+static memcached_result_st *get_sink(Memcached *ptr, memcached_extension_st *extension,
+                                     const char *key, size_t key_length,
+                                     memcached_return_t &rc) {
+  rc = mget_by_key_real(ptr, NULL, 0, &key, &key_length, 1, false);
+  if (memcached_failed(rc)) {
+    memcached_replica_read_done(ptr);
+    if (memcached_has_current_error(*ptr)) {
+      rc = memcached_last_error(ptr);
+    }
+    return NULL;
+  }
+
+  extension->sink.active = true;
+  extension->sink.delivered = false;
+  memcached_result_st *result = memcached_fetch_result(ptr, &ptr->result, &rc);
+  extension->sink.active = false;
+  memcached_replica_read_done(ptr);
+
+  /* This is for historical reasons */
+  if (rc == MEMCACHED_END) {
+    rc = MEMCACHED_NOTFOUND;
+  }
+
+  return result;
+}
+
+memcached_return_t memcached_get_into(memcached_st *shell, const char *key, size_t key_length,
+                                      char *buffer, size_t buffer_size, size_t *value_length,
+                                      uint32_t *flags) {
+  Memcached *ptr = memcached2Memcached(shell);
+  size_t unused_length;
+  uint32_t unused_flags;
+  if (value_length == NULL) {
+    value_length = &unused_length;
+  }
+  if (flags == NULL) {
+    flags = &unused_flags;
+  }
+  *value_length = 0;
+  *flags = 0;
+
+  if (ptr == NULL or (buffer == NULL and buffer_size)) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_return_t rc;
+  if (get_sink_bypassed(ptr)) {
+    char *value = memcached_get_by_key(ptr, NULL, 0, key, key_length, value_length, flags, &rc);
+    if (value) {
+      if (*value_length <= buffer_size) {
+        memcpy(buffer, value, *value_length);
+      } else {
+        rc = memcached_set_error(*ptr, MEMCACHED_E2BIG, MEMCACHED_AT);
+      }
+      libmemcached_free(ptr, value);
+    }
+    return rc;
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  extension->sink.buffer = buffer;
+  extension->sink.size = buffer_size;
+  extension->sink.callback = NULL;
+  memcached_result_st *result = get_sink(ptr, extension, key, key_length, rc);
+  if (result == NULL) {
+    return rc;
+  }
+
+  *flags = memcached_result_flags(result);
+  if (extension->sink.delivered) {
+    *value_length = extension->sink.length;
+    return MEMCACHED_SUCCESS;
+  }
+
+  *value_length = memcached_result_length(result);
+  if (*value_length > buffer_size) {
+    return memcached_set_error(*ptr, MEMCACHED_E2BIG, MEMCACHED_AT);
+  }
+  memcpy(buffer, memcached_result_value(result), *value_length);
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_get_view(memcached_st *shell, const char *key, size_t key_length,
+                                      memcached_value_fn callback, void *context) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL or callback == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_return_t rc;
+  if (get_sink_bypassed(ptr)) {
+    memcached_value_view_st view = {key, key_length, NULL, 0, 0};
+    char *value =
+        memcached_get_by_key(ptr, NULL, 0, key, key_length, &view.value_length, &view.flags, &rc);
+    if (value) {
+      view.value = value;
+      rc = callback(ptr, &view, context);
+      libmemcached_free(ptr, value);
+    }
+    return rc;
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  extension->sink.callback = callback;
+  extension->sink.context = context;
+  memcached_result_st *result = get_sink(ptr, extension, key, key_length, rc);
+  extension->sink.callback = NULL;
+  if (result == NULL) {
+    return rc;
+  }
+
+  if (extension->sink.delivered) {
+    return extension->sink.rc;
+  }
+
+  memcached_value_view_st view = {result->item_key, result->key_length,
+                                  memcached_result_value(result), memcached_result_length(result),
+                                  memcached_result_flags(result)};
+  return callback(ptr, &view, context);
+}
+
 memcached_return_t memcached_mget(memcached_st *ptr, const char *const *keys,
                                   const size_t *key_length, size_t number_of_keys) {
   return memcached_mget_by_key(ptr, NULL, 0, keys, key_length, number_of_keys);
@@ -147,8 +410,10 @@ static memcached_return_t mget_by_key_real(memcached_st *ptr, const char *group_
     return rc;
   }
 
-  if (memcached_is_udp(ptr)) {
-    return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT);
+  if (memcached_is_udp(ptr) and (memcached_is_binary(ptr) or memcached_is_meta(ptr))) {
+    return memcached_set_error(
+        *ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+        memcached_literal_param("Gets over UDP only support the text protocol"));
   }
 
   LIBMEMCACHED_MEMCACHED_MGET_START();
@@ -193,6 +458,11 @@ static memcached_return_t mget_by_key_real(memcached_st *ptr, const char *group_
     }
   }
 
+  if (memcached_is_udp(ptr)) {
+    return memcached_udp_mget(ptr, is_group_key_set ? group_key : NULL, group_key_length, keys,
+                              key_length, number_of_keys);
+  }
+
   if (memcached_is_binary(ptr)) {
     return binary_mget_by_key(ptr, master_server_key, is_group_key_set, keys, key_length,
                               number_of_keys, mget_mode);
@@ -203,55 +473,122 @@ static memcached_return_t mget_by_key_real(memcached_st *ptr, const char *group_
     get_command_length = 4;
   }
 
+  /*
+    Meta gets take a line per key and the "mn" that ends them: misses leave no
+    response, and each hit names its key. Reads forwarded to the previous
+    server of a migrating bucket also ask for the time to live, so the hit can
+    be copied with it.
+  */
+  static const char *const meta_get_flags[2][2] = {{" v f k q\r\n", " v f k t q\r\n"},
+                                                   {" v f k c q\r\n", " v f k c t q\r\n"}};
+  bool meta = memcached_is_meta(ptr);
+  const char *get_flags =
+      meta_get_flags[ptr->flags.support_cas]
+                    [memcached_bucket_route(ptr) == MEMCACHED_BUCKET_ROUTE_FORWARD];
+  size_t get_flags_length = 0;
+  if (meta) {
+    get_command = "mg";
+    get_command_length = 2;
+    get_flags_length = strlen(get_flags);
+  }
+
   /*
     If a server fails we warn about errors and start all over with sending keys
     to the server.
   */
   WATCHPOINT_ASSERT(rc == MEMCACHED_SUCCESS);
-  size_t hosts_connected = 0;
-  for (uint32_t x = 0; x < number_of_keys; x++) {
-    uint32_t server_key;
 
-    if (is_group_key_set) {
-      server_key = master_server_key;
-    } else {
-      server_key = memcached_generate_hash_with_redistribution(ptr, keys[x], key_length[x]);
+  /*
+    All keys are routed in one batch and grouped by server, so that the keys
+    of a server are written one after the other.
+  */
+  uint32_t server_count = memcached_server_count(ptr);
+  uint32_t stack_index[MGET_STACK_INDEX];
+  uint32_t *server_key = stack_index;
+  // a single key needs no grouping, so only its server and order
+  size_t index_size = number_of_keys == 1 ? 2 : 2 * number_of_keys + server_count + 1;
+  if (index_size > MGET_STACK_INDEX
+      and (server_key = libmemcached_xvalloc(ptr, index_size, uint32_t)) == NULL)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  uint32_t *order = server_key + number_of_keys;
+  uint32_t *first = order + number_of_keys;
+
+  if (is_group_key_set) {
+    for (size_t x = 0; x < number_of_keys; x++) {
+      server_key[x] = master_server_key;
     }
+  } else if (number_of_keys == 1) {
+    server_key[0] = memcached_generate_hash_with_redistribution(ptr, keys[0], key_length[0]);
+  } else {
+    memcached_generate_hash_batch_with_redistribution(ptr, keys, key_length, number_of_keys,
+                                                      server_key);
+  }
 
-    memcached_instance_st *instance = memcached_instance_fetch(ptr, server_key);
+  // only the server of a single key is visited
+  uint32_t lowest = 0, highest = server_count;
+  if (number_of_keys == 1) {
+    lowest = server_key[0];
+    highest = lowest + 1;
+    order[0] = 0;
+  } else {
+    memcached_group_by_server(server_key, number_of_keys, server_count, first, order);
+  }
 
-    libmemcached_io_vector_st vector[] = {
-        {get_command, get_command_length},
-        {memcached_literal_param(" ")},
-        {memcached_array_string(ptr->_namespace), memcached_array_size(ptr->_namespace)},
-        {keys[x], key_length[x]}};
+  size_t hosts_connected = 0;
+  for (uint32_t s = lowest; s < highest; s++) {
+    uint32_t begin = number_of_keys == 1 ? 0 : first[s];
+    uint32_t end = number_of_keys == 1 ? 1 : first[s + 1];
+    if (begin == end) {
+      continue;
+    }
 
-    if (instance->response_count() == 0) {
-      rc = memcached_connect(instance);
+    memcached_instance_st *instance = memcached_instance_fetch(ptr, s);
 
-      if (memcached_failed(rc)) {
-        memcached_set_error(*instance, rc, MEMCACHED_AT);
-        continue;
-      }
-      hosts_connected++;
+    for (uint32_t y = begin; y < end; y++) {
+      uint32_t x = order[y];
 
-      if ((memcached_io_writev(instance, vector, 1, false)) == false) {
-        failures_occured_in_sending = true;
-        continue;
+      libmemcached_io_vector_st vector[] = {
+          {get_command, get_command_length},
+          {memcached_literal_param(" ")},
+          {memcached_array_string(ptr->_namespace), memcached_array_size(ptr->_namespace)},
+          {keys[x], key_length[x]},
+          {get_flags, get_flags_length}};
+
+      if (instance->response_count() == 0) {
+        rc = memcached_connect(instance);
+
+        if (memcached_failed(rc)) {
+          memcached_set_error(*instance, rc, MEMCACHED_AT);
+          break;
+        }
+        hosts_connected++;
+
+        if (meta == false and (memcached_io_writev(instance, vector, 1, false)) == false) {
+          failures_occured_in_sending = true;
+          continue;
+        }
+        WATCHPOINT_ASSERT(instance->cursor_active_ == 0);
+        memcached_instance_response_increment(instance);
+        WATCHPOINT_ASSERT(instance->cursor_active_ == 1);
       }
-      WATCHPOINT_ASSERT(instance->cursor_active_ == 0);
-      memcached_instance_response_increment(instance);
-      WATCHPOINT_ASSERT(instance->cursor_active_ == 1);
-    }
 
-    {
-      if ((memcached_io_writev(instance, (vector + 1), 3, false)) == false) {
-        memcached_instance_response_reset(instance);
-        failures_occured_in_sending = true;
-        continue;
+      {
+        if ((meta ? memcached_io_writev(instance, vector, 5, false)
+                  : memcached_io_writev(instance, (vector + 1), 3, false))
+            == false)
+        {
+          memcached_instance_response_reset(instance);
+          failures_occured_in_sending = true;
+          continue;
+        }
       }
     }
   }
+  if (server_key != stack_index) {
+    libmemcached_free(ptr, server_key);
+  }
 
   if (hosts_connected == 0) {
     LIBMEMCACHED_MEMCACHED_MGET_END();
@@ -267,12 +604,15 @@ static memcached_return_t mget_by_key_real(memcached_st *ptr, const char *group_
     Should we muddle on if some servers are dead?
   */
   bool success_happened = false;
-  for (uint32_t x = 0; x < memcached_server_count(ptr); x++) {
+  for (uint32_t x = lowest; x < highest; x++) {
     memcached_instance_st *instance = memcached_instance_fetch(ptr, x);
 
     if (instance->response_count()) {
       /* We need to do something about non-connnected hosts in the future */
-      if ((memcached_io_write(instance, "\r\n", 2, true)) == -1) {
+      if ((meta ? memcached_io_write(instance, memcached_literal_param("mn\r\n"), true)
+                : memcached_io_write(instance, "\r\n", 2, true))
+          == -1)
+      {
         failures_occured_in_sending = true;
       } else {
         success_happened = true;
@@ -352,18 +692,28 @@ static memcached_return_t simple_binary_mget(memcached_st *ptr, const uint32_t m
     return rc;
   }
 
+  uint32_t stack_route[MGET_STACK_INDEX];
+  uint32_t *route = NULL;
+  if (is_group_key_set == false) {
+    route = number_of_keys <= MGET_STACK_INDEX ? stack_route
+                                               : libmemcached_xvalloc(ptr, number_of_keys, uint32_t);
+    if (route == NULL) {
+      return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+    }
+    if (number_of_keys == 1) {
+      route[0] = memcached_generate_hash_with_redistribution(ptr, keys[0], key_length[0]);
+    } else {
+      memcached_generate_hash_batch_with_redistribution(ptr, keys, key_length, number_of_keys,
+                                                        route);
+    }
+  }
+
   /*
     If a server fails we warn about errors and start all over with sending keys
     to the server.
   */
   for (uint32_t x = 0; x < number_of_keys; ++x) {
-    uint32_t server_key;
-
-    if (is_group_key_set) {
-      server_key = master_server_key;
-    } else {
-      server_key = memcached_generate_hash_with_redistribution(ptr, keys[x], key_length[x]);
-    }
+    uint32_t server_key = route ? route[x] : master_server_key;
 
     memcached_instance_st *instance = memcached_instance_fetch(ptr, server_key);
 
@@ -424,6 +774,9 @@ static memcached_return_t simple_binary_mget(memcached_st *ptr, const uint32_t m
       rc = MEMCACHED_SOME_ERRORS;
     }
   }
+  if (route != stack_route) {
+    libmemcached_free(ptr, route);
+  }
 
   if (mget_mode) {
     /*
@@ -453,7 +806,8 @@ static memcached_return_t simple_binary_mget(memcached_st *ptr, const uint32_t m
 }
 
 static memcached_return_t replication_binary_mget(memcached_st *ptr, uint32_t *hash,
-                                                  bool *dead_servers, const char *const *keys,
+                                                  const uint32_t *pick, bool *dead_servers,
+                                                  const char *const *keys,
                                                   const size_t *key_length,
                                                   const size_t number_of_keys) {
   memcached_return_t rc = MEMCACHED_NOTFOUND;
@@ -475,8 +829,11 @@ static memcached_return_t replication_binary_mget(memcached_st *ptr, uint32_t *h
 
       uint32_t server = hash[x] + replica;
 
-      /* In case of randomized reads */
-      if (randomize_read and ((server + start) <= (hash[x] + ptr->number_of_replicas))) {
+      if (pick) {
+        /* Least-loaded copy first, then the ones after it */
+        server = hash[x] + (pick[x] + replica) % (ptr->number_of_replicas + 1);
+      } else if (randomize_read and ((server + start) <= (hash[x] + ptr->number_of_replicas))) {
+        /* In case of randomized reads */
         server += start;
       }
 
@@ -534,6 +891,9 @@ static memcached_return_t replication_binary_mget(memcached_st *ptr, uint32_t *h
 
       memcached_server_response_increment(instance);
       hash[x] = memcached_server_count(ptr);
+      if (pick and number_of_keys == 1) {
+        memcached_replica_read_start(ptr, server);
+      }
     }
 
     if (success) {
@@ -553,12 +913,27 @@ static memcached_return_t binary_mget_by_key(memcached_st *ptr, const uint32_t m
                               number_of_keys, mget_mode);
   }
 
-  uint32_t *hash = libmemcached_xvalloc(ptr, number_of_keys, uint32_t);
-  bool *dead_servers = libmemcached_xcalloc(ptr, memcached_server_count(ptr), bool);
+  // hash and pick, and the dead servers, go on the stack when they fit
+  uint32_t stack_index[MGET_STACK_INDEX];
+  bool stack_dead[MGET_STACK_INDEX];
+  bool small = 2 * number_of_keys <= MGET_STACK_INDEX;
+  uint32_t server_count = memcached_server_count(ptr);
+  uint32_t *hash = small ? stack_index : libmemcached_xvalloc(ptr, 2 * number_of_keys, uint32_t);
+  uint32_t *pick = memcached_is_replica_reading(ptr) and hash ? hash + number_of_keys : NULL;
+  bool *dead_servers = stack_dead;
+  if (server_count > MGET_STACK_INDEX) {
+    dead_servers = libmemcached_xcalloc(ptr, server_count, bool);
+  } else {
+    std::fill(stack_dead, stack_dead + server_count, false);
+  }
 
   if (hash == NULL or dead_servers == NULL) {
-    libmemcached_free(ptr, hash);
-    libmemcached_free(ptr, dead_servers);
+    if (hash != stack_index) {
+      libmemcached_free(ptr, hash);
+    }
+    if (dead_servers != stack_dead) {
+      libmemcached_free(ptr, dead_servers);
+    }
     return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
   }
 
@@ -567,17 +942,25 @@ static memcached_return_t binary_mget_by_key(memcached_st *ptr, const uint32_t m
       hash[x] = master_server_key;
     }
   } else {
+    memcached_generate_hash_batch_with_redistribution(ptr, keys, key_length, number_of_keys, hash);
+  }
+
+  if (pick) {
     for (size_t x = 0; x < number_of_keys; x++) {
-      hash[x] = memcached_generate_hash_with_redistribution(ptr, keys[x], key_length[x]);
+      pick[x] = memcached_replica_read_pick(ptr, hash[x]);
     }
   }
 
   memcached_return_t rc =
-      replication_binary_mget(ptr, hash, dead_servers, keys, key_length, number_of_keys);
+      replication_binary_mget(ptr, hash, pick, dead_servers, keys, key_length, number_of_keys);
 
   WATCHPOINT_IFERROR(rc);
-  libmemcached_free(ptr, hash);
-  libmemcached_free(ptr, dead_servers);
+  if (hash != stack_index) {
+    libmemcached_free(ptr, hash);
+  }
+  if (dead_servers != stack_dead) {
+    libmemcached_free(ptr, dead_servers);
+  }
 
   return MEMCACHED_SUCCESS;
 }
@@ -0,0 +1,67 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Gets without a copy of the value for the caller.
+ *
+ * memcached_get() returns each value in fresh memory, which the caller then
+ * frees. memcached_get_into() reads the value from the socket buffer straight
+ * into memory of the caller. memcached_get_view() passes a callback a view of
+ * the value where it lies in the read buffer of the server. Values that do
+ * not arrive in one read, or are compressed or encrypted, are put together
+ * in the result of the handle first, which is reused between gets. With
+ * hedging, bounded-load distribution, bucket migration or a get_key_failure
+ * callback, the value comes from memcached_get() and is copied.
+ */
+
+struct memcached_value_view_st {
+  const char *key;
+  size_t key_length;
+  const char *value; /* not NUL terminated */
+  size_t value_length;
+  uint32_t flags;
+};
+
+/* Runs during the get: it must not use the handle, the view is gone afterwards */
+typedef memcached_return_t (*memcached_value_fn)(const memcached_st *ptr,
+                                                 const struct memcached_value_view_st *view,
+                                                 void *context);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * memcached_get() into buffer. Values longer than buffer_size are dropped
+ * with MEMCACHED_E2BIG, *value_length is then the size they need.
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_get_into(memcached_st *ptr, const char *key, size_t key_length,
+                                      char *buffer, size_t buffer_size, size_t *value_length,
+                                      uint32_t *flags);
+
+/**
+ * memcached_get() passing the value to callback. Returns what the callback
+ * returned, or the error of the get, such as MEMCACHED_NOTFOUND.
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_get_view(memcached_st *ptr, const char *key, size_t key_length,
+                                      memcached_value_fn callback, void *context);
+
+#ifdef __cplusplus
+}
+#endif
@@ -18,6 +18,8 @@
 #include "p9y/gettimeofday.hpp"
 #include "p9y/random.hpp"
 
+#include <algorithm>
+
 uint32_t memcached_generate_hash_value(const char *key, size_t key_length,
                                        memcached_hash_t hash_algorithm) {
   return libhashkit_digest(key, key_length, (hashkit_hash_algorithm_t) hash_algorithm);
@@ -28,34 +30,31 @@ static inline uint32_t generate_hash(const Memcached *ptr, const char *key, size
 }
 
 static uint32_t dispatch_host(const Memcached *ptr, uint32_t hash) {
+  if (uint32_t distribution = memcached_extended_distribution(ptr)) {
+    return memcached_dispatch_extended(ptr, distribution, hash);
+  }
+
   switch (ptr->distribution) {
   case MEMCACHED_DISTRIBUTION_CONSISTENT:
   case MEMCACHED_DISTRIBUTION_CONSISTENT_WEIGHTED:
   case MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA:
   case MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA_SPY: {
-    uint32_t num = ptr->ketama.continuum_points_counter;
     WATCHPOINT_ASSERT(ptr->ketama.continuum);
-
-    memcached_continuum_item_st *begin, *end, *left, *right, *middle;
-    begin = left = ptr->ketama.continuum;
-    end = right = ptr->ketama.continuum + num;
-
-    while (left < right) {
-      middle = left + (right - left) / 2;
-      if (middle->value < hash)
-        left = middle + 1;
-      else
-        right = middle;
-    }
-    if (right == end)
-      right = begin;
-    return right->index;
+    return ptr->ketama.continuum[memcached_continuum_position(ptr, hash)].index;
   }
   case MEMCACHED_DISTRIBUTION_MODULA:
     return hash % memcached_server_count(ptr);
   case MEMCACHED_DISTRIBUTION_RANDOM:
     return (uint32_t) random() % memcached_server_count(ptr);
   case MEMCACHED_DISTRIBUTION_VIRTUAL_BUCKET: {
+    if (memcached_virtual_bucket_migrating(ptr)
+        and memcached_bucket_route(ptr) == MEMCACHED_BUCKET_ROUTE_FORWARD)
+    {
+      uint32_t forward = memcached_virtual_bucket_forward(ptr, hash);
+      if (forward != UINT32_MAX) {
+        return forward;
+      }
+    }
     return memcached_virtual_bucket_get(ptr, hash);
   }
   default:
@@ -92,6 +91,197 @@ static inline uint32_t _generate_hash_wrapper(const Memcached *ptr, const char *
   }
 }
 
+/*
+  Batched hashing: the namespace is hashed once and continued from by every
+  key, the arithmetic is that of libhashkit, including the sign extension of
+  the key bytes.
+
+  one-at-a-time, the default hash, is a long dependency chain per byte, so
+  HASH_LANES keys are hashed side by side in a 128 bit vector: four bytes
+  of every key are loaded at once and fed to the hash one after the other, as
+  long as all keys of the batch have bytes left; the rest of each key is hashed
+  on its own. FNV is bound by the 32 bit multiplication, which vectors don't
+  do faster, and is hashed one key at a time.
+*/
+#define HASH_LANES 4
+
+typedef uint32_t hash_lanes_t __attribute__((vector_size(HASH_LANES * sizeof(uint32_t))));
+
+/* Bits 24 - shift to 31 - shift of every word, widened like the scalar (uint32_t) of a char */
+static inline hash_lanes_t hash_byte(hash_lanes_t word, int shift) {
+  hash_lanes_t byte = (word << shift) >> 24;
+  if (CHAR_MIN < 0) {
+    // sign extension in unsigned arithmetic, which wraps
+    byte = (byte ^ 0x80) - 0x80;
+  }
+  return byte;
+}
+
+struct one_at_a_time_hash {
+  static const uint32_t init = 0;
+
+  template<class T>
+  static inline T step(T hash, T byte) {
+    hash += byte;
+    hash += (hash << 10);
+    hash ^= (hash >> 6);
+    return hash;
+  }
+
+  template<class T>
+  static inline T finish(T hash) {
+    hash += (hash << 3);
+    hash ^= (hash >> 11);
+    hash += (hash << 15);
+    return hash;
+  }
+};
+
+struct fnv1_32_hash {
+  static const uint32_t init = 2166136261UL;
+
+  template<class T>
+  static inline T step(T hash, T byte) {
+    return (hash * 16777619) ^ byte;
+  }
+
+  template<class T>
+  static inline T finish(T hash) {
+    return hash;
+  }
+};
+
+struct fnv1a_32_hash {
+  static const uint32_t init = 2166136261UL;
+
+  template<class T>
+  static inline T step(T hash, T byte) {
+    return (hash ^ byte) * 16777619;
+  }
+
+  template<class T>
+  static inline T finish(T hash) {
+    return hash;
+  }
+};
+
+template<class Hash>
+static uint32_t hash_seed(const char *prefix, size_t prefix_length) {
+  uint32_t seed = Hash::init;
+  for (size_t x = 0; x < prefix_length; x++) {
+    seed = Hash::step(seed, (uint32_t) prefix[x]);
+  }
+  return seed;
+}
+
+template<class Hash>
+static void hash_keys(uint32_t seed, const char *const *keys, const size_t *key_length,
+                      size_t number_of_keys, uint32_t *hash) {
+  for (size_t x = 0; x < number_of_keys; x++) {
+    uint32_t value = seed;
+    for (size_t j = 0; j < key_length[x]; j++) {
+      value = Hash::step(value, (uint32_t) keys[x][j]);
+    }
+    hash[x] = Hash::finish(value);
+  }
+}
+
+template<class Hash>
+static void hash_lanes(uint32_t seed, const char *const *keys, const size_t *key_length,
+                       size_t number_of_keys, uint32_t *hash) {
+  size_t base = 0;
+  for (; base + HASH_LANES <= number_of_keys; base += HASH_LANES) {
+    const char *const *key = keys + base;
+    const size_t *length = key_length + base;
+    hash_lanes_t state;
+    size_t shortest = length[0];
+
+    for (size_t l = 0; l < HASH_LANES; l++) {
+      state[l] = seed;
+      shortest = std::min(shortest, length[l]);
+    }
+
+    size_t i = 0;
+    for (; i + 4 <= shortest; i += 4) {
+      hash_lanes_t word;
+
+      for (size_t l = 0; l < HASH_LANES; l++) {
+        uint32_t bytes;
+        memcpy(&bytes, key[l] + i, sizeof(bytes));
+        word[l] = bytes;
+      }
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      state = Hash::step(state, hash_byte(word, 0));
+      state = Hash::step(state, hash_byte(word, 8));
+      state = Hash::step(state, hash_byte(word, 16));
+      state = Hash::step(state, hash_byte(word, 24));
+#else
+      state = Hash::step(state, hash_byte(word, 24));
+      state = Hash::step(state, hash_byte(word, 16));
+      state = Hash::step(state, hash_byte(word, 8));
+      state = Hash::step(state, hash_byte(word, 0));
+#endif
+    }
+
+    for (size_t l = 0; l < HASH_LANES; l++) {
+      uint32_t value = state[l];
+      for (size_t j = i; j < length[l]; j++) {
+        value = Hash::step(value, (uint32_t) key[l][j]);
+      }
+      hash[base + l] = Hash::finish(value);
+    }
+  }
+
+  hash_keys<Hash>(seed, keys + base, key_length + base, number_of_keys - base, hash + base);
+}
+
+/* _generate_hash_wrapper() of every key */
+static void _generate_hash_batch(const Memcached *ptr, const char *const *keys,
+                                 const size_t *key_length, size_t number_of_keys,
+                                 uint32_t *hash) {
+  WATCHPOINT_ASSERT(memcached_server_count(ptr));
+
+  if (memcached_server_count(ptr) == 1) {
+    std::fill(hash, hash + number_of_keys, 0);
+    return;
+  }
+
+  const char *prefix = NULL;
+  size_t prefix_length = 0;
+  if (ptr->flags.hash_with_namespace) {
+    prefix = memcached_array_string(ptr->_namespace);
+    prefix_length = memcached_array_size(ptr->_namespace);
+  }
+
+  switch (hashkit_get_function(&ptr->hashkit)) {
+  case HASHKIT_HASH_DEFAULT:
+    hash_lanes<one_at_a_time_hash>(hash_seed<one_at_a_time_hash>(prefix, prefix_length), keys,
+                                   key_length, number_of_keys, hash);
+    break;
+  case HASHKIT_HASH_FNV1_32:
+    hash_keys<fnv1_32_hash>(hash_seed<fnv1_32_hash>(prefix, prefix_length), keys, key_length,
+                            number_of_keys, hash);
+    break;
+  case HASHKIT_HASH_FNV1A_32:
+    hash_keys<fnv1a_32_hash>(hash_seed<fnv1a_32_hash>(prefix, prefix_length), keys, key_length,
+                             number_of_keys, hash);
+    break;
+  default:
+    for (size_t x = 0; x < number_of_keys; x++) {
+      hash[x] = _generate_hash_wrapper(ptr, keys[x], key_length[x]);
+    }
+    return;
+  }
+
+  if (prefix_length) {
+    for (size_t x = 0; x < number_of_keys; x++) {
+      if (prefix_length + key_length[x] > MEMCACHED_MAX_KEY - 1) {
+        hash[x] = 0;
+      }
+    }
+  }
+}
+
 static inline void _regen_for_auto_eject(Memcached *ptr) {
   if (_is_auto_eject_host(ptr) && ptr->ketama.next_distribution_rebuild) {
     struct timeval now;
@@ -112,7 +302,59 @@ uint32_t memcached_generate_hash_with_redistribution(memcached_st *ptr, const ch
 
   _regen_for_auto_eject(ptr);
 
-  return dispatch_host(ptr, hash);
+  uint32_t server_key = dispatch_host(ptr, hash);
+  if (memcached_is_bounded_load(ptr)) {
+    memcached_bounded_load_account(ptr, hash, server_key);
+  }
+
+  return server_key;
+}
+
+void memcached_generate_hash_batch_with_redistribution(Memcached *ptr, const char *const *keys,
+                                                       const size_t *key_length,
+                                                       size_t number_of_keys,
+                                                       uint32_t *server_key) {
+  _generate_hash_batch(ptr, keys, key_length, number_of_keys, server_key);
+
+  _regen_for_auto_eject(ptr);
+
+  bool is_bounded_load = memcached_is_bounded_load(ptr);
+  for (size_t x = 0; x < number_of_keys; x++) {
+    uint32_t hash = server_key[x];
+
+    server_key[x] = dispatch_host(ptr, hash);
+    if (is_bounded_load) {
+      memcached_bounded_load_account(ptr, hash, server_key[x]);
+    }
+  }
+}
+
+void memcached_group_by_server(const uint32_t *server_key, size_t number_of_keys,
+                               uint32_t server_count, uint32_t *first, uint32_t *order) {
+  std::fill(first, first + server_count + 1, 0);
+  for (size_t x = 0; x < number_of_keys; x++) {
+    first[server_key[x] + 1]++;
+  }
+  for (uint32_t s = 0; s < server_count; s++) {
+    first[s + 1] += first[s];
+  }
+
+  /* first[s] is the next free slot of s, and ends up at the start of s + 1 */
+  for (size_t x = 0; x < number_of_keys; x++) {
+    order[first[server_key[x]]++] = (uint32_t) x;
+  }
+  for (uint32_t s = server_count; s > 0; s--) {
+    first[s] = first[s - 1];
+  }
+  first[0] = 0;
+}
+
+uint32_t memcached_generate_forward(const memcached_st *ptr, const char *key, size_t key_length) {
+  if (memcached_virtual_bucket_migrating(ptr) == false) {
+    return UINT32_MAX;
+  }
+
+  return memcached_virtual_bucket_forward(ptr, _generate_hash_wrapper(ptr, key, key_length));
 }
 
 uint32_t memcached_generate_hash(const memcached_st *shell, const char *key, size_t key_length) {
@@ -124,6 +366,21 @@ uint32_t memcached_generate_hash(const memcached_st *shell, const char *key, siz
   return UINT32_MAX;
 }
 
+void memcached_generate_hash_batch(const memcached_st *shell, const char *const *keys,
+                                   const size_t *key_length, size_t number_of_keys,
+                                   uint32_t *server_key) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    std::fill(server_key, server_key + number_of_keys, UINT32_MAX);
+    return;
+  }
+
+  _generate_hash_batch(ptr, keys, key_length, number_of_keys, server_key);
+  for (size_t x = 0; x < number_of_keys; x++) {
+    server_key[x] = dispatch_host(ptr, server_key[x]);
+  }
+}
+
 const hashkit_st *memcached_get_hashkit(const memcached_st *shell) {
   const Memcached *ptr = memcached2Memcached(shell);
   if (ptr) {
@@ -17,3 +17,20 @@
 
 uint32_t memcached_generate_hash_with_redistribution(memcached_st *ptr, const char *key,
                                                      size_t key_length);
+
+/* memcached_generate_hash_with_redistribution() of every key, hashed in a batch */
+void memcached_generate_hash_batch_with_redistribution(memcached_st *ptr, const char *const *keys,
+                                                       const size_t *key_length,
+                                                       size_t number_of_keys,
+                                                       uint32_t *server_key);
+
+/*
+  Groups the key indices by server in one pass: the keys of server s are
+  order[first[s]] .. order[first[s + 1] - 1], in their original order.
+  first has server_count + 1 entries.
+*/
+void memcached_group_by_server(const uint32_t *server_key, size_t number_of_keys,
+                               uint32_t server_count, uint32_t *first, uint32_t *order);
+
+/* Previous server of the key while its virtual bucket is migrated, else UINT32_MAX */
+uint32_t memcached_generate_forward(const memcached_st *ptr, const char *key, size_t key_length);
@@ -0,0 +1,309 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/common.h"
+
+#include <algorithm>
+
+memcached_return_t memcached_set_hedging(memcached_st *shell, uint32_t percentile) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (percentile > 99) {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("Invalid hedging percentile"));
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  extension->hedge.percentile = percentile;
+
+  return MEMCACHED_SUCCESS;
+}
+
+uint32_t memcached_get_hedging(const memcached_st *shell) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      return extension->hedge.percentile;
+    }
+  }
+
+  return 0;
+}
+
+void memcached_hedge_stat(const memcached_st *shell, struct memcached_hedge_stat_st *stat) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      stat->requests = extension->hedge.requests;
+      stat->hedged = extension->hedge.hedged;
+      stat->replica_wins = extension->hedge.replica_wins;
+      stat->wasted = extension->hedge.wasted;
+    }
+  }
+}
+
+static int64_t hedge_clock() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return int64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+/*
+  Record one latency sample and refresh the threshold every quarter window,
+  once a full window has been seen.
+*/
+static void hedge_sample(memcached_instance_st *instance, uint32_t percentile, int64_t latency) {
+  uint32_t *window = instance->hedge.latency;
+
+  window[instance->hedge.samples++ % MEMCACHED_HEDGE_WINDOW] =
+      uint32_t(std::min<int64_t>(latency, UINT32_MAX));
+
+  if (instance->hedge.samples >= MEMCACHED_HEDGE_WINDOW
+      and instance->hedge.samples % (MEMCACHED_HEDGE_WINDOW / 4) == 0)
+  {
+    uint32_t sorted[MEMCACHED_HEDGE_WINDOW];
+    uint32_t *nth = sorted + MEMCACHED_HEDGE_WINDOW * percentile / 100;
+
+    memcpy(sorted, window, sizeof(sorted));
+    std::nth_element(sorted, nth, sorted + MEMCACHED_HEDGE_WINDOW);
+    instance->hedge.threshold = std::max(*nth, uint32_t(1));
+  }
+}
+
+static bool hedge_send(Memcached *ptr, memcached_instance_st *instance, const char *key,
+                       size_t key_length) {
+  if (memcached_failed(memcached_connect(instance))) {
+    return false;
+  }
+
+  protocol_binary_request_getk request = {};
+  initialize_binary_request(instance, request.message.header);
+  request.message.header.request.opcode = PROTOCOL_BINARY_CMD_GETK;
+  request.message.header.request.keylen =
+      htons((uint16_t)(key_length + memcached_array_size(ptr->_namespace)));
+  request.message.header.request.datatype = PROTOCOL_BINARY_RAW_BYTES;
+  request.message.header.request.bodylen =
+      htonl((uint32_t)(key_length + memcached_array_size(ptr->_namespace)));
+
+  libmemcached_io_vector_st vector[] = {
+      {request.bytes, sizeof(request.bytes)},
+      {memcached_array_string(ptr->_namespace), memcached_array_size(ptr->_namespace)},
+      {key, key_length}};
+
+  if (memcached_io_writev(instance, vector, 3, true) == false) {
+    memcached_instance_response_reset(instance);
+    return false;
+  }
+  memcached_instance_response_increment(instance);
+
+  return true;
+}
+
+/*
+  Wait up to timeout microseconds for one of the instances to become
+  readable, a second instance is optional.
+*/
+static memcached_instance_st *hedge_wait(memcached_instance_st *first,
+                                         memcached_instance_st *second, int64_t timeout) {
+  if (first->read_buffer_length) {
+    return first;
+  }
+  if (second and second->read_buffer_length) {
+    return second;
+  }
+
+  struct pollfd fds[2];
+  nfds_t count = 0;
+  fds[count].fd = first->fd;
+  fds[count].events = POLLIN;
+  fds[count++].revents = 0;
+  if (second) {
+    fds[count].fd = second->fd;
+    fds[count].events = POLLIN;
+    fds[count++].revents = 0;
+  }
+
+  int active;
+  memcached_epoll_count_poll(first->root);
+#ifdef __linux__
+  timespec wait = {time_t(timeout / 1000000), long(timeout % 1000000) * 1000};
+  while ((active = ppoll(fds, count, &wait, NULL)) == SOCKET_ERROR and errno == EINTR) {
+  }
+#else
+  while ((active = poll(fds, count, int((timeout + 999) / 1000))) == SOCKET_ERROR
+         and get_socket_errno() == EINTR) {
+  }
+#endif
+  if (active <= 0) {
+    return NULL;
+  }
+
+  if (fds[0].revents) {
+    return first;
+  }
+  return second;
+}
+
+void memcached_hedge_settle(Memcached *ptr) {
+  memcached_extension_st *extension = memcached_extension(ptr);
+  if (extension == NULL or extension->hedge.pending == 0) {
+    return;
+  }
+
+  for (uint32_t x = 0; x < memcached_server_count(ptr); ++x) {
+    memcached_instance_st *instance = memcached_instance_fetch(ptr, x);
+    if (instance->hedge.pending == false) {
+      continue;
+    }
+    instance->hedge.pending = false;
+
+    // read the answer if it has arrived, a server that is still busy gets a new connection
+    if (instance->response_count() and hedge_wait(instance, NULL, 0)) {
+      (void) memcached_response(instance, &ptr->result);
+    } else {
+      memcached_io_reset(instance);
+    }
+  }
+
+  extension->hedge.pending = 0;
+}
+
+char *memcached_hedged_get(Memcached *ptr, const char *key, size_t key_length,
+                           size_t *value_length, uint32_t *flags, memcached_return_t *error) {
+  memcached_extension_st *extension = memcached_extension(ptr);
+
+  if (value_length) {
+    *value_length = 0;
+  }
+
+  if (memcached_failed(*error = initialize_query(ptr, true))) {
+    return NULL;
+  }
+  if (memcached_failed(*error = memcached_key_test(*ptr, &key, &key_length, 1)))
+  {
+    return NULL;
+  }
+
+  if (extension->hedge.rng == 0) {
+    extension->hedge.rng = memcached_prng_seed(extension);
+  }
+  uint32_t server_key = memcached_generate_hash_with_redistribution(ptr, key, key_length);
+  uint32_t replica_key =
+      (server_key + 1 + memcached_prng_next(extension->hedge.rng) % ptr->number_of_replicas)
+      % memcached_server_count(ptr);
+  memcached_instance_st *primary = memcached_instance_fetch(ptr, server_key);
+  memcached_instance_st *replica = NULL;
+
+  // anything still queued on these servers would be mistaken for our answer
+  for (memcached_instance_st *instance : {primary, memcached_instance_fetch(ptr, replica_key)}) {
+    while (instance->response_count()) {
+      (void) memcached_response(instance, &ptr->result);
+    }
+  }
+
+  extension->hedge.requests++;
+  int64_t start = hedge_clock();
+
+  memcached_instance_st *winner = NULL;
+  if (hedge_send(ptr, primary, key, key_length)) {
+    winner = primary->hedge.threshold ? hedge_wait(primary, NULL, primary->hedge.threshold)
+                                      : primary;
+  }
+
+  if (winner == NULL) {
+    memcached_instance_st *candidate = memcached_instance_fetch(ptr, replica_key);
+    if (hedge_send(ptr, candidate, key, key_length)) {
+      replica = candidate;
+      extension->hedge.hedged++;
+    }
+
+    if (primary->response_count() and replica) {
+      winner = hedge_wait(primary, replica, int64_t(ptr->poll_timeout) * 1000);
+    } else if (primary->response_count()) {
+      winner = primary;
+    } else {
+      winner = replica;
+    }
+  }
+
+  if (winner == NULL) {
+    // nobody answered in time, or nothing could be sent at all
+    *error = primary->response_count() or replica
+        ? memcached_set_error(*ptr, MEMCACHED_TIMEOUT, MEMCACHED_AT)
+        : memcached_set_error(*ptr, MEMCACHED_CONNECTION_FAILURE, MEMCACHED_AT);
+    memcached_io_reset(primary);
+    if (replica) {
+      memcached_io_reset(replica);
+    }
+    return NULL;
+  }
+
+  *error = memcached_response(winner, &ptr->result);
+  // only the primary's own answers feed its threshold
+  if (winner == primary) {
+    hedge_sample(primary, extension->hedge.percentile, hedge_clock() - start);
+  }
+
+  memcached_instance_st *loser = NULL;
+  if (replica) {
+    loser = winner == primary ? replica : primary;
+    if (winner == replica) {
+      extension->hedge.replica_wins++;
+    }
+  }
+
+  if (loser and loser->response_count()) {
+    extension->hedge.wasted++;
+    // a miss of replicated data is an answer, a failure takes the other answer if it is there
+    if (*error != MEMCACHED_SUCCESS and *error != MEMCACHED_NOTFOUND and *error != MEMCACHED_END
+        and hedge_wait(loser, NULL, 0))
+    {
+      *error = memcached_response(loser, &ptr->result);
+      if (loser == primary) {
+        hedge_sample(primary, extension->hedge.percentile, hedge_clock() - start);
+      }
+    } else {
+      loser->hedge.pending = true;
+      extension->hedge.pending++;
+    }
+  }
+
+  if (*error == MEMCACHED_END) {
+    *error = MEMCACHED_NOTFOUND;
+  }
+  if (*error != MEMCACHED_SUCCESS) {
+    return NULL;
+  }
+
+  if (value_length) {
+    *value_length = memcached_result_length(&ptr->result);
+  }
+  if (flags) {
+    *flags = memcached_result_flags(&ptr->result);
+  }
+  return memcached_string_take_value(&ptr->result.value);
+}
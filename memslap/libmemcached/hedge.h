@@ -0,0 +1,63 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Hedged gets.
+ *
+ * With hedging enabled, memcached_get() on a handle that keeps replicas
+ * (binary protocol with MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS) tracks the
+ * recent get latency of every server. A get still unanswered after the
+ * configured percentile of its primary's latency is sent once more to one
+ * of the replicas, and whichever answer arrives first is returned, a miss
+ * included. A failed answer is only replaced by the other one if that has
+ * already arrived. The response of the losing server is discarded before
+ * that server is used again, or its connection is reset if it is still not
+ * ready. Only answers of the primary itself count towards its latency.
+ */
+
+/* Percentile used by memslap and most callers */
+#define MEMCACHED_HEDGE_PERCENTILE_DEFAULT 95
+
+struct memcached_hedge_stat_st {
+  uint64_t requests;     /* gets eligible for hedging */
+  uint64_t hedged;       /* gets sent to a replica as well */
+  uint64_t replica_wins; /* hedged gets answered by the replica first */
+  uint64_t wasted;       /* responses read or connections reset only to drop an answer */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Enable hedged gets.
+ *
+ * @param percentile latency percentile (1-99) of the primary after which a get
+ *        is hedged, 0 disables hedging
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_set_hedging(memcached_st *ptr, uint32_t percentile);
+
+LIBMEMCACHED_API
+uint32_t memcached_get_hedging(const memcached_st *ptr);
+
+LIBMEMCACHED_API
+void memcached_hedge_stat(const memcached_st *ptr, struct memcached_hedge_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
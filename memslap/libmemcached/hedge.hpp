@@ -0,0 +1,31 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+static inline bool memcached_is_hedging(const Memcached *ptr) {
+  if (ptr->number_of_replicas and memcached_is_binary(ptr) and memcached_is_udp(ptr) == false) {
+    const memcached_extension_st *extension = memcached_extension(ptr);
+    return extension and extension->hedge.percentile;
+  }
+  return false;
+}
+
+/* Get a single key from its primary, hedged to a replica if the primary is slow */
+char *memcached_hedged_get(Memcached *ptr, const char *key, size_t key_length,
+                           size_t *value_length, uint32_t *flags, memcached_return_t *error);
+
+/* Dispose of the answers of servers that lost a hedged get */
+void memcached_hedge_settle(Memcached *ptr);
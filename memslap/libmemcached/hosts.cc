@@ -48,6 +48,14 @@ memcached_return_t run_distribution(Memcached *ptr) {
     sort_hosts(ptr);
   }
 
+  if (memcached_extended_distribution(ptr)) {
+    memcached_return_t rc = memcached_run_extended_distribution(ptr);
+    if (memcached_failed(rc)) {
+      return rc;
+    }
+    // extended distributions built on the standard ones continue below
+  }
+
   switch (ptr->distribution) {
   case MEMCACHED_DISTRIBUTION_CONSISTENT:
   case MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA:
@@ -71,42 +79,7 @@ memcached_return_t run_distribution(Memcached *ptr) {
   return MEMCACHED_SUCCESS;
 }
 
-static uint32_t ketama_server_hash(const char *key, size_t key_length, uint32_t alignment) {
-  unsigned char results[16];
-
-  libhashkit_md5_signature((unsigned char *) key, key_length, results);
-
-  return ((uint32_t)(results[3 + alignment * 4] & 0xFF) << 24)
-      | ((uint32_t)(results[2 + alignment * 4] & 0xFF) << 16)
-      | ((uint32_t)(results[1 + alignment * 4] & 0xFF) << 8) | (results[0 + alignment * 4] & 0xFF);
-}
-
-static int continuum_item_cmp(const void *t1, const void *t2) {
-  memcached_continuum_item_st *ct1 = (memcached_continuum_item_st *) t1;
-  memcached_continuum_item_st *ct2 = (memcached_continuum_item_st *) t2;
-
-  /* Why 153? Hmmm... */
-  WATCHPOINT_ASSERT(ct1->value != 153);
-  if (ct1->value == ct2->value) {
-    if (ct1->index == ct2->index) {
-      return 0;
-    } else if (ct1->index > ct2->index) {
-      return 1;
-    } else {
-      return -1;
-    }
-  } else if (ct1->value > ct2->value) {
-    return 1;
-  } else {
-    return -1;
-  }
-}
-
 static memcached_return_t update_continuum(Memcached *ptr) {
-  uint32_t continuum_index = 0;
-  uint32_t pointer_counter = 0;
-  uint32_t pointer_per_server = MEMCACHED_POINTS_PER_SERVER;
-  uint32_t pointer_per_hash = 1;
   uint32_t live_servers = 0;
   struct timeval now;
 
@@ -140,148 +113,7 @@ static memcached_return_t update_continuum(Memcached *ptr) {
     return MEMCACHED_SUCCESS;
   }
 
-  uint32_t points_per_server =
-      (uint32_t)(memcached_is_weighted_ketama(ptr) ? MEMCACHED_POINTS_PER_SERVER_KETAMA
-                                                   : MEMCACHED_POINTS_PER_SERVER);
-  uint32_t continuum_limit = live_servers * points_per_server;
-  uint32_t continuum_extra = MEMCACHED_CONTINUUM_ADDITION * points_per_server;
-
-  if (continuum_limit > ptr->ketama.continuum_count) {
-    memcached_continuum_item_st *new_ptr;
-
-    new_ptr = libmemcached_xrealloc(ptr, ptr->ketama.continuum, continuum_limit + continuum_extra,
-                                    memcached_continuum_item_st);
-
-    if (new_ptr == 0) {
-      return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
-    }
-
-    ptr->ketama.continuum = new_ptr;
-    ptr->ketama.continuum_count = continuum_limit + continuum_extra;
-  }
-  assert_msg(ptr->ketama.continuum, "Programmer Error, empty ketama continuum");
-
-  uint64_t total_weight = 0;
-  if (memcached_is_weighted_ketama(ptr)) {
-    for (uint32_t host_index = 0; host_index < memcached_server_count(ptr); ++host_index) {
-      if (is_auto_ejecting == false or list[host_index].next_retry <= now.tv_sec) {
-        total_weight += list[host_index].weight;
-      }
-    }
-  }
-
-  for (uint32_t host_index = 0; host_index < memcached_server_count(ptr); ++host_index) {
-    if (is_auto_ejecting and list[host_index].next_retry > now.tv_sec) {
-      continue;
-    }
-
-    if (memcached_is_weighted_ketama(ptr)) {
-      float pct = (float) list[host_index].weight / (float) total_weight;
-      pointer_per_server = (uint32_t)(
-          (::floor((float) (pct * MEMCACHED_POINTS_PER_SERVER_KETAMA / 4 * (float) live_servers
-                            + 0.0000000001F)))
-          * 4);
-      pointer_per_hash = 4;
-      if (0 && DEBUG) {
-        printf("ketama_weighted:%s|%d|%llu|%u\n", list[host_index]._hostname,
-               list[host_index].port(), (unsigned long long) list[host_index].weight,
-               pointer_per_server);
-      }
-    }
-
-    if (ptr->distribution == MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA_SPY) {
-      for (uint32_t pointer_index = 0; pointer_index < pointer_per_server / pointer_per_hash;
-           pointer_index++)
-      {
-        char sort_host[1 + MEMCACHED_NI_MAXHOST + 1 + MEMCACHED_NI_MAXSERV + 1
-                       + MEMCACHED_NI_MAXSERV] = "";
-        int sort_host_length;
-
-        // Spymemcached ketema key format is: hostname/ip:port-index
-        // If hostname is not available then: /ip:port-index
-        sort_host_length =
-            snprintf(sort_host, sizeof(sort_host), "/%s:%u-%u", list[host_index]._hostname,
-                     (uint32_t) list[host_index].port(), pointer_index);
-
-        if (size_t(sort_host_length) >= sizeof(sort_host) or sort_host_length < 0) {
-          return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT,
-                                     memcached_literal_param("snprintf(sizeof(sort_host))"));
-        }
-
-        if (0 && DEBUG) {
-          fprintf(stdout, "update_continuum: key is %s\n", sort_host);
-        }
-
-        if (memcached_is_weighted_ketama(ptr)) {
-          for (uint32_t x = 0; x < pointer_per_hash; x++) {
-            uint32_t value = ketama_server_hash(sort_host, (size_t) sort_host_length, x);
-            ptr->ketama.continuum[continuum_index].index = host_index;
-            ptr->ketama.continuum[continuum_index++].value = value;
-          }
-        } else {
-          uint32_t value = hashkit_digest(&ptr->hashkit, sort_host, (size_t) sort_host_length);
-          ptr->ketama.continuum[continuum_index].index = host_index;
-          ptr->ketama.continuum[continuum_index++].value = value;
-        }
-      }
-    } else {
-      for (uint32_t pointer_index = 1; pointer_index <= pointer_per_server / pointer_per_hash;
-           pointer_index++)
-      {
-        char sort_host[MEMCACHED_NI_MAXHOST + 1 + MEMCACHED_NI_MAXSERV + 1 + MEMCACHED_NI_MAXSERV] =
-            "";
-        int sort_host_length;
-
-        if (list[host_index].port() == MEMCACHED_DEFAULT_PORT) {
-          sort_host_length = snprintf(sort_host, sizeof(sort_host), "%s-%u",
-                                      list[host_index]._hostname, pointer_index - 1);
-        } else {
-          sort_host_length =
-              snprintf(sort_host, sizeof(sort_host), "%s:%u-%u", list[host_index]._hostname,
-                       (uint32_t) list[host_index].port(), pointer_index - 1);
-        }
-
-        if (size_t(sort_host_length) >= sizeof(sort_host) or sort_host_length < 0) {
-          return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT,
-                                     memcached_literal_param("snprintf(sizeof(sort_host)))"));
-        }
-
-        if (memcached_is_weighted_ketama(ptr)) {
-          for (uint32_t x = 0; x < pointer_per_hash; x++) {
-            uint32_t value = ketama_server_hash(sort_host, (size_t) sort_host_length, x);
-            ptr->ketama.continuum[continuum_index].index = host_index;
-            ptr->ketama.continuum[continuum_index++].value = value;
-          }
-        } else {
-          uint32_t value = hashkit_digest(&ptr->hashkit, sort_host, (size_t) sort_host_length);
-          ptr->ketama.continuum[continuum_index].index = host_index;
-          ptr->ketama.continuum[continuum_index++].value = value;
-        }
-      }
-    }
-
-    pointer_counter += pointer_per_server;
-  }
-
-  assert_msg(ptr, "Programmer Error, no valid ptr");
-  assert_msg(ptr->ketama.continuum, "Programmer Error, empty ketama continuum");
-  assert_msg(memcached_server_count(ptr) * MEMCACHED_POINTS_PER_SERVER <= MEMCACHED_CONTINUUM_SIZE,
-             "invalid size information being given to qsort()");
-  ptr->ketama.continuum_points_counter = pointer_counter;
-  qsort(ptr->ketama.continuum, ptr->ketama.continuum_points_counter,
-        sizeof(memcached_continuum_item_st), continuum_item_cmp);
-
-  if (DEBUG) {
-    for (uint32_t pointer_index = 0; memcached_server_count(ptr)
-         && pointer_index < ((live_servers * MEMCACHED_POINTS_PER_SERVER) - 1);
-         pointer_index++)
-    {
-      WATCHPOINT_ASSERT(ptr->ketama.continuum[pointer_index].value
-                        <= ptr->ketama.continuum[pointer_index + 1].value);
-    }
-  }
-
-  return MEMCACHED_SUCCESS;
+  return memcached_continuum_update(ptr, live_servers, is_auto_ejecting, now.tv_sec);
 }
 
 static memcached_return_t server_add(Memcached *memc, const memcached_string_t &hostname,
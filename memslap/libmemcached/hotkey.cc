@@ -0,0 +1,362 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/common.h"
+
+/* Attempts at finding a derived key that maps to a server not used yet */
+#define MEMCACHED_HOTKEY_PLACEMENT_ATTEMPTS 64
+
+struct memcached_hotkey_entry_st {
+  uint32_t count;
+  uint32_t error;
+  bool placed;
+  uint8_t replicas;
+  uint8_t suffix[MEMCACHED_HOTKEY_MAX_REPLICAS];
+  size_t key_length;
+  char key[MEMCACHED_MAX_KEY];
+};
+
+struct memcached_hotkey_st {
+  memcached_st *root;
+  uint32_t replicas;
+  uint32_t threshold;
+  uint32_t size;
+  uint32_t reads;
+  uint64_t rng; // picks the copy a hot read goes to
+  struct memcached_hotkey_stat_st stat;
+  /* kept apart from the entries so the lookup scans a dense array */
+  uint32_t hash[MEMCACHED_HOTKEY_CAPACITY];
+  struct memcached_hotkey_entry_st entry[MEMCACHED_HOTKEY_CAPACITY];
+};
+
+static inline uint32_t hotkey_hash(const char *key, size_t key_length) {
+  return memcached_generate_hash_value(key, key_length, MEMCACHED_HASH_FNV1A_32);
+}
+
+static int32_t hotkey_find(const memcached_hotkey_st *self, uint32_t hash, const char *key,
+                           size_t key_length) {
+  for (uint32_t x = 0; x < self->size; ++x) {
+    if (self->hash[x] == hash) {
+      const memcached_hotkey_entry_st &entry = self->entry[x];
+      if (entry.key_length == key_length and memcmp(entry.key, key, key_length) == 0) {
+        return int32_t(x);
+      }
+    }
+  }
+
+  return -1;
+}
+
+/*
+  Space-saving update: bump a monitored key, otherwise take over the slot of
+  the least frequent key and inherit its count as the error bound.
+*/
+static memcached_hotkey_entry_st &hotkey_record(memcached_hotkey_st *self, const char *key,
+                                                size_t key_length) {
+  if (++self->reads >= MEMCACHED_HOTKEY_WINDOW) {
+    // jumping window: age all counters instead of keeping per-window sketches
+    for (uint32_t x = 0; x < self->size; ++x) {
+      self->entry[x].count >>= 1;
+      self->entry[x].error >>= 1;
+    }
+    self->reads = 0;
+  }
+
+  uint32_t hash = hotkey_hash(key, key_length);
+  int32_t found = hotkey_find(self, hash, key, key_length);
+  if (found >= 0) {
+    memcached_hotkey_entry_st &entry = self->entry[found];
+    ++entry.count;
+    return entry;
+  }
+
+  uint32_t slot;
+  uint32_t min_count = 0;
+  if (self->size < MEMCACHED_HOTKEY_CAPACITY) {
+    slot = self->size++;
+  } else {
+    slot = 0;
+    min_count = self->entry[0].count;
+    for (uint32_t x = 1; x < self->size; ++x) {
+      if (self->entry[x].count < min_count) {
+        min_count = self->entry[x].count;
+        slot = x;
+      }
+    }
+  }
+
+  // replicas of an evicted key are left to expire
+  memcached_hotkey_entry_st &entry = self->entry[slot];
+  self->hash[slot] = hash;
+  entry.count = min_count + 1;
+  entry.error = min_count;
+  entry.placed = false;
+  entry.replicas = 0;
+  entry.key_length = key_length;
+  memcpy(entry.key, key, key_length);
+
+  return entry;
+}
+
+static inline bool hotkey_is_hot(const memcached_hotkey_st *self,
+                                 const memcached_hotkey_entry_st &entry) {
+  return entry.count - entry.error >= self->threshold;
+}
+
+static size_t hotkey_derive(char *buffer, const char *key, size_t key_length, uint8_t suffix) {
+  int length = snprintf(buffer + key_length, MEMCACHED_MAX_KEY - key_length, "#%u", unsigned(suffix));
+  if (length < 0 or key_length + size_t(length) >= MEMCACHED_MAX_KEY) {
+    return 0;
+  }
+  memcpy(buffer, key, key_length);
+  return key_length + size_t(length);
+}
+
+/*
+  Picks the suffixes of up to wanted derived keys which hash to distinct
+  servers other than the primary, so the copies actually spread the load. The
+  choice only depends on the key and the servers, and the suffixes for fewer
+  replicas are a prefix of those for more.
+*/
+static uint8_t hotkey_suffixes(memcached_hotkey_st *self, const char *key, size_t key_length,
+                               uint32_t wanted, uint8_t *suffix) {
+  uint32_t server_count = memcached_server_count(self->root);
+  if (server_count <= wanted) {
+    wanted = server_count ? server_count - 1 : 0;
+  }
+
+  uint32_t used[MEMCACHED_HOTKEY_MAX_REPLICAS + 1];
+  used[0] = memcached_generate_hash(self->root, key, key_length);
+  uint8_t count = 0;
+
+  char derived[MEMCACHED_MAX_KEY];
+  for (uint8_t attempt = 1; count < wanted and attempt <= MEMCACHED_HOTKEY_PLACEMENT_ATTEMPTS;
+       ++attempt)
+  {
+    size_t derived_length = hotkey_derive(derived, key, key_length, attempt);
+    if (derived_length == 0) {
+      break;
+    }
+
+    uint32_t server_key = memcached_generate_hash(self->root, derived, derived_length);
+    bool taken = false;
+    for (uint32_t x = 0; x <= count; ++x) {
+      if (used[x] == server_key) {
+        taken = true;
+        break;
+      }
+    }
+    if (taken == false) {
+      suffix[count++] = attempt;
+      used[count] = server_key;
+    }
+  }
+
+  return count;
+}
+
+static void hotkey_place(memcached_hotkey_st *self, memcached_hotkey_entry_st &entry) {
+  entry.replicas =
+      hotkey_suffixes(self, entry.key, entry.key_length, self->replicas, entry.suffix);
+  entry.placed = true;
+}
+
+/*
+  Deletes the copies of a key the sketch tracks as hot, or placed copies for
+  while it was. Copies of colder keys are left to expire. The deletes go out
+  without replies and are flushed together.
+*/
+static void hotkey_invalidate(memcached_hotkey_st *self, const char *key, size_t key_length) {
+  if (key_length == 0 or key_length >= MEMCACHED_MAX_KEY) {
+    return;
+  }
+
+  int32_t found = hotkey_find(self, hotkey_hash(key, key_length), key, key_length);
+  if (found < 0) {
+    return;
+  }
+  memcached_hotkey_entry_st &entry = self->entry[found];
+  if (entry.placed == false) {
+    if (hotkey_is_hot(self, entry) == false) {
+      return;
+    }
+    hotkey_place(self, entry);
+  }
+  if (entry.replicas == 0) {
+    return;
+  }
+
+  memcached_st *root = self->root;
+  bool buffering = memcached_is_buffering(root);
+  bool replying = memcached_is_replying(root);
+  memcached_set_replying(*root, false);
+  if (memcached_is_udp(root) == false) {
+    memcached_set_buffering(*root, true);
+  }
+
+  char derived[MEMCACHED_MAX_KEY];
+  for (uint8_t x = 0; x < entry.replicas; ++x) {
+    size_t derived_length = hotkey_derive(derived, key, key_length, entry.suffix[x]);
+    (void) memcached_delete(root, derived, derived_length, 0);
+    self->stat.invalidations++;
+  }
+  (void) memcached_flush_buffers(root);
+
+  memcached_set_buffering(*root, buffering);
+  memcached_set_replying(*root, replying);
+}
+
+memcached_hotkey_st *memcached_hotkey_create(memcached_st *memc, uint32_t replicas,
+                                             uint32_t threshold) {
+  if (memc == NULL or replicas == 0 or threshold == 0) {
+    return NULL;
+  }
+
+  memcached_hotkey_st *self = libmemcached_xmalloc(memc, memcached_hotkey_st);
+  if (self == NULL) {
+    return NULL;
+  }
+
+  memset(self, 0, sizeof(*self));
+  self->root = memc;
+  self->replicas =
+      replicas > MEMCACHED_HOTKEY_MAX_REPLICAS ? MEMCACHED_HOTKEY_MAX_REPLICAS : replicas;
+  self->threshold = threshold;
+  self->rng = memcached_prng_seed(self);
+
+  return self;
+}
+
+void memcached_hotkey_free(memcached_hotkey_st *self) {
+  if (self) {
+    libmemcached_free(self->root, self);
+  }
+}
+
+char *memcached_hotkey_get(memcached_hotkey_st *self, const char *key, size_t key_length,
+                           size_t *value_length, uint32_t *flags, memcached_return_t *error) {
+  if (self == NULL) {
+    memcached_return_t unused;
+    if (error == NULL) {
+      error = &unused;
+    }
+    *error = MEMCACHED_INVALID_ARGUMENTS;
+    return NULL;
+  }
+
+  if (key_length == 0 or key_length >= MEMCACHED_MAX_KEY) {
+    return memcached_get(self->root, key, key_length, value_length, flags, error);
+  }
+
+  memcached_hotkey_entry_st &entry = hotkey_record(self, key, key_length);
+  if (hotkey_is_hot(self, entry) == false) {
+    return memcached_get(self->root, key, key_length, value_length, flags, error);
+  }
+
+  self->stat.hot_reads++;
+  if (entry.placed == false) {
+    hotkey_place(self, entry);
+  }
+
+  uint32_t pick = entry.replicas ? memcached_prng_next(self->rng) % (entry.replicas + 1u) : 0;
+  if (pick == 0) {
+    return memcached_get(self->root, key, key_length, value_length, flags, error);
+  }
+
+  char derived[MEMCACHED_MAX_KEY];
+  size_t derived_length = hotkey_derive(derived, key, key_length, entry.suffix[pick - 1]);
+
+  memcached_return_t unused;
+  if (error == NULL) {
+    error = &unused;
+  }
+
+  size_t length;
+  uint32_t item_flags;
+  char *value = memcached_get(self->root, derived, derived_length, &length, &item_flags, error);
+  if (memcached_success(*error)) {
+    self->stat.replica_reads++;
+    if (value_length) {
+      *value_length = length;
+    }
+    if (flags) {
+      *flags = item_flags;
+    }
+    return value;
+  }
+
+  // replica missing or unreachable, serve from the primary and repair a miss
+  bool repair = (*error == MEMCACHED_NOTFOUND);
+  value = memcached_get(self->root, key, key_length, &length, &item_flags, error);
+  if (memcached_success(*error) and repair) {
+    if (memcached_success(memcached_set(self->root, derived, derived_length, value, length,
+                                        MEMCACHED_HOTKEY_REPLICA_EXPIRATION, item_flags)))
+    {
+      self->stat.replica_fills++;
+    }
+  }
+  if (value_length) {
+    *value_length = length;
+  }
+  if (flags) {
+    *flags = item_flags;
+  }
+
+  return value;
+}
+
+memcached_return_t memcached_hotkey_set(memcached_hotkey_st *self, const char *key,
+                                        size_t key_length, const char *value, size_t value_length,
+                                        time_t expiration, uint32_t flags) {
+  if (self == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_return_t rc =
+      memcached_set(self->root, key, key_length, value, value_length, expiration, flags);
+  if (memcached_success(rc)) {
+    hotkey_invalidate(self, key, key_length);
+  }
+
+  return rc;
+}
+
+memcached_return_t memcached_hotkey_delete(memcached_hotkey_st *self, const char *key,
+                                           size_t key_length) {
+  if (self == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_return_t rc = memcached_delete(self->root, key, key_length, 0);
+  if (memcached_success(rc) or rc == MEMCACHED_NOTFOUND) {
+    hotkey_invalidate(self, key, key_length);
+  }
+
+  return rc;
+}
+
+void memcached_hotkey_stat(const memcached_hotkey_st *self, struct memcached_hotkey_stat_st *stat) {
+  if (self == NULL or stat == NULL) {
+    return;
+  }
+
+  *stat = self->stat;
+  stat->hot_keys = 0;
+  for (uint32_t x = 0; x < self->size; ++x) {
+    if (hotkey_is_hot(self, self->entry[x])) {
+      stat->hot_keys++;
+    }
+  }
+}
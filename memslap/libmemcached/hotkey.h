@@ -0,0 +1,99 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Client-side hot-key replication.
+ *
+ * A memcached_hotkey_st tracks read frequencies with a space-saving sketch over
+ * a jumping window. Keys whose guaranteed count reaches the threshold are copied
+ * to up to `replicas` additional servers under derived keys ("<key>#<n>"), and
+ * reads of hot keys are spread randomly over the primary and its replicas.
+ * Writes through a tracker delete the copies of keys it tracks as hot; copies
+ * of keys that cooled down expire after MEMCACHED_HOTKEY_REPLICA_EXPIRATION.
+ *
+ * A tracker is bound to one memcached_st and, like it, must only be used from
+ * one thread at a time.
+ */
+typedef struct memcached_hotkey_st memcached_hotkey_st;
+
+/* Number of keys tracked by the sketch */
+#define MEMCACHED_HOTKEY_CAPACITY 128
+/* Number of reads after which all counters are halved */
+#define MEMCACHED_HOTKEY_WINDOW 16384
+/* Upper bound on the number of replicas of a single key */
+#define MEMCACHED_HOTKEY_MAX_REPLICAS 8
+/* Expiration of replica copies, bounds staleness for writers bypassing the trackers */
+#define MEMCACHED_HOTKEY_REPLICA_EXPIRATION 60
+
+struct memcached_hotkey_stat_st {
+  uint64_t hot_reads;       /* reads of keys considered hot */
+  uint64_t replica_reads;   /* reads served by a replica */
+  uint64_t replica_fills;   /* replica misses repaired from the primary */
+  uint64_t invalidations;   /* replica deletes issued by writes */
+  uint32_t hot_keys;        /* keys currently above the threshold */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Create a hot-key tracker for the given client.
+ *
+ * @param memc the client used for all requests, must outlive the tracker
+ * @param replicas number of additional servers a hot key is copied to
+ * @param threshold number of reads within a window that makes a key hot
+ * @return NULL on invalid arguments or if allocation fails
+ */
+LIBMEMCACHED_API
+memcached_hotkey_st *memcached_hotkey_create(memcached_st *memc, uint32_t replicas,
+                                             uint32_t threshold);
+
+LIBMEMCACHED_API
+void memcached_hotkey_free(memcached_hotkey_st *self);
+
+/**
+ * Like memcached_get(), but records the read and serves hot keys from a
+ * randomly chosen replica, filling it from the primary on a miss.
+ */
+LIBMEMCACHED_API
+char *memcached_hotkey_get(memcached_hotkey_st *self, const char *key, size_t key_length,
+                           size_t *value_length, uint32_t *flags, memcached_return_t *error);
+
+/**
+ * Like memcached_set(), but deletes the replicas of the key if this tracker
+ * considers it hot or placed replicas for it.
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_hotkey_set(memcached_hotkey_st *self, const char *key,
+                                        size_t key_length, const char *value, size_t value_length,
+                                        time_t expiration, uint32_t flags);
+
+/**
+ * Like memcached_delete(), but also removes the replicas of a hot key, as
+ * memcached_hotkey_set() does.
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_hotkey_delete(memcached_hotkey_st *self, const char *key,
+                                           size_t key_length);
+
+LIBMEMCACHED_API
+void memcached_hotkey_stat(const memcached_hotkey_st *self, struct memcached_hotkey_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
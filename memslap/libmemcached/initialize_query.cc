@@ -32,6 +32,7 @@ memcached_return_t initialize_query(Memcached *self, bool increment_query_id) {
     return memcached_set_error(*self, MEMCACHED_NO_SERVERS, MEMCACHED_AT);
   }
 
+  memcached_hedge_settle(self);
   memcached_error_free(*self);
   memcached_result_reset(&self->result);
 
@@ -15,7 +15,9 @@
 
 #include "libmemcached/common.h"
 
-static inline void _server_init(memcached_instance_st *self, Memcached *root,
+#include <algorithm>
+
+static inline bool _server_init(memcached_instance_st *self, Memcached *root,
                                 const memcached_string_t &hostname, in_port_t port, uint32_t weight,
                                 memcached_connection_t type) {
   self->options.is_shutting_down = false;
@@ -42,11 +44,35 @@ static inline void _server_init(memcached_instance_st *self, Memcached *root,
   self->minor_version = UINT8_MAX;
   self->type = type;
   self->error_messages = NULL;
+  self->read_buffer = NULL;
+  self->write_buffer = NULL;
+  self->_hostname = NULL;
+  self->buffer.read_size = MEMCACHED_MIN_BUFFER;
+  self->buffer.write_size = MEMCACHED_MIN_BUFFER;
+  self->buffer.fills = 0;
+  self->buffer.peak = 0;
+  self->buffer.grow = false;
+  self->buffer.direct_reads = 0;
   self->read_ptr = self->read_buffer;
   self->read_buffer_length = 0;
   self->write_buffer_offset = 0;
   self->address_info = NULL;
   self->address_info_next = NULL;
+  self->hedge.samples = 0;
+  self->hedge.threshold = 0;
+  self->hedge.pending = false;
+  self->bounded_load = 0;
+  self->epoll.registered = false;
+  self->epoll.readable = false;
+  self->async.slots = NULL;
+  self->async.size = 0;
+  self->async.head = 0;
+  self->async.count = 0;
+  self->async.since = 0;
+  self->udp.message = NULL;
+  self->udp.length = 0;
+  self->udp.offset = 0;
+  self->udp.size = 0;
 
   self->state = MEMCACHED_SERVER_STATE_NEW;
   self->next_retry = 0;
@@ -58,7 +84,7 @@ static inline void _server_init(memcached_instance_st *self, Memcached *root,
     self->version = UINT_MAX;
   }
   self->limit_maxbytes = 0;
-  self->hostname(hostname);
+  return self->hostname(hostname);
 }
 
 static memcached_instance_st *_server_create(memcached_instance_st *self,
@@ -113,9 +139,18 @@ memcached_instance_st *instance_create_with(memcached_st *memc, memcached_instan
     return NULL;
   }
 
-  _server_init(self, const_cast<memcached_st *>(memc), _hostname, port, weight, type);
+  if (_server_init(self, const_cast<memcached_st *>(memc), _hostname, port, weight, type) == false
+      or (memc and memcached_is_udp(memc) and memcached_instance_write_buffer(self) == false))
+  {
+    libmemcached_free(memc, self->_hostname);
+    if (memcached_is_allocated(self)) {
+      libmemcached_free(memc, self);
+    }
+    return NULL; /* MEMCACHED_MEMORY_ALLOCATION_FAILURE */
+  }
 
   if (memc and memcached_is_udp(memc)) {
+    // datagrams carry their header in front of the write buffer
     self->write_buffer_offset = UDP_DATAGRAM_HEADER_LENGTH;
     memcached_io_init_udp_header(self, 0);
   }
@@ -131,6 +166,12 @@ void instance_free(memcached_instance_st *self) {
 
   memcached_error_free(*self);
 
+  memcached_instance_release_buffers(self);
+  memcached_async_release(self);
+  memcached_udp_release(self);
+  libmemcached_free(self->root, self->_hostname);
+  self->_hostname = NULL;
+
   if (memcached_is_allocated(self)) {
     libmemcached_free(self->root, self);
   } else {
@@ -138,6 +179,79 @@ void instance_free(memcached_instance_st *self) {
   }
 }
 
+bool memcached_instance_read_buffer(memcached_instance_st *self) {
+  if (self->read_buffer_length) {
+    return self->read_buffer != NULL;
+  }
+
+  uint32_t size = self->buffer.read_size;
+  if (self->buffer.grow) {
+    size = std::min(size * 2, uint32_t(MEMCACHED_MAX_BUFFER));
+    self->buffer.grow = false;
+  } else if (self->buffer.fills >= MEMCACHED_BUFFER_WINDOW) {
+    if (self->buffer.peak * 4 <= size) {
+      size = std::max(size / 2, uint32_t(MEMCACHED_MIN_BUFFER));
+    }
+    self->buffer.fills = 0;
+    self->buffer.peak = 0;
+  }
+
+  if (self->read_buffer == NULL or size != self->buffer.read_size) {
+    char *buffer = libmemcached_xrealloc(self->root, self->read_buffer, size, char);
+    if (buffer == NULL) {
+      return false;
+    }
+    self->read_buffer = buffer;
+    self->read_ptr = buffer;
+    self->buffer.read_size = size;
+  }
+
+  return true;
+}
+
+bool memcached_instance_write_buffer(memcached_instance_st *self) {
+  if (self->write_buffer == NULL) {
+    self->write_buffer = libmemcached_xvalloc(self->root, self->buffer.write_size, char);
+  }
+
+  return self->write_buffer != NULL;
+}
+
+void memcached_instance_release_buffers(memcached_instance_st *self) {
+  libmemcached_free(self->root, self->read_buffer);
+  libmemcached_free(self->root, self->write_buffer);
+  self->read_buffer = NULL;
+  self->write_buffer = NULL;
+  self->read_ptr = NULL;
+  self->read_buffer_length = 0;
+  self->write_buffer_offset = 0;
+}
+
+void memcached_buffer_stat(const memcached_st *shell, memcached_buffer_stat_st *stat) {
+  const Memcached *memc = memcached2Memcached(shell);
+  if (memc == NULL or stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  for (uint32_t x = 0; x < memcached_instance_list_count(memc); x++) {
+    const memcached_instance_st *instance = memcached_instance_by_position(memc, x);
+
+    stat->servers++;
+    if (instance->fd != INVALID_SOCKET) {
+      stat->connected++;
+    }
+    stat->server_bytes += sizeof(memcached_instance_st) + strlen(instance->_hostname) + 1;
+    if (instance->read_buffer) {
+      stat->read_bytes += instance->buffer.read_size;
+    }
+    if (instance->write_buffer) {
+      stat->write_bytes += instance->buffer.write_size;
+    }
+    stat->direct_reads += instance->buffer.direct_reads;
+  }
+}
+
 void memcached_instance_free(memcached_instance_st *self) {
   if (self) {
     instance_free(self);
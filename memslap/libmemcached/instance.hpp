@@ -35,6 +35,14 @@
 
 #include "libmemcached/string.hpp"
 
+/* Number of recent get latencies a hedging threshold is derived from */
+#define MEMCACHED_HEDGE_WINDOW 128
+
+// read and write buffers start this small and double up to MEMCACHED_MAX_BUFFER
+#define MEMCACHED_MIN_BUFFER 512
+// reads after which an oversized read buffer is halved
+#define MEMCACHED_BUFFER_WINDOW 64
+
 // @todo Complete class transformation
 struct memcached_instance_st {
   in_port_t port() const { return port_; }
@@ -78,14 +86,18 @@ struct memcached_instance_st {
 
   const char *hostname() { return _hostname; }
 
-  void hostname(const memcached_string_t &hostname_) {
-    if (hostname_.size) {
-      memcpy(_hostname, hostname_.c_str, hostname_.size);
-      _hostname[hostname_.size] = 0;
-    } else {
-      memcpy(_hostname, memcached_literal_param("localhost"));
-      _hostname[memcached_literal_param_size("localhost")] = 0;
+  bool hostname(const memcached_string_t &hostname_) {
+    const char *name = hostname_.size ? hostname_.c_str : "localhost";
+    size_t length = hostname_.size ? hostname_.size : memcached_literal_param_size("localhost");
+    char *copy = libmemcached_xvalloc(root, length + 1, char);
+    if (copy == NULL) {
+      return false;
     }
+    memcpy(copy, name, length);
+    copy[length] = 0;
+    libmemcached_free(root, _hostname);
+    _hostname = copy;
+    return true;
   }
 
   void events(short);
@@ -122,9 +134,41 @@ struct memcached_instance_st {
   struct memcached_st *root;
   uint64_t limit_maxbytes;
   struct memcached_error_t *error_messages;
-  char read_buffer[MEMCACHED_MAX_BUFFER];
-  char write_buffer[MEMCACHED_MAX_BUFFER];
-  char _hostname[MEMCACHED_NI_MAXHOST];
+  char *read_buffer;  // NULL until the first read, see memcached_instance_read_buffer()
+  char *write_buffer; // NULL until the first write
+  char *_hostname;
+  struct {
+    uint32_t read_size;
+    uint32_t write_size;
+    uint32_t fills; // reads into the read buffer in the current window
+    uint32_t peak;  // largest of them
+    bool grow;      // the last read filled the read buffer
+    uint64_t direct_reads; // values read around the read buffer
+  } buffer;
+  struct {
+    uint32_t latency[MEMCACHED_HEDGE_WINDOW]; // microseconds, used as a ring
+    uint32_t samples;
+    uint32_t threshold; // microseconds, 0 until the window has filled once
+    bool pending;       // the answer to a lost hedged get is still unread
+  } hedge;
+  uint32_t bounded_load; // decayed count of requests, MEMCACHED_DISTRIBUTION_BOUNDED_LOAD only
+  struct {
+    bool registered; // fd is in the epoll set of root, see epoll.h
+    bool readable;   // an edge was seen since the last read ran dry
+  } epoll;
+  struct {
+    struct memcached_async_slot_st *slots; // ring of the requests in flight, see async.h
+    uint32_t size;
+    uint32_t head;  // oldest request
+    uint32_t count;
+    int64_t since; // ms when a poll first waited since the last response, 0 until then
+  } async;
+  struct {
+    char *message; // collected get responses not read yet, see udp.h
+    size_t length;
+    size_t offset; // read up to here
+    size_t size;
+  } udp;
 
   void clear_addrinfo() {
     if (address_info) {
@@ -144,3 +188,10 @@ memcached_return_t memcached_instance_push(memcached_st *ptr, const memcached_in
                                            uint32_t);
 
 void instance_free(memcached_instance_st *);
+
+/* Allocates the buffer on first use, and sizes an empty read buffer to the recent reads */
+bool memcached_instance_read_buffer(memcached_instance_st *);
+bool memcached_instance_write_buffer(memcached_instance_st *);
+
+/* Frees both buffers of an idle instance */
+void memcached_instance_release_buffers(memcached_instance_st *);
@@ -17,6 +17,8 @@
 #include "p9y/poll.hpp"
 #include "p9y/clock_gettime.hpp"
 
+#include <algorithm>
+
 void initialize_binary_request(memcached_instance_st *server,
                                protocol_binary_request_header &header) {
   server->request_id++;
@@ -33,6 +35,10 @@ enum memc_read_or_write { MEM_READ, MEM_WRITE };
  * @param instance the server to pack
  */
 static bool repack_input_buffer(memcached_instance_st *instance) {
+  if (memcached_instance_read_buffer(instance) == false) {
+    return false;
+  }
+
   if (instance->read_ptr != instance->read_buffer) {
     /* Move all of the data to the beginning of the buffer so
      ** that we can fit more data into the buffer...
@@ -42,12 +48,13 @@ static bool repack_input_buffer(memcached_instance_st *instance) {
   }
 
   /* There is room in the buffer, try to fill it! */
-  if (instance->read_buffer_length != MEMCACHED_MAX_BUFFER) {
+  if (instance->read_buffer_length != instance->buffer.read_size) {
     do {
       /* Just try a single read to grab what's available */
       ssize_t nr;
+      memcached_io_count_recv(instance->root);
       if ((nr = ::recv(instance->fd, instance->read_ptr + instance->read_buffer_length,
-                       MEMCACHED_MAX_BUFFER - instance->read_buffer_length, MSG_NOSIGNAL))
+                       instance->buffer.read_size - instance->read_buffer_length, MSG_NOSIGNAL))
           <= 0)
       {
         if (nr == 0) {
@@ -174,6 +181,7 @@ memcached_return_t memcached_io_poll(memcached_instance_st *inst, int16_t events
   }
   start = tspec.tv_sec * 1000000000 + tspec.tv_nsec;
   while (true) {
+    memcached_epoll_count_poll(inst->root);
     int active = poll(&pfd, 1, poll_timeout);
 
     if (active == SOCKET_ERROR) {
@@ -257,6 +265,12 @@ static memcached_return_t io_wait(memcached_instance_st *instance, const short e
     instance->io_wait_count.write++;
   } else {
     instance->io_wait_count.read++;
+
+    // reads only wait once recv() ran dry
+    instance->epoll.readable = false;
+    if (memcached_is_epoll(instance->root)) {
+      return memcached_epoll_wait_for_read(instance);
+    }
   }
 
   return memcached_io_poll(instance, events);
@@ -285,9 +299,9 @@ static bool io_flush(memcached_instance_st *instance, const bool with_flush,
 
   /* Looking for memory overflows */
 #if defined(DEBUG)
-  if (write_length == MEMCACHED_MAX_BUFFER)
+  if (write_length == instance->buffer.write_size)
     WATCHPOINT_ASSERT(instance->write_buffer == local_write_ptr);
-  WATCHPOINT_ASSERT((instance->write_buffer + MEMCACHED_MAX_BUFFER)
+  WATCHPOINT_ASSERT((instance->write_buffer + instance->buffer.write_size)
                     >= (local_write_ptr + write_length));
 #endif
 
@@ -302,6 +316,7 @@ static bool io_flush(memcached_instance_st *instance, const bool with_flush,
       flags = MSG_NOSIGNAL | MSG_MORE;
     }
 
+    memcached_io_count_send(instance->root);
     ssize_t sent_length = ::send(instance->fd, local_write_ptr, write_length, flags);
     int local_errno = get_socket_errno(); // We cache in case memcached_quit_server() modifies errno
 
@@ -369,10 +384,13 @@ memcached_return_t memcached_io_wait_for_read(memcached_instance_st *instance) {
   return io_wait(instance, POLLIN);
 }
 
-static memcached_return_t _io_fill(memcached_instance_st *instance) {
+/* A single read of at most size bytes into buffer, waiting for data if there is none */
+static memcached_return_t io_recv(memcached_instance_st *instance, char *buffer, size_t size,
+                                  size_t &received) {
   ssize_t data_read;
   do {
-    data_read = ::recv(instance->fd, instance->read_buffer, MEMCACHED_MAX_BUFFER, MSG_NOSIGNAL);
+    memcached_io_count_recv(instance->root);
+    data_read = ::recv(instance->fd, buffer, size, MSG_NOSIGNAL);
     int local_errno = get_socket_errno(); // We cache in case memcached_quit_server() modifies errno
 
     if (data_read == SOCKET_ERROR) {
@@ -437,15 +455,42 @@ static memcached_return_t _io_fill(memcached_instance_st *instance) {
   } while (data_read <= 0);
 
   instance->io_bytes_sent = 0;
-  instance->read_buffer_length = (size_t) data_read;
-  instance->read_ptr = instance->read_buffer;
+  received = size_t(data_read);
 
   return MEMCACHED_SUCCESS;
 }
 
+static memcached_return_t _io_fill(memcached_instance_st *instance) {
+  if (memcached_instance_read_buffer(instance) == false) {
+    return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  memcached_return_t rc = MEMCACHED_SUCCESS;
+  size_t received;
+  if (memcached_is_udp(instance->root)) {
+    received = 0;
+    if (memcached_success(rc = memcached_udp_fill(instance))) {
+      received = instance->read_buffer_length;
+    }
+  } else if (memcached_success(rc = io_recv(instance, instance->read_buffer,
+                                            instance->buffer.read_size, received)))
+  {
+    instance->read_buffer_length = received;
+    instance->read_ptr = instance->read_buffer;
+  }
+
+  if (memcached_success(rc)) {
+    // feeds the size of the next read buffer
+    instance->buffer.fills++;
+    instance->buffer.peak = std::max(instance->buffer.peak, uint32_t(received));
+    instance->buffer.grow = received == instance->buffer.read_size;
+  }
+
+  return rc;
+}
+
 memcached_return_t memcached_io_read(memcached_instance_st *instance, void *buffer, size_t length,
                                      ssize_t &nread) {
-  assert(memcached_is_udp(instance->root) == false);
   assert_msg(
       instance,
       "Programmer error, memcached_io_read() recieved an invalid Instance"); // Programmer error
@@ -459,6 +504,22 @@ memcached_return_t memcached_io_read(memcached_instance_st *instance, void *buff
   }
 
   while (length) {
+    if (instance->read_buffer_length == 0 and length >= instance->buffer.read_size
+        and not memcached_is_udp(instance->root))
+    {
+      // a large value goes straight to its destination
+      size_t received;
+      memcached_return_t io_recv_ret;
+      if (memcached_fatal(io_recv_ret = io_recv(instance, buffer_ptr, length, received))) {
+        nread = -1;
+        return io_recv_ret;
+      }
+      instance->buffer.direct_reads++;
+      buffer_ptr += received;
+      length -= received;
+      continue;
+    }
+
     if (instance->read_buffer_length == 0) {
       memcached_return_t io_fill_ret;
       if (memcached_fatal(io_fill_ret = _io_fill(instance))) {
@@ -503,7 +564,8 @@ memcached_return_t memcached_io_slurp(memcached_instance_st *instance) {
   ssize_t data_read;
   char buffer[MEMCACHED_MAX_BUFFER];
   do {
-    data_read = ::recv(instance->fd, instance->read_buffer, sizeof(buffer), MSG_NOSIGNAL);
+    memcached_io_count_recv(instance->root);
+    data_read = ::recv(instance->fd, buffer, sizeof(buffer), MSG_NOSIGNAL);
     if (data_read == SOCKET_ERROR) {
       switch (get_socket_errno()) {
       case EINTR: // We just retry
@@ -543,6 +605,23 @@ memcached_return_t memcached_io_slurp(memcached_instance_st *instance) {
   return MEMCACHED_CONNECTION_FAILURE;
 }
 
+/* Batches of requests grow a full write buffer, up to MEMCACHED_MAX_BUFFER, before it is flushed */
+static bool grow_write_buffer(memcached_instance_st *instance) {
+  if (instance->buffer.write_size >= MEMCACHED_MAX_BUFFER) {
+    return false;
+  }
+
+  uint32_t size = std::min(instance->buffer.write_size * 2, uint32_t(MEMCACHED_MAX_BUFFER));
+  char *buffer = libmemcached_xrealloc(instance->root, instance->write_buffer, size, char);
+  if (buffer == NULL) {
+    return false;
+  }
+  instance->write_buffer = buffer;
+  instance->buffer.write_size = size;
+
+  return true;
+}
+
 static bool _io_write(memcached_instance_st *instance, const void *buffer, size_t length,
                       bool with_flush, size_t &written) {
   assert(instance->fd != INVALID_SOCKET);
@@ -552,9 +631,15 @@ static bool _io_write(memcached_instance_st *instance, const void *buffer, size_
 
   const size_t original_length = length;
 
+  if (memcached_instance_write_buffer(instance) == false) {
+    memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    written = 0;
+    return false;
+  }
+
   while (length) {
     char *write_ptr;
-    size_t buffer_end = MEMCACHED_MAX_BUFFER;
+    size_t buffer_end = instance->buffer.write_size;
     size_t should_write = buffer_end - instance->write_buffer_offset;
     should_write = (should_write < length) ? should_write : length;
 
@@ -564,7 +649,7 @@ static bool _io_write(memcached_instance_st *instance, const void *buffer, size_
     buffer_ptr += should_write;
     length -= should_write;
 
-    if (instance->write_buffer_offset == buffer_end) {
+    if (instance->write_buffer_offset == buffer_end and grow_write_buffer(instance) == false) {
       WATCHPOINT_ASSERT(instance->fd != INVALID_SOCKET);
 
       memcached_return_t rc;
@@ -642,6 +727,9 @@ void memcached_instance_st::reset_socket() {
     (void) closesocket(fd);
     fd = INVALID_SOCKET;
   }
+  // closing drops the socket from the epoll set
+  epoll.registered = false;
+  epoll.readable = false;
 }
 
 void memcached_instance_st::close_socket() {
@@ -665,7 +753,14 @@ void memcached_instance_st::close_socket() {
   state = MEMCACHED_SERVER_STATE_NEW;
   cursor_active_ = 0;
   io_bytes_sent = 0;
-  write_buffer_offset = size_t(root and memcached_is_udp(root) ? UDP_DATAGRAM_HEADER_LENGTH : 0);
+  udp.length = 0;
+  udp.offset = 0;
+  if (root and memcached_is_udp(root)) {
+    write_buffer_offset = UDP_DATAGRAM_HEADER_LENGTH;
+  } else {
+    // an idle instance holds no buffers
+    memcached_instance_release_buffers(this);
+  }
   read_buffer_length = 0;
   read_ptr = read_buffer;
   options.is_shutting_down = false;
@@ -677,6 +772,10 @@ void memcached_instance_st::close_socket() {
 }
 
 memcached_instance_st *memcached_io_get_readable_server(Memcached *memc, memcached_return_t &) {
+  if (memcached_is_epoll(memc)) {
+    return memcached_epoll_readable(memc);
+  }
+
 #define MAX_SERVERS_TO_POLL 100
   struct pollfd fds[MAX_SERVERS_TO_POLL];
   nfds_t host_index = 0;
@@ -688,6 +787,11 @@ memcached_instance_st *memcached_io_get_readable_server(Memcached *memc, memcach
       return instance;
     }
 
+    // UDP responses were collected by memcached_udp_mget() already
+    if (memcached_is_udp(memc) and instance->response_count() > 0) {
+      return instance;
+    }
+
     if (instance->response_count() > 0) {
       fds[host_index].events = POLLIN;
       fds[host_index].revents = 0;
@@ -709,6 +813,7 @@ memcached_instance_st *memcached_io_get_readable_server(Memcached *memc, memcach
     return NULL;
   }
 
+  memcached_epoll_count_poll(memc);
   int error = poll(fds, host_index, memc->poll_timeout);
   switch (error) {
   case -1:
@@ -797,16 +902,22 @@ memcached_return_t memcached_io_readline(memcached_instance_st *instance, char *
       ++total_nr;
     }
 
-    /* Now let's look in the buffer and copy as we go! */
-    while (instance->read_buffer_length and total_nr < size and line_complete == false) {
-      *buffer_ptr = *instance->read_ptr;
-      if (*buffer_ptr == '\n') {
+    /* Now let's look in the buffer for the end of the line, and copy up to it */
+    if (instance->read_buffer_length and total_nr < size and line_complete == false) {
+      size_t available = std::min(instance->read_buffer_length, size - total_nr);
+      const char *end = instance->read_ptr + available;
+      const char *newline = memcached_scan_byte<true>(instance->read_ptr, end, '\n');
+      size_t length = available;
+      if (newline != end) {
+        length = size_t(newline - instance->read_ptr) + 1;
         line_complete = true;
       }
-      --instance->read_buffer_length;
-      ++instance->read_ptr;
-      ++total_nr;
-      ++buffer_ptr;
+
+      memcpy(buffer_ptr, instance->read_ptr, length);
+      instance->read_buffer_length -= length;
+      instance->read_ptr += length;
+      total_nr += length;
+      buffer_ptr += length;
     }
 
     if (total_nr == size) {
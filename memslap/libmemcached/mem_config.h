@@ -1,4 +1,5 @@
 #pragma once
+#define DEBUG 0
 #define HAVE_BACKTRACE 1
 #define BACKTRACE_HEADER <execinfo.h>
 /* #undef WORDS_BIGENDIAN */
@@ -69,3 +70,5 @@
 #define HAVE_GETLINE 1
 #define HAVE__SC_NPROCESSORS_ONLN 1
 #define HAVE_LIBEVENT 1
+#define HAVE_ZLIB 1
+/* #undef HAVE_CSL_PARSER */
@@ -111,6 +111,7 @@ static void memcached_free_ex(Memcached *ptr, bool release_st) {
   memcached_result_free(&ptr->result);
 
   memcached_virtual_bucket_free(ptr);
+  memcached_extension_free(ptr);
 
   memcached_instance_free((memcached_instance_st *) ptr->last_disconnected_server);
 
@@ -118,8 +119,7 @@ static void memcached_free_ex(Memcached *ptr, bool release_st) {
     ptr->on_cleanup(ptr);
   }
 
-  libmemcached_free(ptr, ptr->ketama.continuum);
-  ptr->ketama.continuum = NULL;
+  memcached_continuum_release(ptr);
 
   memcached_array_free(ptr->_namespace);
   ptr->_namespace = NULL;
@@ -160,6 +160,9 @@ memcached_st *memcached_create(memcached_st *shell) {
     return NULL;
   }
 
+  // drop whatever a handle previously living here left behind
+  memcached_extension_free(shell);
+
   Memcached *memc = memcached2Memcached(shell);
   if (memcached_result_create(shell, &memc->result) == NULL) {
     memcached_free(shell);
@@ -234,10 +237,7 @@ memcached_return_t memcached_reset(memcached_st *shell) {
 void memcached_servers_reset(memcached_st *shell) {
   Memcached *self = memcached2Memcached(shell);
   if (self) {
-    libmemcached_free(self, self->ketama.continuum);
-    self->ketama.continuum = NULL;
-    self->ketama.continuum_count = 0;
-    self->ketama.continuum_points_counter = 0;
+    memcached_continuum_release(self);
 
     memcached_instance_list_free(memcached_instance_list(self), self->number_of_hosts);
     memcached_instance_set(self, NULL, 0);
@@ -288,6 +288,7 @@ memcached_st *memcached_clone(memcached_st *clone, const memcached_st *source) {
   new_clone->retry_timeout = source->retry_timeout;
   new_clone->dead_timeout = source->dead_timeout;
   new_clone->distribution = source->distribution;
+  memcached_virtual_bucket_clone(new_clone, source);
 
   if (hashkit_clone(&new_clone->hashkit, &source->hashkit) == NULL) {
     memcached_free(new_clone);
@@ -314,6 +315,11 @@ memcached_st *memcached_clone(memcached_st *clone, const memcached_st *source) {
   new_clone->number_of_replicas = source->number_of_replicas;
   new_clone->tcp_keepidle = source->tcp_keepidle;
 
+  if (memcached_failed(memcached_extension_clone(new_clone, source))) {
+    memcached_free(new_clone);
+    return NULL;
+  }
+
   if (memcached_server_count(source)) {
     if (memcached_failed(memcached_push(new_clone, source))) {
       return NULL;
@@ -0,0 +1,33 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * The meta protocol of memcached 1.6, next to the text and binary protocols.
+ *
+ * Selected with MEMCACHED_BEHAVIOR_BINARY_PROTOCOL set to
+ * MEMCACHED_PROTOCOL_META, which memcached_behavior_get() then returns.
+ * Gets send "mg <key> v f k q" per key and end a multi-get with "mn": misses
+ * leave no response, and every hit carries its key, so the "MN" of each
+ * server closes its part. Sets, adds, replaces, appends, prepends and cas
+ * send "ms", deletes "md", touches "mg" with a new TTL, and increments and
+ * decrements "ma". Meta commands always get a status, even with
+ * MEMCACHED_BEHAVIOR_NOREPLY, since failures are reported in quiet mode too.
+ */
+
+#define MEMCACHED_PROTOCOL_TEXT   0
+#define MEMCACHED_PROTOCOL_BINARY 1
+#define MEMCACHED_PROTOCOL_META   2
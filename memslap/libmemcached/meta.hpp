@@ -0,0 +1,28 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+static inline bool memcached_is_meta(const Memcached *ptr) {
+  const memcached_extension_st *extension = memcached_extension(ptr);
+  return extension and extension->meta;
+}
+
+/* Counts the status of a meta command that memcached_vdo() did not count */
+#define memcached_meta_expect_reply(A) do {             \
+    if (memcached_is_replying((A)->root) == false) {    \
+        memcached_server_response_increment(A);         \
+    }                                                   \
+} while (0)
@@ -0,0 +1,286 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/common.h"
+
+#include <atomic>
+#include <new>
+#include <thread>
+
+struct memcached_mux_request_st {
+  memcached_mux_request_st *next; // in the submission stack
+  memcached_async_op_t op;
+  const char *key;
+  size_t key_length;
+  const char *value;
+  size_t value_length;
+  time_t expiration;
+  uint32_t flags;
+
+  // written by the owner before done
+  memcached_return_t rc;
+  char *result;
+  size_t result_length;
+  uint32_t result_flags;
+  std::atomic<bool> done;
+};
+
+struct memcached_mux_st {
+  memcached_st *memc; // the clone of the owners
+  std::atomic<memcached_mux_request_st *> submitted;
+  std::atomic_flag owned;
+  std::atomic<uint64_t> requests;
+  uint64_t turns, batches;
+
+  memcached_mux_st()
+  : memc{NULL}
+  , submitted{NULL}
+  , requests{0}
+  , turns{0}
+  , batches{0} {
+    owned.clear();
+  }
+};
+
+static void mux_completed(const memcached_st *, const memcached_async_result_st *result,
+                          void *context) {
+  memcached_mux_st *self = static_cast<memcached_mux_st *>(context);
+  memcached_mux_request_st *request = static_cast<memcached_mux_request_st *>(result->user_data);
+
+  request->rc = result->rc;
+  if (result->op == MEMCACHED_ASYNC_GET and memcached_success(result->rc)) {
+    request->result = static_cast<char *>(libmemcached_malloc(self->memc, result->value_length + 1));
+    if (request->result) {
+      memcpy(request->result, result->value, result->value_length);
+      request->result[result->value_length] = 0;
+      request->result_length = result->value_length;
+      request->result_flags = result->flags;
+    } else {
+      request->rc = MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+    }
+  }
+  // the waiting thread may return right away
+  request->done.store(true, std::memory_order_release);
+}
+
+/* Sends the requests of all threads queued so far, oldest first */
+static void mux_submit(memcached_mux_st *self) {
+  memcached_mux_request_st *stack = self->submitted.exchange(NULL, std::memory_order_acquire);
+  if (stack == NULL) {
+    return;
+  }
+  self->batches++;
+
+  memcached_mux_request_st *queue = NULL;
+  while (stack) {
+    memcached_mux_request_st *next = stack->next;
+    stack->next = queue;
+    queue = stack;
+    stack = next;
+  }
+
+  while (queue) {
+    memcached_mux_request_st *request = queue;
+    queue = queue->next;
+
+    memcached_return_t rc;
+    switch (request->op) {
+    case MEMCACHED_ASYNC_GET:
+      rc = memcached_async_get(self->memc, request->key, request->key_length, request);
+      break;
+
+    case MEMCACHED_ASYNC_SET:
+      rc = memcached_async_set(self->memc, request->key, request->key_length, request->value,
+                               request->value_length, request->expiration, request->flags,
+                               request);
+      break;
+
+    case MEMCACHED_ASYNC_DELETE:
+    default:
+      rc = memcached_async_delete(self->memc, request->key, request->key_length, request);
+      break;
+    }
+    if (memcached_failed(rc)) {
+      request->rc = rc;
+      request->done.store(true, std::memory_order_release);
+    }
+  }
+}
+
+/* Waits for request, doing the I/O of all threads while no other thread does */
+static memcached_return_t mux_execute(memcached_mux_st *self, memcached_mux_request_st &request) {
+  self->requests.fetch_add(1, std::memory_order_relaxed);
+
+  request.next = self->submitted.load(std::memory_order_relaxed);
+  while (not self->submitted.compare_exchange_weak(request.next, &request,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed))
+  {
+  }
+
+  while (not request.done.load(std::memory_order_acquire)) {
+    if (self->owned.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    self->turns++;
+    int timeout = int(memcached_behavior_get(self->memc, MEMCACHED_BEHAVIOR_POLL_TIMEOUT));
+    while (not request.done.load(std::memory_order_acquire)) {
+      mux_submit(self);
+      // requests queued meanwhile go out with the next response, and those of a server silent
+      // for the timeout complete with MEMCACHED_TIMEOUT
+      memcached_async_poll(self->memc, timeout, NULL);
+    }
+    self->owned.clear(std::memory_order_release);
+  }
+
+  return request.rc;
+}
+
+static void mux_request_init(memcached_mux_request_st &request, memcached_async_op_t op,
+                             const char *key, size_t key_length) {
+  request.next = NULL;
+  request.op = op;
+  request.key = key;
+  request.key_length = key_length;
+  request.value = NULL;
+  request.value_length = 0;
+  request.expiration = 0;
+  request.flags = 0;
+  request.rc = MEMCACHED_SUCCESS;
+  request.result = NULL;
+  request.result_length = 0;
+  request.result_flags = 0;
+  request.done.store(false, std::memory_order_relaxed);
+}
+
+memcached_mux_st *memcached_mux_create(const memcached_st *memc) {
+  if (memc == NULL) {
+    return NULL;
+  }
+
+  uint64_t protocol = memcached_behavior_get(const_cast<memcached_st *>(memc),
+                                             MEMCACHED_BEHAVIOR_BINARY_PROTOCOL);
+  if (protocol != MEMCACHED_PROTOCOL_BINARY and protocol != MEMCACHED_PROTOCOL_META) {
+    return NULL;
+  }
+
+  memcached_st *clone = memcached_clone(NULL, memc);
+  if (clone == NULL) {
+    return NULL;
+  }
+
+  void *memory = libmemcached_malloc(clone, sizeof(memcached_mux_st));
+  if (memory == NULL) {
+    memcached_free(clone);
+    return NULL;
+  }
+
+  memcached_mux_st *self = new (memory) memcached_mux_st();
+  self->memc = clone;
+  if (memcached_failed(memcached_async_set_callback(clone, mux_completed, self))) {
+    memcached_mux_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void memcached_mux_free(memcached_mux_st *self) {
+  if (self) {
+    memcached_st *clone = self->memc;
+    self->~memcached_mux_st();
+    libmemcached_free(clone, self);
+    memcached_free(clone);
+  }
+}
+
+char *memcached_mux_get(memcached_mux_st *self, const char *key, size_t key_length,
+                        size_t *value_length, uint32_t *flags, memcached_return_t *error) {
+  memcached_return_t unused;
+  if (error == NULL) {
+    error = &unused;
+  }
+  if (value_length) {
+    *value_length = 0;
+  }
+  if (flags) {
+    *flags = 0;
+  }
+  if (self == NULL) {
+    *error = MEMCACHED_INVALID_ARGUMENTS;
+    return NULL;
+  }
+
+  memcached_mux_request_st request;
+  mux_request_init(request, MEMCACHED_ASYNC_GET, key, key_length);
+  *error = mux_execute(self, request);
+  if (request.result) {
+    if (value_length) {
+      *value_length = request.result_length;
+    }
+    if (flags) {
+      *flags = request.result_flags;
+    }
+  }
+
+  return request.result;
+}
+
+memcached_return_t memcached_mux_set(memcached_mux_st *self, const char *key, size_t key_length,
+                                     const char *value, size_t value_length, time_t expiration,
+                                     uint32_t flags) {
+  if (self == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_mux_request_st request;
+  mux_request_init(request, MEMCACHED_ASYNC_SET, key, key_length);
+  request.value = value;
+  request.value_length = value_length;
+  request.expiration = expiration;
+  request.flags = flags;
+
+  return mux_execute(self, request);
+}
+
+memcached_return_t memcached_mux_delete(memcached_mux_st *self, const char *key,
+                                        size_t key_length) {
+  if (self == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_mux_request_st request;
+  mux_request_init(request, MEMCACHED_ASYNC_DELETE, key, key_length);
+
+  return mux_execute(self, request);
+}
+
+void memcached_mux_stat(const memcached_mux_st *self, struct memcached_mux_stat_st *stat) {
+  if (stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  if (self) {
+    struct memcached_async_stat_st async;
+    memcached_async_stat(self->memc, &async);
+    stat->requests = self->requests.load(std::memory_order_relaxed);
+    stat->turns = self->turns;
+    stat->batches = self->batches;
+    stat->polls = async.polls;
+  }
+}
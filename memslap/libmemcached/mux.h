@@ -0,0 +1,82 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Connections shared by threads.
+ *
+ * A memcached_mux_st keeps one clone of a handle, and so one connection per
+ * server, for any number of threads. A request is pushed onto a lock-free
+ * submission stack, and the thread waiting for it becomes the I/O owner if no
+ * other thread is: the owner sends the queued requests of all threads with
+ * the asynchronous API and completes their responses, matched by opaque, until
+ * its own request is done. Threads whose request is still in flight then take
+ * over, so there is no I/O thread of its own.
+ *
+ * The handle must use the binary or meta protocol.
+ */
+typedef struct memcached_mux_st memcached_mux_st;
+
+struct memcached_mux_stat_st {
+  uint64_t requests; /* submitted by all threads */
+  uint64_t turns;    /* times a thread became the I/O owner */
+  uint64_t batches;  /* submission stacks taken by an owner */
+  uint64_t polls;    /* memcached_async_poll() calls of the owners */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Create a multiplexer on a clone of the given client.
+ *
+ * @param memc the client to clone, only used during the call
+ * @return NULL on invalid arguments, for the text protocol or if allocation fails
+ */
+LIBMEMCACHED_API
+memcached_mux_st *memcached_mux_create(const memcached_st *memc);
+
+/* No thread may be waiting for a request of self */
+LIBMEMCACHED_API
+void memcached_mux_free(memcached_mux_st *self);
+
+/**
+ * Like memcached_get(), from any thread. The value is allocated by the
+ * allocators of the client.
+ */
+LIBMEMCACHED_API
+char *memcached_mux_get(memcached_mux_st *self, const char *key, size_t key_length,
+                        size_t *value_length, uint32_t *flags, memcached_return_t *error);
+
+/* Like memcached_set(), from any thread */
+LIBMEMCACHED_API
+memcached_return_t memcached_mux_set(memcached_mux_st *self, const char *key, size_t key_length,
+                                     const char *value, size_t value_length, time_t expiration,
+                                     uint32_t flags);
+
+/* Like memcached_delete(), from any thread */
+LIBMEMCACHED_API
+memcached_return_t memcached_mux_delete(memcached_mux_st *self, const char *key,
+                                        size_t key_length);
+
+/* Not synchronized with the owner, to be read once the threads are done */
+LIBMEMCACHED_API
+void memcached_mux_stat(const memcached_mux_st *self, struct memcached_mux_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
@@ -16,7 +16,9 @@
 #include "libmemcached/common.h"
 #include "libmemcached/options.hpp"
 
-#include "libmemcached/csl/context.h"
+#ifdef HAVE_CSL_PARSER
+#  include "libmemcached/csl/context.h"
+#endif
 
 const char *memcached_parse_filename(memcached_st *memc) {
   assert_msg(memc, "Invalid memcached_st");
@@ -97,12 +99,20 @@ memcached_return_t memcached_parse_configuration(memcached_st *self, char const
     return MEMCACHED_INVALID_ARGUMENTS;
   }
 
+#ifdef HAVE_CSL_PARSER
   memcached_return_t rc;
   Context context(option_string, length, self, rc);
 
   context.start();
 
   return rc;
+#else
+  // the generated parser is not part of this tree, servers are added through the API
+  (void) option_string;
+  (void) length;
+  return memcached_set_error(*self, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+                             memcached_literal_param("configuration strings are not supported"));
+#endif
 }
 
 void memcached_set_configuration_file(memcached_st *self, const char *filename,
@@ -0,0 +1,265 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/common.h"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+
+#define POOL_CLASSES   20
+#define POOL_LARGE     POOL_CLASSES
+#define POOL_SLAB_SIZE (256 * 1024)
+
+static const uint32_t pool_class_size[POOL_CLASSES] = {
+    16,   32,   48,   64,   96,   128,  192,  256,  384,   512,
+    768,  1024, 1536, 2048, 3072, 4096, 6144, 8192, 12288, 16384};
+
+struct pool_heap;
+
+/* Precedes every block, 16 bytes keep the payload aligned */
+struct pool_header {
+  pool_heap *owner; // NULL for blocks from malloc()
+  uint64_t size_class : 8;
+  uint64_t capacity : 56;
+};
+
+/* A free block, over its header */
+struct pool_free {
+  pool_free *next;
+};
+
+struct pool_heap {
+  pool_free *local[POOL_CLASSES];
+  std::atomic<pool_free *> remote[POOL_CLASSES]; // pushed by other threads
+  pool_heap *next;      // of all heaps
+  pool_heap *abandoned; // next heap of an exited thread
+  std::atomic<uint64_t> allocations;
+  std::atomic<uint64_t> remote_frees;
+  std::atomic<uint64_t> large;
+  std::atomic<uint64_t> slab_bytes;
+};
+
+static std::mutex pool_lock;
+static pool_heap *pool_heaps = NULL;
+static pool_heap *pool_abandoned = NULL;
+static uint32_t pool_heap_count = 0;
+
+/* The heap of a thread goes to the next thread once it exits */
+static thread_local struct pool_thread {
+  pool_heap *heap;
+
+  ~pool_thread() {
+    if (heap) {
+      std::lock_guard<std::mutex> guard(pool_lock);
+      heap->abandoned = pool_abandoned;
+      pool_abandoned = heap;
+      // frees by later destructors of this thread must not touch a heap another thread took
+      heap = NULL;
+    }
+  }
+} pool_self;
+
+static inline void pool_count(std::atomic<uint64_t> &counter, uint64_t amount = 1) {
+  // only written by the owner
+  counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+static inline uint32_t pool_class(size_t size) {
+  for (uint32_t x = 0; x < POOL_CLASSES; ++x) {
+    if (size <= pool_class_size[x]) {
+      return x;
+    }
+  }
+  return POOL_LARGE;
+}
+
+static pool_heap *pool_heap_get() {
+  if (pool_self.heap) {
+    return pool_self.heap;
+  }
+
+  std::lock_guard<std::mutex> guard(pool_lock);
+  pool_heap *heap = pool_abandoned;
+  if (heap) {
+    pool_abandoned = heap->abandoned;
+  } else {
+    heap = new (std::nothrow) pool_heap();
+    if (heap == NULL) {
+      return NULL;
+    }
+    heap->next = pool_heaps;
+    pool_heaps = heap;
+    pool_heap_count++;
+  }
+
+  pool_self.heap = heap;
+  return heap;
+}
+
+static pool_free *pool_carve(pool_heap *heap, uint32_t size_class) {
+  size_t block = sizeof(pool_header) + pool_class_size[size_class];
+  size_t count = POOL_SLAB_SIZE / block;
+  char *slab = static_cast<char *>(std::malloc(count * block));
+  if (slab == NULL) {
+    return NULL;
+  }
+  pool_count(heap->slab_bytes, count * block);
+
+  pool_free *list = NULL;
+  for (size_t x = count; x-- > 0;) {
+    pool_free *node = reinterpret_cast<pool_free *>(slab + x * block);
+    node->next = list;
+    list = node;
+  }
+
+  return list;
+}
+
+static void *pool_large(size_t size) {
+  pool_header *header = static_cast<pool_header *>(std::malloc(sizeof(pool_header) + size));
+  if (header == NULL) {
+    return NULL;
+  }
+
+  header->owner = NULL;
+  header->size_class = POOL_LARGE;
+  header->capacity = size;
+  if (pool_heap *heap = pool_heap_get()) {
+    pool_count(heap->large);
+  }
+
+  return header + 1;
+}
+
+void *memcached_pool_malloc(const memcached_st *, const size_t size, void *) {
+  uint32_t size_class = pool_class(size);
+  pool_heap *heap;
+  if (size_class == POOL_LARGE or (heap = pool_heap_get()) == NULL) {
+    return pool_large(size);
+  }
+
+  pool_free *block = heap->local[size_class];
+  if (block == NULL) {
+    block = heap->remote[size_class].exchange(NULL, std::memory_order_acquire);
+    if (block == NULL and (block = pool_carve(heap, size_class)) == NULL) {
+      return NULL;
+    }
+  }
+  heap->local[size_class] = block->next;
+  pool_count(heap->allocations);
+
+  pool_header *header = reinterpret_cast<pool_header *>(block);
+  header->owner = heap;
+  header->size_class = size_class;
+  header->capacity = pool_class_size[size_class];
+
+  return header + 1;
+}
+
+void memcached_pool_free(const memcached_st *, void *mem, void *) {
+  if (mem == NULL) {
+    return;
+  }
+
+  pool_header *header = static_cast<pool_header *>(mem) - 1;
+  pool_heap *owner = header->owner;
+  if (owner == NULL) {
+    std::free(header);
+    return;
+  }
+
+  uint32_t size_class = header->size_class;
+  pool_free *block = reinterpret_cast<pool_free *>(header);
+  if (owner == pool_self.heap) {
+    block->next = owner->local[size_class];
+    owner->local[size_class] = block;
+    return;
+  }
+
+  // the owner only ever takes the whole list, so pushes need no ABA protection
+  owner->remote_frees.fetch_add(1, std::memory_order_relaxed);
+  pool_free *head = owner->remote[size_class].load(std::memory_order_relaxed);
+  do {
+    block->next = head;
+  } while (not owner->remote[size_class].compare_exchange_weak(
+      head, block, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void *memcached_pool_realloc(const memcached_st *ptr, void *mem, const size_t size,
+                             void *context) {
+  if (mem == NULL) {
+    return memcached_pool_malloc(ptr, size, context);
+  }
+
+  pool_header *header = static_cast<pool_header *>(mem) - 1;
+  size_t capacity = header->capacity;
+  if (size <= capacity) {
+    return mem;
+  }
+
+  if (header->owner == NULL) {
+    pool_header *grown =
+        static_cast<pool_header *>(std::realloc(header, sizeof(pool_header) + size));
+    if (grown == NULL) {
+      return NULL;
+    }
+    grown->capacity = size;
+    return grown + 1;
+  }
+
+  void *moved = memcached_pool_malloc(ptr, size, context);
+  if (moved) {
+    memcpy(moved, mem, capacity);
+    memcached_pool_free(ptr, mem, context);
+  }
+
+  return moved;
+}
+
+void *memcached_pool_calloc(const memcached_st *ptr, size_t nelem, const size_t elsize,
+                            void *context) {
+  if (elsize and nelem > SIZE_MAX / elsize) {
+    return NULL;
+  }
+
+  void *mem = memcached_pool_malloc(ptr, nelem * elsize, context);
+  if (mem) {
+    memset(mem, 0, nelem * elsize);
+  }
+
+  return mem;
+}
+
+memcached_return_t memcached_set_pool_allocators(memcached_st *ptr) {
+  return memcached_set_memory_allocators(ptr, memcached_pool_malloc, memcached_pool_free,
+                                         memcached_pool_realloc, memcached_pool_calloc, NULL);
+}
+
+void memcached_pool_stat(struct memcached_pool_stat_st *stat) {
+  if (stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  std::lock_guard<std::mutex> guard(pool_lock);
+  for (pool_heap *heap = pool_heaps; heap; heap = heap->next) {
+    stat->allocations += heap->allocations.load(std::memory_order_relaxed);
+    stat->remote_frees += heap->remote_frees.load(std::memory_order_relaxed);
+    stat->large += heap->large.load(std::memory_order_relaxed);
+    stat->slab_bytes += heap->slab_bytes.load(std::memory_order_relaxed);
+  }
+  stat->heaps = pool_heap_count;
+}
@@ -0,0 +1,68 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Pooled allocators for memcached_set_memory_allocators().
+ *
+ * Requests of up to 16 KiB are served from per-thread free lists of fixed
+ * size classes, carved from slabs which are never returned to the system.
+ * A block freed by another thread than the one it came from is pushed onto
+ * a lock-free list of its owner, which takes the whole list back at its
+ * next allocation of that size. Heaps of exited threads are handed to new
+ * threads. Larger requests go to malloc().
+ */
+
+struct memcached_pool_stat_st {
+  uint64_t allocations;  /* blocks handed out by the pool */
+  uint64_t remote_frees; /* blocks freed by another thread than their owner */
+  uint64_t large;        /* requests passed on to malloc() */
+  uint64_t slab_bytes;   /* taken from malloc() for slabs */
+  uint32_t heaps;        /* threads which allocated from the pool, at most */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Installs the functions below as allocators of the handle. Like any
+ * allocators, right after memcached_create(), before the handle allocated
+ * anything. Clones take them along.
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_set_pool_allocators(memcached_st *ptr);
+
+LIBMEMCACHED_API
+void *memcached_pool_malloc(const memcached_st *ptr, const size_t size, void *context);
+
+LIBMEMCACHED_API
+void memcached_pool_free(const memcached_st *ptr, void *mem, void *context);
+
+LIBMEMCACHED_API
+void *memcached_pool_realloc(const memcached_st *ptr, void *mem, const size_t size, void *context);
+
+LIBMEMCACHED_API
+void *memcached_pool_calloc(const memcached_st *ptr, size_t nelem, const size_t elsize,
+                            void *context);
+
+/* Of all handles of the process */
+LIBMEMCACHED_API
+void memcached_pool_stat(struct memcached_pool_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
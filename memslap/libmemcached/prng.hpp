@@ -0,0 +1,39 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+  Per-owner pseudo random numbers for request routing. random() serializes
+  all threads on the lock of its global state.
+*/
+
+/* A non-zero xorshift state, distinct per owner */
+static inline uint64_t memcached_prng_seed(const void *owner) {
+  // splitmix64 over the address and the time
+  uint64_t z = uint64_t(uintptr_t(owner)) + 0x9E3779B97F4A7C15ull * uint64_t(time(NULL));
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  z ^= z >> 31;
+  return z ? z : 1;
+}
+
+/* xorshift64* */
+static inline uint32_t memcached_prng_next(uint64_t &state) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return uint32_t((state * 0x2545F4914F6CDD1Dull) >> 32);
+}
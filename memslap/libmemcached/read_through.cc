@@ -0,0 +1,217 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/common.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Adapts the batched loader to the single key MEMCACHED_CALLBACK_GET_FAILURE hook */
+static memcached_return_t read_through_trigger(const memcached_st *ptr, const char *key,
+                                               size_t key_length, memcached_result_st *result) {
+  memcached_extension_st *extension = memcached_extension(ptr);
+  if (extension == NULL or extension->read_through.loader == NULL) {
+    return MEMCACHED_NOTFOUND;
+  }
+
+  memcached_return_t status = MEMCACHED_NOTFOUND;
+  memcpy(result->item_key, key, key_length);
+  result->key_length = key_length;
+
+  extension->read_through.loads++;
+  extension->read_through.keys_missed++;
+  memcached_return_t rc = extension->read_through.loader(
+      ptr, &key, &key_length, 1, result, &status, extension->read_through.context);
+  if (memcached_failed(rc)) {
+    return rc;
+  }
+  if (status == MEMCACHED_SUCCESS) {
+    extension->read_through.keys_loaded++;
+  }
+  return status;
+}
+
+memcached_return_t memcached_set_read_through(memcached_st *shell,
+                                              memcached_read_through_fn loader, void *context) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  extension->read_through.loader = loader;
+  extension->read_through.context = context;
+  ptr->get_key_failure = loader ? read_through_trigger : NULL;
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_read_through_stat(const memcached_st *shell,
+                                 struct memcached_read_through_stat_st *stat) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      stat->loads = extension->read_through.loads;
+      stat->keys_missed = extension->read_through.keys_missed;
+      stat->keys_loaded = extension->read_through.keys_loaded;
+    }
+  }
+}
+
+static memcached_return_t read_through_execute(const Memcached *ptr, memcached_result_st *result,
+                                               memcached_execute_fn *callback, void *context,
+                                               uint32_t number_of_callbacks) {
+  for (uint32_t x = 0; x < number_of_callbacks; x++) {
+    memcached_return_t rc = (*callback[x])(ptr, result, context);
+    if (rc != MEMCACHED_SUCCESS) {
+      return rc;
+    }
+  }
+  return MEMCACHED_SUCCESS;
+}
+
+/*
+  Write loaded values back with quiet sets that are only buffered, so all of
+  them leave in one flush per server.
+*/
+static memcached_return_t read_through_fill(Memcached *ptr, memcached_result_st *results,
+                                            const memcached_return_t *status,
+                                            size_t number_of_keys) {
+  bool buffer_requests = ptr->flags.buffer_requests;
+  bool reply = ptr->flags.reply;
+  ptr->flags.buffer_requests = true;
+  ptr->flags.reply = false;
+
+  memcached_return_t rc = MEMCACHED_SUCCESS;
+  for (size_t x = 0; x < number_of_keys and memcached_success(rc); x++) {
+    if (status[x] == MEMCACHED_SUCCESS) {
+      memcached_result_st *result = &results[x];
+      rc = memcached_set(ptr, memcached_result_key_value(result), memcached_result_key_length(result),
+                         memcached_result_value(result), memcached_result_length(result),
+                         result->item_expiration, memcached_result_flags(result));
+    }
+  }
+  if (memcached_success(rc)) {
+    rc = memcached_flush_buffers(ptr);
+  }
+
+  ptr->flags.buffer_requests = buffer_requests;
+  ptr->flags.reply = reply;
+
+  return rc;
+}
+
+memcached_return_t memcached_mget_read_through(memcached_st *shell, const char *const *keys,
+                                               const size_t *key_length, size_t number_of_keys,
+                                               memcached_execute_fn *callback, void *context,
+                                               uint32_t number_of_callbacks) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_return_t rc = memcached_mget(ptr, keys, key_length, number_of_keys);
+  if (memcached_failed(rc) and rc != MEMCACHED_SOME_ERRORS) {
+    return rc;
+  }
+
+  std::unordered_map<std::string, size_t> pending;
+  pending.reserve(number_of_keys);
+  for (size_t x = 0; x < number_of_keys; x++) {
+    pending.emplace(std::string(keys[x], key_length[x]), x);
+  }
+
+  memcached_result_st hit;
+  if (memcached_result_create(ptr, &hit) == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  memcached_return_t callback_rc = MEMCACHED_SUCCESS;
+  while (memcached_fetch_result(ptr, &hit, &rc)) {
+    pending.erase(std::string(memcached_result_key_value(&hit), memcached_result_key_length(&hit)));
+    if (memcached_success(callback_rc)) {
+      callback_rc = read_through_execute(ptr, &hit, callback, context, number_of_callbacks);
+    }
+  }
+  memcached_result_free(&hit);
+
+  if (rc != MEMCACHED_END and rc != MEMCACHED_NOTFOUND and rc != MEMCACHED_SUCCESS) {
+    return rc;
+  }
+  if (memcached_failed(callback_rc)) {
+    return callback_rc;
+  }
+
+  memcached_extension_st *extension = memcached_extension(ptr);
+  if (pending.empty() or extension == NULL or extension->read_through.loader == NULL) {
+    return MEMCACHED_SUCCESS;
+  }
+
+  // misses in request order
+  std::vector<size_t> index;
+  index.reserve(pending.size());
+  for (auto &miss : pending) {
+    index.push_back(miss.second);
+  }
+  std::sort(index.begin(), index.end());
+
+  size_t misses = index.size();
+  std::vector<const char *> miss_keys(misses);
+  std::vector<size_t> miss_length(misses);
+  std::vector<memcached_return_t> status(misses, MEMCACHED_NOTFOUND);
+  std::vector<memcached_result_st> results(misses);
+  for (size_t x = 0; x < misses; x++) {
+    miss_keys[x] = keys[index[x]];
+    miss_length[x] = key_length[index[x]];
+    memcached_result_create(ptr, &results[x]);
+    memcpy(results[x].item_key, miss_keys[x], miss_length[x]);
+    results[x].key_length = miss_length[x];
+  }
+
+  extension->read_through.loads++;
+  extension->read_through.keys_missed += misses;
+  rc = extension->read_through.loader(ptr, miss_keys.data(), miss_length.data(), misses,
+                                      results.data(), status.data(),
+                                      extension->read_through.context);
+
+  if (memcached_success(rc)) {
+    for (size_t x = 0; x < misses and memcached_success(rc); x++) {
+      if (status[x] == MEMCACHED_SUCCESS) {
+        extension->read_through.keys_loaded++;
+        rc = read_through_execute(ptr, &results[x], callback, context, number_of_callbacks);
+      }
+    }
+  }
+  if (memcached_success(rc)) {
+    rc = read_through_fill(ptr, results.data(), status.data(), misses);
+  }
+
+  for (auto &result : results) {
+    memcached_result_free(&result);
+  }
+
+  return rc;
+}
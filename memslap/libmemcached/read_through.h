@@ -0,0 +1,82 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Read-through loading.
+ *
+ * A loader registered with memcached_set_read_through() is asked for the
+ * values of keys the servers do not have. memcached_get() consults it through
+ * the MEMCACHED_CALLBACK_GET_FAILURE hook, memcached_mget_read_through() hands
+ * it all misses of a multi-get in a single call. Loaded values are returned to
+ * the caller and written back to the servers.
+ */
+
+/**
+ * Load missing keys from the backing store.
+ *
+ * results[i] is initialized and carries keys[i] as its key. For every key
+ * found the loader stores the value, and optionally flags and expiration,
+ * in results[i] and sets status[i] to MEMCACHED_SUCCESS. status[] starts out
+ * as MEMCACHED_NOTFOUND.
+ */
+typedef memcached_return_t (*memcached_read_through_fn)(const memcached_st *ptr,
+                                                        const char *const *keys,
+                                                        const size_t *key_length,
+                                                        size_t number_of_keys,
+                                                        memcached_result_st *results,
+                                                        memcached_return_t *status, void *context);
+
+struct memcached_read_through_stat_st {
+  uint64_t loads;        /* calls of the loader */
+  uint64_t keys_missed;  /* keys passed to the loader */
+  uint64_t keys_loaded;  /* keys the loader found and that were written back */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Register the loader used for misses, NULL removes it.
+ *
+ * This replaces any MEMCACHED_CALLBACK_GET_FAILURE callback of the handle.
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_set_read_through(memcached_st *ptr, memcached_read_through_fn loader,
+                                              void *context);
+
+/**
+ * Fetch keys, loading all misses with one call of the loader.
+ *
+ * The callbacks are run for every hit and every loaded key. Loaded values are
+ * written back with buffered, quiet sets flushed once at the end.
+ *
+ * @return MEMCACHED_SUCCESS unless fetching, loading or writing back failed
+ */
+LIBMEMCACHED_API
+memcached_return_t memcached_mget_read_through(memcached_st *ptr, const char *const *keys,
+                                               const size_t *key_length, size_t number_of_keys,
+                                               memcached_execute_fn *callback, void *context,
+                                               uint32_t number_of_callbacks);
+
+LIBMEMCACHED_API
+void memcached_read_through_stat(const memcached_st *ptr,
+                                 struct memcached_read_through_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,208 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/common.h"
+#include "p9y/random.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/* Weight of a new latency sample: 1 / 2^REPLICA_READ_EWMA_SHIFT */
+#define REPLICA_READ_EWMA_SHIFT 3
+
+/* Latencies are kept in 1/16 microseconds */
+#define REPLICA_READ_LATENCY_SHIFT 4
+
+/*
+  Load of every server as seen by all clones of a handle. Updates are
+  relaxed: a lost latency sample under contention only delays the average.
+*/
+struct memcached_replica_load_st {
+  std::atomic<uint32_t> references;
+  uint32_t servers;
+  struct server_load {
+    std::atomic<uint32_t> in_flight;
+    std::atomic<uint32_t> latency; // moving average
+  } server[1];
+};
+
+static int64_t replica_read_clock() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return int64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+static memcached_replica_load_st *replica_load_create(uint32_t servers) {
+  size_t size = sizeof(memcached_replica_load_st)
+      + (servers ? servers - 1 : 0) * sizeof(memcached_replica_load_st::server_load);
+  // shared by clones which may outlive the handle, so not with its allocators
+  memcached_replica_load_st *load = static_cast<memcached_replica_load_st *>(malloc(size));
+  if (load == NULL) {
+    return NULL;
+  }
+
+  new (&load->references) std::atomic<uint32_t>(1);
+  load->servers = servers;
+  for (uint32_t x = 0; x < servers; ++x) {
+    new (&load->server[x].in_flight) std::atomic<uint32_t>(0);
+    new (&load->server[x].latency) std::atomic<uint32_t>(0);
+  }
+  return load;
+}
+
+memcached_replica_load_st *memcached_replica_load_share(memcached_replica_load_st *load) {
+  if (load) {
+    load->references.fetch_add(1, std::memory_order_relaxed);
+  }
+  return load;
+}
+
+void memcached_replica_load_release(memcached_replica_load_st *load) {
+  if (load and load->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    free(load);
+  }
+}
+
+memcached_return_t memcached_set_replica_reads(memcached_st *shell, bool enable) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  if (enable and extension->replica_read.load == NULL) {
+    extension->replica_read.load = replica_load_create(memcached_server_count(ptr));
+    if (extension->replica_read.load == NULL) {
+      return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+  } else if (not enable) {
+    memcached_replica_read_done(ptr);
+    memcached_replica_load_release(extension->replica_read.load);
+    extension->replica_read.load = NULL;
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+bool memcached_get_replica_reads(const memcached_st *shell) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      return extension->replica_read.load;
+    }
+  }
+
+  return false;
+}
+
+void memcached_replica_read_stat(const memcached_st *shell,
+                                 struct memcached_replica_read_stat_st *stat) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      stat->reads = extension->replica_read.reads;
+      stat->replica_reads = extension->replica_read.replica_reads;
+    }
+  }
+}
+
+/* Servers added after replica reads were enabled count as idle */
+static uint64_t replica_read_cost(const memcached_replica_load_st *load, uint32_t server) {
+  if (server >= load->servers) {
+    return 1;
+  }
+  uint64_t in_flight = load->server[server].in_flight.load(std::memory_order_relaxed);
+  uint64_t latency = load->server[server].latency.load(std::memory_order_relaxed);
+  return (in_flight + 1) * (latency ? latency : 1);
+}
+
+uint32_t memcached_replica_read_pick(Memcached *ptr, uint32_t server_key) {
+  memcached_extension_st *extension = memcached_extension(ptr);
+  uint32_t servers = memcached_server_count(ptr);
+  uint32_t copies = std::min(ptr->number_of_replicas + 1, servers);
+
+  extension->replica_read.reads++;
+  if (copies < 2) {
+    return 0;
+  }
+
+  if (extension->replica_read.rng == 0) {
+    extension->replica_read.rng = memcached_prng_seed(extension);
+  }
+
+  // power of two choices among the copies, ties go to the copy closer to the primary
+  uint32_t a = memcached_prng_next(extension->replica_read.rng) % copies;
+  uint32_t b = memcached_prng_next(extension->replica_read.rng) % (copies - 1);
+  if (b >= a) {
+    b++;
+  }
+  if (b < a) {
+    std::swap(a, b);
+  }
+
+  const memcached_replica_load_st *load = extension->replica_read.load;
+  uint32_t pick = replica_read_cost(load, (server_key + b) % servers)
+          < replica_read_cost(load, (server_key + a) % servers)
+      ? b
+      : a;
+
+  if (pick) {
+    extension->replica_read.replica_reads++;
+  }
+  return pick;
+}
+
+void memcached_replica_read_start(Memcached *ptr, uint32_t server) {
+  memcached_extension_st *extension = memcached_extension(ptr);
+  memcached_replica_load_st *load = extension->replica_read.load;
+
+  memcached_replica_read_done(ptr);
+  if (server < load->servers) {
+    load->server[server].in_flight.fetch_add(1, std::memory_order_relaxed);
+    extension->replica_read.server = server;
+    extension->replica_read.start = replica_read_clock();
+    extension->replica_read.pending = true;
+  }
+}
+
+void memcached_replica_read_done(Memcached *ptr) {
+  memcached_extension_st *extension = memcached_extension(ptr);
+  if (extension == NULL or extension->replica_read.pending == false) {
+    return;
+  }
+  extension->replica_read.pending = false;
+
+  memcached_replica_load_st::server_load &server =
+      extension->replica_read.load->server[extension->replica_read.server];
+  server.in_flight.fetch_sub(1, std::memory_order_relaxed);
+
+  int64_t sample = (replica_read_clock() - extension->replica_read.start)
+      << REPLICA_READ_LATENCY_SHIFT;
+  int64_t latency = server.latency.load(std::memory_order_relaxed);
+  latency = latency ? latency + ((sample - latency) >> REPLICA_READ_EWMA_SHIFT) : sample;
+  server.latency.store(uint32_t(std::min<int64_t>(std::max<int64_t>(latency, 1), UINT32_MAX)),
+                       std::memory_order_relaxed);
+}
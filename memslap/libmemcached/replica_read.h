@@ -0,0 +1,50 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+ * Least-loaded replica reads.
+ *
+ * With replica reads enabled, gets on a handle that keeps replicas (binary
+ * protocol with MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS) no longer go to the
+ * primary first. Of two random copies among the primary and its replicas,
+ * the one with the lower (gets in flight + 1) x recent latency is read
+ * first, the others only on failure. Clones share these figures, so the
+ * gets in flight are those of all threads working on clones of one handle.
+ */
+
+struct memcached_replica_read_stat_st {
+  uint64_t reads;         /* gets which picked a copy */
+  uint64_t replica_reads; /* gets which picked a replica over the primary */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LIBMEMCACHED_API
+memcached_return_t memcached_set_replica_reads(memcached_st *ptr, bool enable);
+
+LIBMEMCACHED_API
+bool memcached_get_replica_reads(const memcached_st *ptr);
+
+LIBMEMCACHED_API
+void memcached_replica_read_stat(const memcached_st *ptr,
+                                 struct memcached_replica_read_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
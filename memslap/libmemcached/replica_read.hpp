@@ -0,0 +1,37 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+static inline bool memcached_is_replica_reading(const Memcached *ptr) {
+  if (ptr->number_of_replicas and memcached_is_binary(ptr) and memcached_is_udp(ptr) == false) {
+    const memcached_extension_st *extension = memcached_extension(ptr);
+    return extension and extension->replica_read.load;
+  }
+  return false;
+}
+
+/* Copy to read a key on server_key from first: 0 for the primary, n for its n-th replica */
+uint32_t memcached_replica_read_pick(Memcached *ptr, uint32_t server_key);
+
+/* A single get was sent to server */
+void memcached_replica_read_start(Memcached *ptr, uint32_t server);
+
+/* Its answer arrived, or it failed */
+void memcached_replica_read_done(Memcached *ptr);
+
+/* Clones share the load of the servers */
+struct memcached_replica_load_st *memcached_replica_load_share(struct memcached_replica_load_st *load);
+void memcached_replica_load_release(struct memcached_replica_load_st *load);
@@ -16,98 +16,102 @@
 #include "libmemcached/common.h"
 #include "libmemcached/string.hpp"
 
-static memcached_return_t textual_value_fetch(memcached_instance_st *instance, char *buffer,
-                                              memcached_result_st *result) {
-  char *next_ptr;
-  ssize_t read_length = 0;
-  size_t value_length;
-
-  WATCHPOINT_ASSERT(instance->root);
-  char *end_ptr = buffer + MEMCACHED_DEFAULT_COMMAND_SIZE;
-
-  memcached_result_reset(result);
-
-  char *string_ptr = buffer;
-  string_ptr += 6; /* "VALUE " */
+/*
+  Hands a value to the destination of memcached_get_into() or
+  memcached_get_view() instead of reading it into the result, trailing is
+  the "\r\n" after a text value. Returns false if the value has to go into
+  the result after all.
+*/
+static bool sink_value(memcached_instance_st *instance, memcached_result_st *result,
+                       size_t value_length, size_t trailing, memcached_return_t &rc) {
+  memcached_extension_st *extension = memcached_extension(instance->root);
+  if (extension == NULL or extension->sink.active == false) {
+    return false;
+  }
 
-  // Just used for cases of AES decrypt currently
-  memcached_return_t rc = MEMCACHED_SUCCESS;
+  if (extension->sink.callback) {
+    // a view into the read buffer, if the value arrived in one piece
+    if (instance->read_buffer_length < value_length + trailing) {
+      return false;
+    }
 
-  /* We load the key */
-  {
-    char *key = result->item_key;
-    result->key_length = 0;
+    memcached_value_view_st view = {result->item_key, result->key_length, instance->read_ptr,
+                                    value_length, result->item_flags};
+    extension->sink.rc = extension->sink.callback(instance->root, &view, extension->sink.context);
+    instance->read_ptr += value_length + trailing;
+    instance->read_buffer_length -= value_length + trailing;
+  } else {
+    if (value_length > extension->sink.size) {
+      return false;
+    }
 
-    for (ptrdiff_t prefix_length = memcached_array_size(instance->root->_namespace);
-         !(iscntrl(*string_ptr) || isspace(*string_ptr)); string_ptr++)
+    char crlf[2];
+    if (memcached_failed(rc = memcached_safe_read(instance, extension->sink.buffer, value_length))
+        or memcached_failed(rc = memcached_safe_read(instance, crlf, trailing)))
     {
-      if (prefix_length == 0) {
-        *key = *string_ptr;
-        key++;
-        result->key_length++;
-      } else
-        prefix_length--;
+      return true;
     }
-    result->item_key[result->key_length] = 0;
-  }
-
-  if (end_ptr == string_ptr) {
-    goto read_error;
-  }
-
-  /* Flags fetch move past space */
-  string_ptr++;
-  if (end_ptr == string_ptr) {
-    goto read_error;
   }
 
-  for (next_ptr = string_ptr; isdigit(*string_ptr); string_ptr++) {
-  };
-  errno = 0;
-  result->item_flags = (uint32_t) strtoul(next_ptr, &string_ptr, 10);
+  extension->sink.length = value_length;
+  extension->sink.delivered = true;
+  rc = MEMCACHED_SUCCESS;
+  return true;
+}
 
-  if (errno or end_ptr == string_ptr) {
-    goto read_error;
+/* Loads the key of a value header into the result, without the namespace */
+static bool textual_value_key(memcached_instance_st *instance, memcached_result_st *result,
+                              const memcached_value_header_st &header) {
+  size_t prefix_length = memcached_array_size(instance->root->_namespace);
+  if (prefix_length > header.key_length) {
+    prefix_length = header.key_length;
   }
-
-  /* Length fetch move past space*/
-  string_ptr++;
-  if (end_ptr == string_ptr) {
-    goto read_error;
+  result->key_length = header.key_length - prefix_length;
+  if (result->key_length >= MEMCACHED_MAX_KEY) {
+    return false;
   }
+  memcpy(result->item_key, header.key + prefix_length, result->key_length);
+  result->item_key[result->key_length] = 0;
 
-  for (next_ptr = string_ptr; isdigit(*string_ptr); string_ptr++) {
-  };
-  errno = 0;
-  value_length = (size_t) strtoull(next_ptr, &string_ptr, 10);
+  return true;
+}
 
-  if (errno or end_ptr == string_ptr) {
-    goto read_error;
-  }
+/* Reads the value after a header line, and its "\r\n", into the result */
+static memcached_return_t textual_value_read(memcached_instance_st *instance,
+                                             memcached_result_st *result, size_t value_length) {
+  ssize_t read_length = 0;
+  bool compressed;
+  char *value_ptr;
 
-  /* Skip spaces */
-  if (*string_ptr == '\r') {
-    /* Skip past the \r\n */
-    string_ptr += 2;
-  } else {
-    string_ptr++;
-    for (next_ptr = string_ptr; isdigit(*string_ptr); string_ptr++) {
-    };
-    errno = 0;
-    result->item_cas = strtoull(next_ptr, &string_ptr, 10);
-  }
+  // Just used for cases of AES decrypt currently
+  memcached_return_t rc = MEMCACHED_SUCCESS;
 
-  if (errno or end_ptr < string_ptr) {
-    goto read_error;
+  /*
+    Compressed values are read aside and inflated straight into the result,
+    unless they still have to be decrypted.
+  */
+  compressed = memcached_is_compressed(instance->root, result->item_flags)
+      and memcached_is_encrypted(instance->root) == false;
+  if (memcached_is_encrypted(instance->root) == false
+      and memcached_is_compressed(instance->root, result->item_flags) == false
+      and sink_value(instance, result, value_length, 2, rc))
+  {
+    return rc;
   }
-
-  /* We add two bytes so that we can walk the \r\n */
-  if (memcached_failed(memcached_string_check(&result->value, value_length + 2))) {
-    return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  if (compressed) {
+    value_ptr = memcached_compression_buffer(instance->root, value_length + 2);
+    if (value_ptr == NULL) {
+      return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+  } else {
+    /* We add two bytes so that we can walk the \r\n */
+    if (memcached_failed(memcached_string_check(&result->value, value_length + 2))) {
+      return memcached_set_error(*instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+    value_ptr = memcached_string_value_mutable(&result->value);
   }
 
   {
-    char *value_ptr = memcached_string_value_mutable(&result->value);
     /*
       We read the \r\n into the string since not doing so is more
       cycles then the waster of memory to do so.
@@ -129,6 +133,13 @@ static memcached_return_t textual_value_fetch(memcached_instance_st *instance, c
     goto read_error;
   }
 
+  if (compressed) {
+    if (memcached_failed(rc = memcached_decompress(instance, value_ptr, value_length, result))) {
+      memcached_result_reset(result);
+    }
+    return rc;
+  }
+
   /* This next bit blows the API, but this is internal....*/
   {
     char *char_ptr;
@@ -148,6 +159,9 @@ static memcached_return_t textual_value_fetch(memcached_instance_st *instance, c
     {
       rc = memcached_set_error(*instance->root, MEMCACHED_FAILURE, MEMCACHED_AT,
                                memcached_literal_param("hashkit_decrypt() failed"));
+    } else if (memcached_is_compressed(instance->root, result->item_flags)) {
+      rc = memcached_decompress(instance, hashkit_string_c_str(destination),
+                                hashkit_string_length(destination), result);
     } else {
       memcached_result_reset_value(result);
       if (memcached_failed(memcached_result_set_value(result, hashkit_string_c_str(destination),
@@ -172,6 +186,136 @@ read_error:
   return MEMCACHED_PARTIAL_READ;
 }
 
+static memcached_return_t textual_value_fetch(memcached_instance_st *instance, char *buffer,
+                                              size_t line_length, memcached_result_st *result) {
+  memcached_value_header_st header;
+
+  WATCHPOINT_ASSERT(instance->root);
+
+  memcached_result_reset(result);
+
+  if (memcached_scan_value_header<true>(buffer, line_length, header) == false
+      or textual_value_key(instance, result, header) == false)
+  {
+    memcached_io_reset(instance);
+    return MEMCACHED_PARTIAL_READ;
+  }
+
+  result->item_flags = header.flags;
+  result->item_cas = header.cas;
+
+  return textual_value_read(instance, result, size_t(header.value_length));
+}
+
+/* A "VA" of the meta protocol: a hit of a get, or the value of an "ma" */
+static memcached_return_t meta_value_fetch(memcached_instance_st *instance, char *buffer,
+                                           size_t line_length, memcached_result_st *result) {
+  memcached_value_header_st header;
+
+  memcached_result_reset(result);
+
+  if (memcached_scan_meta_header<true>(buffer, line_length, header) == false
+      or (header.key and textual_value_key(instance, result, header) == false))
+  {
+    memcached_io_reset(instance);
+    return MEMCACHED_PARTIAL_READ;
+  }
+
+  if (header.key) {
+    /* We add back in one because we will need to search for MN */
+    memcached_server_response_increment(instance);
+    result->item_flags = header.flags;
+    result->item_cas = header.cas;
+    // as the storage commands take it: seconds up to 30 days, a unix time beyond
+    if (header.ttl > 60 * 60 * 24 * 30) {
+      result->item_expiration = time(NULL) + time_t(header.ttl);
+    } else if (header.ttl >= 0) {
+      result->item_expiration = header.ttl ? time_t(header.ttl) : 1;
+    }
+    return textual_value_read(instance, result, size_t(header.value_length));
+  }
+
+  char number[MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH + 2];
+  if (header.value_length > MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH) {
+    memcached_io_reset(instance);
+    return MEMCACHED_PARTIAL_READ;
+  }
+  size_t number_length = size_t(header.value_length);
+  memcached_return_t rc = memcached_safe_read(instance, number, number_length + 2);
+  if (memcached_failed(rc)) {
+    return rc;
+  }
+
+  const char *ptr = number;
+  if (memcached_scan_uint<true>(ptr, number + number_length, result->numeric_value) == false
+      or ptr != number + number_length)
+  {
+    result->numeric_value = UINT64_MAX;
+    return memcached_set_error(*instance, MEMCACHED_UNKNOWN_READ_FAILURE, MEMCACHED_AT,
+                               memcached_literal_param("Numeric response was out of range"));
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+/*
+  Status lines of the meta protocol. Returns false for anything else, such as
+  the errors the meta commands share with the text protocol.
+*/
+static bool meta_read_one_response(memcached_instance_st *instance, char *buffer,
+                                   size_t total_read, memcached_result_st *result,
+                                   memcached_return_t &rc) {
+  switch (buffer[0]) {
+  case 'V':
+    if (buffer[1] == 'A') {
+      rc = meta_value_fetch(instance, buffer, total_read, result);
+      return true;
+    }
+    break;
+
+  case 'H':
+    if (buffer[1] == 'D') {
+      rc = MEMCACHED_SUCCESS;
+      return true;
+    }
+    break;
+
+  case 'E':
+    if (buffer[1] == 'N') {
+      rc = MEMCACHED_NOTFOUND;
+      return true;
+    }
+    if (buffer[1] == 'X') {
+      rc = MEMCACHED_DATA_EXISTS;
+      return true;
+    }
+    break;
+
+  case 'N':
+    if (buffer[1] == 'F') {
+      rc = MEMCACHED_NOTFOUND;
+      return true;
+    }
+    if (buffer[1] == 'S') {
+      rc = MEMCACHED_NOTSTORED;
+      return true;
+    }
+    break;
+
+  case 'M':
+    if (buffer[1] == 'N') {
+      rc = MEMCACHED_END;
+      return true;
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return false;
+}
+
 static memcached_return_t textual_read_one_response(memcached_instance_st *instance, char *buffer,
                                                     const size_t buffer_length,
                                                     memcached_result_st *result) {
@@ -183,6 +327,14 @@ static memcached_return_t textual_read_one_response(memcached_instance_st *insta
   }
   assert(total_read);
 
+  if (memcached_is_meta(instance->root) and total_read >= 4
+      and (buffer[2] == ' ' or buffer[2] == '\r'))
+  {
+    if (meta_read_one_response(instance, buffer, total_read, result, rc)) {
+      return rc;
+    }
+  }
+
   switch (buffer[0]) {
   case 'V': {
     // VALUE
@@ -190,7 +342,7 @@ static memcached_return_t textual_read_one_response(memcached_instance_st *insta
     {
       /* We add back in one because we will need to search for END */
       memcached_server_response_increment(instance);
-      return textual_value_fetch(instance, buffer, result);
+      return textual_value_fetch(instance, buffer, total_read, result);
     }
     // VERSION
     else if (buffer[1] == 'E' and buffer[2] == 'R' and buffer[3] == 'S' and buffer[4] == 'I'
@@ -514,6 +666,31 @@ static memcached_return_t binary_read_one_response(memcached_instance_st *instan
       }
 
       bodylen -= keylen;
+      if (memcached_is_compressed(instance->root, result->item_flags)) {
+        char *cptr = memcached_compression_buffer(instance->root, bodylen);
+        if (cptr == NULL) {
+          return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+        }
+
+        if (memcached_failed(rc = memcached_safe_read(instance, cptr, bodylen))) {
+          WATCHPOINT_ERROR(rc);
+          return MEMCACHED_UNKNOWN_READ_FAILURE;
+        }
+
+        if (memcached_failed(rc = memcached_decompress(instance, cptr, bodylen, result))) {
+          return rc;
+        }
+        break;
+      }
+
+      if (sink_value(instance, result, bodylen, 0, rc)) {
+        if (memcached_failed(rc)) {
+          WATCHPOINT_ERROR(rc);
+          return MEMCACHED_UNKNOWN_READ_FAILURE;
+        }
+        break;
+      }
+
       if (memcached_failed(memcached_string_check(&result->value, bodylen))) {
         return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
       }
@@ -772,10 +949,6 @@ memcached_return_t memcached_read_one_response(memcached_instance_st *instance,
                                                memcached_result_st *result) {
   char buffer[SMALL_STRING_LEN];
 
-  if (memcached_is_udp(instance->root)) {
-    return memcached_set_error(*instance, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT);
-  }
-
   return _read_one_response(instance, buffer, sizeof(buffer), result);
 }
 
@@ -788,12 +961,9 @@ memcached_return_t memcached_response(memcached_instance_st *instance,
 
 memcached_return_t memcached_response(memcached_instance_st *instance, char *buffer,
                                       size_t buffer_length, memcached_result_st *result) {
-  if (memcached_is_udp(instance->root)) {
-    return memcached_set_error(*instance, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT);
-  }
-
   /* We may have old commands in the buffer not sent, first purge */
-  if ((instance->root->flags.no_block) and (memcached_is_processing_input(instance->root) == false))
+  if ((instance->root->flags.no_block) and (memcached_is_processing_input(instance->root) == false)
+      and memcached_is_udp(instance->root) == false)
   {
     (void) memcached_io_write(instance);
   }
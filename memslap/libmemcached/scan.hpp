@@ -0,0 +1,321 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+  Scanning of text protocol responses.
+
+  Delimiters are searched 16 bytes at a time with SSE2, and numbers are parsed
+  8 digits at a time within a 64 bit word (SWAR) on little endian machines.
+  Response lines are too short for wider vectors to pay off. Each function has
+  a scalar counterpart, which is used for the tail and on other targets,
+  selected by the vector template argument.
+*/
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define MEMCACHED_SCAN_SWAR 1
+#else
+#  define MEMCACHED_SCAN_SWAR 0
+#endif
+
+/* A "VALUE <key> <flags> <bytes> [<cas>]\r\n" line, or a meta protocol line */
+struct memcached_value_header_st {
+  const char *key;
+  size_t key_length;
+  uint32_t flags;
+  uint64_t value_length;
+  uint64_t cas; // 0 if the line has none
+  const char *opaque; // O flag of the meta protocol, NULL if the line has none
+  size_t opaque_length;
+  int64_t ttl; // t flag of the meta protocol in seconds, -1 if unlimited or the line has none
+};
+
+/* Ends a key: control characters and space */
+static inline bool memcached_scan_is_delimiter(unsigned char c) {
+  return c <= ' ' or c == 0x7f;
+}
+
+/* The first c in [begin, end), or end */
+template <bool vector>
+static inline const char *memcached_scan_byte(const char *begin, const char *end, char c) {
+  const char *ptr = begin;
+  if (vector) {
+#if defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(c);
+    for (; end - ptr >= 16; ptr += 16) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+      if (uint32_t mask = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)))) {
+        return ptr + __builtin_ctz(mask);
+      }
+    }
+#endif
+  }
+
+  for (; ptr < end; ptr++) {
+    if (*ptr == c) {
+      return ptr;
+    }
+  }
+  return end;
+}
+
+/* The first delimiter in [begin, end), or end */
+template <bool vector>
+static inline const char *memcached_scan_delimiter(const char *begin, const char *end) {
+  const char *ptr = begin;
+  if (vector) {
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i del = _mm_set1_epi8(0x7f);
+    for (; end - ptr >= 16; ptr += 16) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+      // unsigned chunk <= ' ' where the minimum of both is the chunk
+      __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(chunk, space), chunk),
+                                 _mm_cmpeq_epi8(chunk, del));
+      if (uint32_t mask = uint32_t(_mm_movemask_epi8(hit))) {
+        return ptr + __builtin_ctz(mask);
+      }
+    }
+#endif
+  }
+
+  for (; ptr < end; ptr++) {
+    if (memcached_scan_is_delimiter((unsigned char) *ptr)) {
+      return ptr;
+    }
+  }
+  return end;
+}
+
+/* The value of the n leading digits of chunk, the first digit in its lowest byte */
+static inline uint64_t memcached_swar_digits(uint64_t chunk, size_t n) {
+  uint64_t value = chunk - 0x3030303030303030ull;
+  if (n < 8) {
+    // drops the bytes after the digits, and shifts in leading zeros
+    value <<= 8 * (8 - n);
+  }
+  value = (value * 10) + (value >> 8);
+  return (((value & 0x000000FF000000FFull) * (100 + (1000000ull << 32)))
+          + (((value >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32))))
+      >> 32;
+}
+
+/*
+  Parses the decimal number at ptr and moves ptr past it. Fails without
+  digits, or if the number does not fit 64 bits.
+*/
+template <bool vector>
+static inline bool memcached_scan_uint(const char *&ptr, const char *end, uint64_t &value) {
+  static const uint64_t power[] = {1,      10,      100,      1000,     10000,
+                                   100000, 1000000, 10000000, 100000000};
+  const char *cursor = ptr;
+  uint64_t result = 0;
+  size_t digits = 0;
+
+  if (vector and MEMCACHED_SCAN_SWAR) {
+    while (end - cursor >= 8) {
+      uint64_t chunk;
+      memcpy(&chunk, cursor, sizeof(chunk));
+      // the top bit of every byte below '0' or above '9', exact up to the first of them
+      uint64_t other = ((chunk + 0x4646464646464646ull) | (chunk - 0x3030303030303030ull))
+          & 0x8080808080808080ull;
+      size_t n = other ? size_t(__builtin_ctzll(other)) / 8 : 8;
+      if (n == 0) {
+        break;
+      }
+
+      uint64_t part = memcached_swar_digits(chunk, n);
+      digits += n;
+      if (digits > 19 and result > (UINT64_MAX - part) / power[n]) {
+        return false;
+      }
+      result = result * power[n] + part;
+      cursor += n;
+      if (n < 8) {
+        break;
+      }
+    }
+  }
+
+  for (; cursor < end and *cursor >= '0' and *cursor <= '9'; cursor++) {
+    uint64_t digit = uint64_t(*cursor - '0');
+    if (result > (UINT64_MAX - digit) / 10) {
+      return false;
+    }
+    result = result * 10 + digit;
+    digits++;
+  }
+
+  if (digits == 0) {
+    return false;
+  }
+
+  ptr = cursor;
+  value = result;
+  return true;
+}
+
+/* Parses a whole header line, "\r\n" included */
+template <bool vector>
+static inline bool memcached_scan_value_header(const char *line, size_t length,
+                                               memcached_value_header_st &header) {
+  const char *end = line + length;
+  if (length < 6 or memcmp(line, "VALUE ", 6)) {
+    return false;
+  }
+
+  const char *ptr = line + 6;
+  const char *key_end = memcached_scan_delimiter<vector>(ptr, end);
+  if (key_end == ptr or key_end == end or *key_end != ' ') {
+    return false;
+  }
+  header.key = ptr;
+  header.key_length = size_t(key_end - ptr);
+  ptr = key_end + 1;
+
+  uint64_t flags;
+  if (not memcached_scan_uint<vector>(ptr, end, flags) or flags > UINT32_MAX or ptr == end
+      or *ptr != ' ')
+  {
+    return false;
+  }
+  header.flags = uint32_t(flags);
+  ptr++;
+
+  if (not memcached_scan_uint<vector>(ptr, end, header.value_length) or ptr == end) {
+    return false;
+  }
+
+  header.opaque = NULL;
+  header.opaque_length = 0;
+  header.cas = 0;
+  if (*ptr == ' ') {
+    ptr++;
+    if (not memcached_scan_uint<vector>(ptr, end, header.cas)) {
+      return false;
+    }
+  }
+
+  return end - ptr == 2 and ptr[0] == '\r' and ptr[1] == '\n';
+}
+
+/*
+  Parses the flags of a meta protocol line up to its "\r\n": f, c, k and O
+  fill the header, others are skipped. header.key and header.opaque are NULL
+  without their flag.
+*/
+template <bool vector>
+static inline bool memcached_scan_meta_flags(const char *ptr, const char *end,
+                                             memcached_value_header_st &header) {
+  header.key = NULL;
+  header.key_length = 0;
+  header.flags = 0;
+  header.cas = 0;
+  header.opaque = NULL;
+  header.opaque_length = 0;
+  header.ttl = -1;
+  while (ptr != end and *ptr == ' ') {
+    ptr++;
+    const char *token_end = memcached_scan_delimiter<vector>(ptr, end);
+    if (token_end == ptr or token_end == end) {
+      return false;
+    }
+
+    const char *value = ptr + 1;
+    uint64_t number;
+    switch (*ptr) {
+    case 'f':
+      if (not memcached_scan_uint<vector>(value, token_end, number) or value != token_end
+          or number > UINT32_MAX)
+      {
+        return false;
+      }
+      header.flags = uint32_t(number);
+      break;
+
+    case 'c':
+      if (not memcached_scan_uint<vector>(value, token_end, header.cas) or value != token_end) {
+        return false;
+      }
+      break;
+
+    case 't':
+      if (token_end - value == 2 and value[0] == '-' and value[1] == '1') {
+        break;
+      }
+      if (not memcached_scan_uint<vector>(value, token_end, number) or value != token_end
+          or number > INT64_MAX)
+      {
+        return false;
+      }
+      header.ttl = int64_t(number);
+      break;
+
+    case 'k':
+    case 'O':
+      if (value == token_end) {
+        return false;
+      }
+      if (*ptr == 'k') {
+        header.key = value;
+        header.key_length = size_t(token_end - value);
+      } else {
+        header.opaque = value;
+        header.opaque_length = size_t(token_end - value);
+      }
+      break;
+
+    default:
+      break;
+    }
+    ptr = token_end;
+  }
+
+  return end - ptr == 2 and ptr[0] == '\r' and ptr[1] == '\n';
+}
+
+/* Parses a "VA <length> <flags>*\r\n" line of the meta protocol */
+template <bool vector>
+static inline bool memcached_scan_meta_header(const char *line, size_t length,
+                                              memcached_value_header_st &header) {
+  const char *end = line + length;
+  if (length < 3 or memcmp(line, "VA ", 3)) {
+    return false;
+  }
+
+  const char *ptr = line + 3;
+  if (not memcached_scan_uint<vector>(ptr, end, header.value_length)) {
+    return false;
+  }
+
+  return memcached_scan_meta_flags<vector>(ptr, end, header);
+}
+
+/* Parses the flags of a meta status line such as "HD O12\r\n", value_length is 0 */
+template <bool vector>
+static inline bool memcached_scan_meta_status(const char *line, size_t length,
+                                              memcached_value_header_st &header) {
+  if (length < 4) {
+    return false;
+  }
+
+  header.value_length = 0;
+  return memcached_scan_meta_flags<vector>(line + 2, line + length, header);
+}
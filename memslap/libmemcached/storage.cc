@@ -158,7 +158,8 @@ static memcached_return_t memcached_send_binary(Memcached *ptr, memcached_instan
 
       memcached_instance_st *instance = memcached_instance_fetch(ptr, server_key);
 
-      if (memcached_success(memcached_vdo(instance, vector, 5, false))) {
+      // quiet sets, sent along with the primary's so replica reads find them
+      if (memcached_success(memcached_vdo(instance, vector, 5, flush))) {
         memcached_server_response_decrement(instance);
       }
     }
@@ -265,6 +266,87 @@ memcached_send_ascii(Memcached *ptr, memcached_instance_st *instance, const char
   return rc;
 }
 
+/* The mode flag of an "ms", a set by default */
+static inline const char *storage_op_meta_mode(memcached_storage_action_t verb) {
+  switch (verb) {
+  case REPLACE_OP:
+    return " MR";
+
+  case ADD_OP:
+    return " ME";
+
+  case PREPEND_OP:
+    return " MP";
+
+  case APPEND_OP:
+    return " MA";
+
+  case SET_OP:
+  case CAS_OP:
+    break;
+  }
+
+  return "";
+}
+
+/*
+  "ms <key> <length> F<flags> T<expiration> [C<cas>] [M<mode>]", see meta.h.
+  Without reply the status is left for the next command to purge.
+*/
+static memcached_return_t
+memcached_send_meta(Memcached *ptr, memcached_instance_st *instance, const char *key,
+                    const size_t key_length, const char *value, const size_t value_length,
+                    const time_t expiration, const uint32_t flags, const uint64_t cas,
+                    const bool flush, const bool reply, const memcached_storage_action_t verb) {
+  char header_buffer[4 * (MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH + 3) + 4];
+  int header_buffer_length =
+      snprintf(header_buffer, sizeof(header_buffer), " %llu F%u T%lld",
+               (unsigned long long) value_length, flags, (long long) expiration);
+  if (cas and header_buffer_length >= 0 and size_t(header_buffer_length) < sizeof(header_buffer)) {
+    int cas_length = snprintf(header_buffer + header_buffer_length,
+                              sizeof(header_buffer) - size_t(header_buffer_length), " C%llu",
+                              (unsigned long long) cas);
+    header_buffer_length = cas_length < 0 ? cas_length : header_buffer_length + cas_length;
+  }
+  if (size_t(header_buffer_length) >= sizeof(header_buffer) or header_buffer_length < 0) {
+    return memcached_set_error(
+        *instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT,
+        memcached_literal_param("snprintf(MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH)"));
+  }
+
+  const char *mode = storage_op_meta_mode(verb);
+  libmemcached_io_vector_st vector[] = {
+      {NULL, 0},
+      {memcached_literal_param("ms ")},
+      {memcached_array_string(ptr->_namespace), memcached_array_size(ptr->_namespace)},
+      {key, key_length},
+      {header_buffer, size_t(header_buffer_length)},
+      {mode, strlen(mode)},
+      {memcached_literal_param("\r\n")},
+      {value, value_length},
+      {memcached_literal_param("\r\n")}};
+
+  memcached_return_t rc = memcached_vdo(instance, vector, 9, flush);
+  if (memcached_success(rc)) {
+    memcached_meta_expect_reply(instance);
+  }
+
+  if (reply == false) {
+    return memcached_success(rc) ? MEMCACHED_SUCCESS : rc;
+  }
+
+  if (flush == false) {
+    return memcached_success(rc) ? MEMCACHED_BUFFERED : rc;
+  }
+
+  if (rc == MEMCACHED_SUCCESS) {
+    char buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
+    rc = memcached_response(instance, buffer, sizeof(buffer), NULL);
+  }
+
+  return rc;
+}
+
 static inline memcached_return_t
 memcached_send(memcached_st *shell, const char *group_key, size_t group_key_length, const char *key,
                size_t key_length, const char *value, size_t value_length, const time_t expiration,
@@ -293,6 +375,14 @@ memcached_send(memcached_st *shell, const char *group_key, size_t group_key_leng
 
   bool reply = memcached_is_replying(ptr);
 
+  // append and prepend splice raw bytes, so they are left alone like with encryption
+  uint32_t item_flags = flags;
+  if (can_be_encrypted(verb)) {
+    if (memcached_failed(rc = memcached_compress(ptr, value, value_length, item_flags))) {
+      return rc;
+    }
+  }
+
   hashkit_string_st *destination = NULL;
 
   if (memcached_is_encrypted(ptr)) {
@@ -311,10 +401,13 @@ memcached_send(memcached_st *shell, const char *group_key, size_t group_key_leng
 
   if (memcached_is_binary(ptr)) {
     rc = memcached_send_binary(ptr, instance, server_key, key, key_length, value, value_length,
-                               expiration, flags, cas, flush, reply, verb);
+                               expiration, item_flags, cas, flush, reply, verb);
+  } else if (memcached_is_meta(ptr)) {
+    rc = memcached_send_meta(ptr, instance, key, key_length, value, value_length, expiration,
+                             item_flags, cas, flush, reply, verb);
   } else {
     rc = memcached_send_ascii(ptr, instance, key, key_length, value, value_length, expiration,
-                              flags, cas, flush, reply, verb);
+                              item_flags, cas, flush, reply, verb);
   }
 
   hashkit_string_free(destination);
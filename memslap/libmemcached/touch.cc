@@ -44,6 +44,37 @@ static memcached_return_t ascii_touch(memcached_instance_st *instance, const cha
   return rc;
 }
 
+/* "mg <key> T<expiration>", which answers HD or EN without a value */
+static memcached_return_t meta_touch(memcached_instance_st *instance, const char *key,
+                                     size_t key_length, time_t expiration) {
+  char expiration_buffer[MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH + 2 + 1];
+  int expiration_buffer_length = snprintf(expiration_buffer, sizeof(expiration_buffer), " T%lld",
+                                          (long long) expiration);
+  if (size_t(expiration_buffer_length) >= sizeof(expiration_buffer)
+      or expiration_buffer_length < 0)
+  {
+    return memcached_set_error(
+        *instance, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT,
+        memcached_literal_param("snprintf(MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH)"));
+  }
+
+  libmemcached_io_vector_st vector[] = {{NULL, 0},
+                                        {memcached_literal_param("mg ")},
+                                        {memcached_array_string(instance->root->_namespace),
+                                         memcached_array_size(instance->root->_namespace)},
+                                        {key, key_length},
+                                        {expiration_buffer, size_t(expiration_buffer_length)},
+                                        {memcached_literal_param("\r\n")}};
+
+  memcached_return_t rc;
+  if (memcached_failed(rc = memcached_vdo(instance, vector, 6, true))) {
+    return memcached_set_error(*instance, MEMCACHED_WRITE_FAILURE, MEMCACHED_AT);
+  }
+  memcached_meta_expect_reply(instance);
+
+  return rc;
+}
+
 static memcached_return_t binary_touch(memcached_instance_st *instance, const char *key,
                                        size_t key_length, time_t expiration) {
   protocol_binary_request_touch request = {}; //{.bytes= {0}};
@@ -100,6 +131,8 @@ memcached_return_t memcached_touch_by_key(memcached_st *shell, const char *group
 
   if (ptr->flags.binary_protocol) {
     rc = binary_touch(instance, key, key_length, expiration);
+  } else if (memcached_is_meta(ptr)) {
+    rc = meta_touch(instance, key, key_length, expiration);
   } else {
     rc = ascii_touch(instance, key, key_length, expiration);
   }
@@ -14,6 +14,11 @@
 */
 
 #include "libmemcached/common.h"
+#include "p9y/poll.hpp"
+#include "p9y/clock_gettime.hpp"
+
+#include <algorithm>
+#include <vector>
 
 /*
  * The udp request id consists of two seperate sections
@@ -50,3 +55,467 @@ bool memcached_io_init_udp_header(memcached_instance_st *ptr, const uint16_t thr
 
   return MEMCACHED_SUCCESS;
 }
+
+/* A get datagram and the keys it asked for, at order[first, last) */
+struct udp_request {
+  memcached_instance_st *instance;
+  uint16_t request_id;
+  uint16_t datagrams; // of the response, 0 until its first one arrived
+  uint16_t received;
+  size_t part;        // its datagrams are parts[part + sequence], once datagrams is set
+  uint32_t first;
+  uint32_t last;
+  bool waiting; // sent, and its response is not complete yet
+  bool complete;
+};
+
+/* A response datagram, its payload at data[offset] */
+struct udp_part {
+  size_t offset;
+  size_t length; // UDP_PART_MISSING until the datagram arrived
+};
+
+#define UDP_PART_MISSING SIZE_MAX
+
+/*
+  The requests waiting for a response, open addressed by the low bits of
+  their ID. A slot holds the index of the request plus 1, 0 when free.
+*/
+static void udp_index_build(const std::vector<udp_request> &requests,
+                            std::vector<uint32_t> &slot) {
+  size_t size = 16;
+  while (size < 2 * requests.size()) {
+    size *= 2;
+  }
+  slot.assign(size, 0);
+
+  for (size_t x = 0; x < requests.size(); ++x) {
+    if (requests[x].waiting) {
+      size_t hash = requests[x].request_id & (size - 1);
+      while (slot[hash]) {
+        hash = (hash + 1) & (size - 1);
+      }
+      slot[hash] = uint32_t(x + 1);
+    }
+  }
+}
+
+/* The index of the request, requests.size() if none is waiting for it */
+static size_t udp_index_find(const std::vector<udp_request> &requests,
+                             const std::vector<uint32_t> &slot,
+                             const memcached_instance_st *instance, uint16_t request_id) {
+  size_t mask = slot.size() - 1;
+  for (size_t hash = request_id & mask; slot[hash]; hash = (hash + 1) & mask) {
+    const udp_request &request = requests[slot[hash] - 1];
+    if (request.instance == instance and request.request_id == request_id) {
+      return slot[hash] - 1;
+    }
+  }
+
+  return requests.size();
+}
+
+static int64_t udp_now() {
+  timespec tspec{};
+  clock_gettime(CLOCK_MONOTONIC, &tspec);
+  return int64_t(tspec.tv_sec) * 1000 + tspec.tv_nsec / 1000000; // ms
+}
+
+static bool udp_append(memcached_instance_st *instance, const char *data, size_t length) {
+  if (instance->udp.length + length > instance->udp.size) {
+    size_t size = std::max(instance->udp.size * 2, instance->udp.length + length);
+    char *message = libmemcached_xrealloc(instance->root, instance->udp.message, size, char);
+    if (message == NULL) {
+      return false;
+    }
+    instance->udp.message = message;
+    instance->udp.size = size;
+  }
+
+  memcpy(instance->udp.message + instance->udp.length, data, length);
+  instance->udp.length += length;
+  return true;
+}
+
+/*
+  Appends the values of a complete response without its "END\r\n", so that the
+  responses of a server read as one. Anything else counts as lost.
+*/
+static bool udp_complete(const std::vector<udp_part> &parts, const std::vector<char> &data,
+                         udp_request &request) {
+  memcached_instance_st *instance = request.instance;
+  size_t start = instance->udp.length;
+  for (uint16_t sequence = 0; sequence < request.datagrams; ++sequence) {
+    const udp_part &part = parts[request.part + sequence];
+    if (udp_append(instance, data.data() + part.offset, part.length) == false) {
+      instance->udp.length = start;
+      return false;
+    }
+  }
+
+  size_t length = instance->udp.length - start;
+  if (length < memcached_literal_param_size("END\r\n")
+      or memcmp(instance->udp.message + instance->udp.length - 5, memcached_literal_param("END\r\n")))
+  {
+    instance->udp.length = start;
+    return false;
+  }
+
+  instance->udp.length -= memcached_literal_param_size("END\r\n");
+  return true;
+}
+
+/* Takes the datagrams waiting on the socket of instance */
+static size_t udp_receive(memcached_instance_st *instance, std::vector<udp_request> &requests,
+                          const std::vector<uint32_t> &slot, std::vector<udp_part> &parts,
+                          std::vector<char> &data, memcached_extension_st *extension) {
+  char datagram[2 * MAX_UDP_DATAGRAM_LENGTH];
+  size_t completed = 0;
+  for (;;) {
+    memcached_io_count_recv(instance->root);
+    ssize_t length = ::recv(instance->fd, datagram, sizeof(datagram), MSG_DONTWAIT);
+    if (length < 0) {
+      if (get_socket_errno() == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (size_t(length) <= UDP_DATAGRAM_HEADER_LENGTH) {
+      continue;
+    }
+
+    const udp_datagram_header_st *header = (const udp_datagram_header_st *) datagram;
+    uint16_t request_id = get_udp_datagram_request_id(header);
+    uint16_t sequence = get_udp_datagram_seq_num(header);
+    uint16_t datagrams = get_udp_datagram_num_datagrams(header);
+
+    // late answers to earlier multi-gets are dropped here
+    size_t index = udp_index_find(requests, slot, instance, request_id);
+    if (index == requests.size() or requests[index].waiting == false or sequence >= datagrams) {
+      continue;
+    }
+
+    udp_request &request = requests[index];
+    if (request.datagrams == 0) {
+      request.datagrams = datagrams;
+      request.part = parts.size();
+      parts.resize(parts.size() + datagrams, udp_part{0, UDP_PART_MISSING});
+    }
+    if (request.datagrams != datagrams
+        or parts[request.part + sequence].length != UDP_PART_MISSING)
+    {
+      continue;
+    }
+
+    size_t payload = size_t(length) - UDP_DATAGRAM_HEADER_LENGTH;
+    parts[request.part + sequence] = udp_part{data.size(), payload};
+    data.insert(data.end(), datagram + UDP_DATAGRAM_HEADER_LENGTH, datagram + length);
+    extension->udp.datagrams_received++;
+
+    if (++request.received == request.datagrams) {
+      request.waiting = false;
+      request.complete = udp_complete(parts, data, request);
+      completed++;
+    }
+  }
+
+  return completed;
+}
+
+/* The clone of ptr over TCP */
+static memcached_st *udp_fallback(Memcached *ptr, memcached_extension_st *extension) {
+  if (extension->udp.fallback == NULL) {
+    memcached_st *fallback = memcached_clone(NULL, ptr);
+    if (fallback == NULL) {
+      return NULL;
+    }
+    (void) memcached_behavior_set(fallback, MEMCACHED_BEHAVIOR_USE_UDP, 0);
+    // its servers were set up for datagrams
+    memcached_quit(fallback);
+    extension->udp.fallback = fallback;
+  }
+
+  return extension->udp.fallback;
+}
+
+/* Fetches the keys of a lost request over TCP, and appends them like its response would be */
+static bool udp_refetch(Memcached *ptr, memcached_extension_st *extension, const char *group_key,
+                        size_t group_key_length, const char *const *keys,
+                        const size_t *key_length, const uint32_t *order,
+                        const udp_request &request) {
+  memcached_st *fallback = udp_fallback(ptr, extension);
+  if (fallback == NULL) {
+    return false;
+  }
+
+  std::vector<const char *> lost_keys;
+  std::vector<size_t> lost_length;
+  for (uint32_t y = request.first; y < request.last; ++y) {
+    lost_keys.push_back(keys[order[y]]);
+    lost_length.push_back(key_length[order[y]]);
+  }
+  extension->udp.fallback_keys += lost_keys.size();
+
+  if (memcached_failed(memcached_mget_by_key(fallback, group_key, group_key_length,
+                                             lost_keys.data(), lost_length.data(),
+                                             lost_keys.size())))
+  {
+    return false;
+  }
+
+  memcached_instance_st *instance = request.instance;
+  memcached_result_st result;
+  if (memcached_result_create(fallback, &result) == NULL) {
+    return false;
+  }
+
+  bool appended = true;
+  memcached_return_t rc;
+  while (memcached_fetch_result(fallback, &result, &rc)) {
+    char line[MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH * 3 + 8];
+    int length;
+    if (ptr->flags.support_cas) {
+      length = snprintf(line, sizeof(line), " %" PRIu32 " %llu %llu\r\n",
+                        memcached_result_flags(&result),
+                        (unsigned long long) memcached_result_length(&result),
+                        (unsigned long long) memcached_result_cas(&result));
+    } else {
+      length = snprintf(line, sizeof(line), " %" PRIu32 " %llu\r\n",
+                        memcached_result_flags(&result),
+                        (unsigned long long) memcached_result_length(&result));
+    }
+
+    appended = appended and udp_append(instance, memcached_literal_param("VALUE "))
+        and udp_append(instance, memcached_array_string(ptr->_namespace),
+                       memcached_array_size(ptr->_namespace))
+        and udp_append(instance, memcached_result_key_value(&result),
+                       memcached_result_key_length(&result))
+        and udp_append(instance, line, size_t(length))
+        and udp_append(instance, memcached_result_value(&result),
+                       memcached_result_length(&result))
+        and udp_append(instance, memcached_literal_param("\r\n"));
+  }
+  memcached_result_free(&result);
+
+  return appended;
+}
+
+memcached_return_t memcached_udp_mget(Memcached *ptr, const char *group_key,
+                                      size_t group_key_length, const char *const *keys,
+                                      const size_t *key_length, size_t number_of_keys) {
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  const char *get_command = ptr->flags.support_cas ? "gets" : "get";
+  size_t get_command_length = ptr->flags.support_cas ? 4 : 3;
+  size_t prefix_length = memcached_array_size(ptr->_namespace);
+
+  uint32_t server_count = memcached_server_count(ptr);
+  std::vector<uint32_t> server_key(number_of_keys);
+  std::vector<uint32_t> order(number_of_keys);
+  std::vector<uint32_t> first(server_count + 1);
+  if (group_key) {
+    uint32_t master_server_key =
+        memcached_generate_hash_with_redistribution(ptr, group_key, group_key_length);
+    std::fill(server_key.begin(), server_key.end(), master_server_key);
+  } else {
+    memcached_generate_hash_batch_with_redistribution(ptr, keys, key_length, number_of_keys,
+                                                      server_key.data());
+  }
+  memcached_group_by_server(server_key.data(), number_of_keys, server_count, first.data(),
+                            order.data());
+
+  // as many keys per datagram as fit, a request ID each
+  std::vector<udp_request> requests;
+  std::vector<libmemcached_io_vector_st> vector(3 * MAX_UDP_KEYS_PER_DATAGRAM + 3);
+  for (uint32_t s = 0; s < server_count; s++) {
+    if (first[s] == first[s + 1]) {
+      continue;
+    }
+
+    memcached_instance_st *instance = memcached_instance_fetch(ptr, s);
+    bool connected = memcached_success(memcached_connect(instance));
+    for (uint32_t y = first[s]; y < first[s + 1];) {
+      size_t count = 2;
+      size_t length = UDP_DATAGRAM_HEADER_LENGTH + get_command_length + 2;
+      vector[0] = {NULL, 0};
+      vector[1] = {get_command, get_command_length};
+
+      udp_request request = {instance, 0, 0, 0, 0, y, y, false, false};
+      while (y < first[s + 1] and y - request.first < MAX_UDP_KEYS_PER_DATAGRAM) {
+        size_t key_size = 1 + prefix_length + key_length[order[y]];
+        if (y > request.first and length + key_size > MAX_UDP_DATAGRAM_LENGTH) {
+          break;
+        }
+        vector[count++] = {" ", 1};
+        vector[count++] = {memcached_array_string(ptr->_namespace), prefix_length};
+        vector[count++] = {keys[order[y]], key_length[order[y]]};
+        length += key_size;
+        y++;
+      }
+      vector[count++] = {"\r\n", 2};
+      request.last = y;
+
+      // a server that cannot be written to is fetched over TCP
+      connected = connected and memcached_success(memcached_vdo(instance, vector.data(), count, false));
+      if (connected) {
+        request.request_id =
+            get_udp_datagram_request_id((udp_datagram_header_st *) instance->write_buffer);
+        request.waiting = true;
+        extension->udp.requests++;
+      }
+      requests.push_back(request);
+    }
+  }
+
+  // collect datagrams until all responses are complete or the timeout expires
+  uint32_t timeout = extension->udp.timeout ? extension->udp.timeout : MEMCACHED_UDP_TIMEOUT_DEFAULT;
+  int64_t deadline = udp_now() + timeout;
+  size_t waiting = 0;
+  for (const udp_request &request : requests) {
+    waiting += request.waiting;
+  }
+
+  std::vector<uint32_t> slot;
+  udp_index_build(requests, slot);
+  std::vector<udp_part> parts;
+  std::vector<char> data;
+  std::vector<struct pollfd> fds;
+  std::vector<memcached_instance_st *> polled;
+  while (waiting) {
+    int remaining = int(deadline - udp_now());
+    if (remaining <= 0) {
+      break;
+    }
+
+    fds.clear();
+    polled.clear();
+    for (const udp_request &request : requests) {
+      if (request.waiting and (polled.empty() or polled.back() != request.instance)) {
+        fds.push_back(pollfd{request.instance->fd, POLLIN, 0});
+        polled.push_back(request.instance);
+      }
+    }
+
+    memcached_epoll_count_poll(ptr);
+    int ready = poll(fds.data(), nfds_t(fds.size()), remaining);
+    if (ready == -1 and get_socket_errno() == EINTR) {
+      continue;
+    }
+    if (ready <= 0) {
+      break;
+    }
+
+    for (size_t x = 0; x < fds.size(); ++x) {
+      if (fds[x].revents) {
+        waiting -= udp_receive(polled[x], requests, slot, parts, data, extension);
+      }
+    }
+  }
+
+  // the rest over TCP, then one END per server
+  bool failures = false;
+  for (size_t x = 0; x < requests.size(); ++x) {
+    udp_request &request = requests[x];
+    if (request.complete == false) {
+      extension->udp.lost++;
+      if (udp_refetch(ptr, extension, group_key, group_key_length, keys, key_length,
+                      order.data(), request)
+          == false)
+      {
+        failures = true;
+      }
+    }
+
+    if (x + 1 == requests.size() or requests[x + 1].instance != request.instance) {
+      if (udp_append(request.instance, memcached_literal_param("END\r\n"))) {
+        memcached_instance_response_increment(request.instance);
+      } else {
+        failures = true;
+      }
+    }
+  }
+
+  if (failures) {
+    return memcached_set_error(*ptr, MEMCACHED_SOME_ERRORS, MEMCACHED_AT);
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_udp_fill(memcached_instance_st *instance) {
+  size_t remaining = instance->udp.length - instance->udp.offset;
+  if (remaining == 0) {
+    return memcached_set_error(
+        *instance, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT,
+        memcached_literal_param("Only get responses are read over UDP"));
+  }
+
+  size_t length = std::min(remaining, size_t(instance->buffer.read_size));
+  memcpy(instance->read_buffer, instance->udp.message + instance->udp.offset, length);
+  instance->read_buffer_length = length;
+  instance->read_ptr = instance->read_buffer;
+  instance->udp.offset += length;
+  if (instance->udp.offset == instance->udp.length) {
+    instance->udp.offset = 0;
+    instance->udp.length = 0;
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_udp_release(memcached_instance_st *instance) {
+  libmemcached_free(instance->root, instance->udp.message);
+  instance->udp.message = NULL;
+  instance->udp.length = 0;
+  instance->udp.offset = 0;
+  instance->udp.size = 0;
+}
+
+memcached_return_t memcached_set_udp_timeout(memcached_st *shell, uint32_t timeout) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  extension->udp.timeout = timeout;
+
+  return MEMCACHED_SUCCESS;
+}
+
+uint32_t memcached_get_udp_timeout(const memcached_st *shell) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      if (extension->udp.timeout) {
+        return extension->udp.timeout;
+      }
+    }
+  }
+
+  return MEMCACHED_UDP_TIMEOUT_DEFAULT;
+}
+
+void memcached_udp_stat(const memcached_st *shell, struct memcached_udp_stat_st *stat) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      stat->requests = extension->udp.requests;
+      stat->datagrams_received = extension->udp.datagrams_received;
+      stat->lost = extension->udp.lost;
+      stat->fallback_keys = extension->udp.fallback_keys;
+    }
+  }
+}
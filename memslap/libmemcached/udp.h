@@ -0,0 +1,54 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+/*
+  Gets and multi-gets over UDP (MEMCACHED_BEHAVIOR_USE_UDP, text protocol).
+
+  The keys of each server are packed into as few "get" datagrams as fit
+  MAX_UDP_DATAGRAM_LENGTH, and the datagrams of every response are put back
+  together by request ID and sequence number. Responses still incomplete when
+  the UDP timeout expires are fetched again over TCP, through a clone of the
+  handle without UDP made on the first loss. memcached_fetch_result() then
+  reads all of them as usual.
+*/
+
+/* Milliseconds to wait for the datagrams of a multi-get */
+#define MEMCACHED_UDP_TIMEOUT_DEFAULT 100
+
+struct memcached_udp_stat_st {
+  uint64_t requests;           /* get datagrams sent */
+  uint64_t datagrams_received; /* response datagrams accepted */
+  uint64_t lost;               /* requests whose response was incomplete at the timeout */
+  uint64_t fallback_keys;      /* keys fetched again over TCP */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LIBMEMCACHED_API
+memcached_return_t memcached_set_udp_timeout(memcached_st *ptr, uint32_t timeout);
+
+LIBMEMCACHED_API
+uint32_t memcached_get_udp_timeout(const memcached_st *ptr);
+
+LIBMEMCACHED_API
+void memcached_udp_stat(const memcached_st *ptr, struct memcached_udp_stat_st *stat);
+
+#ifdef __cplusplus
+}
+#endif
@@ -16,6 +16,7 @@
 #pragma once
 
 #define MAX_UDP_DATAGRAM_LENGTH           1400
+#define MAX_UDP_KEYS_PER_DATAGRAM         256 // three iovecs each, below IOV_MAX
 #define UDP_DATAGRAM_HEADER_LENGTH        8
 #define UDP_REQUEST_ID_MSG_SIG_DIGITS     10
 #define UDP_REQUEST_ID_THREAD_MASK        0xFFFF << UDP_REQUEST_ID_MSG_SIG_DIGITS
@@ -37,3 +38,13 @@ struct udp_datagram_header_st {
 
 bool memcached_io_init_udp_header(memcached_instance_st *, const uint16_t thread_id);
 void increment_udp_message_id(memcached_instance_st *);
+
+/* Sends the gets of a multi-get and collects their responses, see udp.h */
+memcached_return_t memcached_udp_mget(Memcached *ptr, const char *group_key,
+                                      size_t group_key_length, const char *const *keys,
+                                      const size_t *key_length, size_t number_of_keys);
+
+/* Moves the next part of the collected responses into the read buffer */
+memcached_return_t memcached_udp_fill(memcached_instance_st *instance);
+
+void memcached_udp_release(memcached_instance_st *instance);
@@ -16,16 +16,42 @@
 #include "libmemcached/common.h"
 #include "libmemcached/virtual_bucket.h"
 
-struct bucket_t {
-  uint32_t master;
-  uint32_t forward;
-};
+#include <atomic>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Keys fetched per mget while copying migrating buckets */
+#define BUCKET_COPY_BATCH 1000
+
+/* Bucket words: master in the low half, forward below MIGRATING in the high half */
+#define BUCKET_MIGRATING (uint64_t(1) << 63)
+
+static inline uint64_t bucket_word(uint32_t master, uint32_t forward, bool migrating) {
+  return uint64_t(master) | (uint64_t(forward) << 32) | (migrating ? BUCKET_MIGRATING : 0);
+}
+
+static inline uint32_t bucket_master(uint64_t word) {
+  return uint32_t(word);
+}
 
+static inline uint32_t bucket_forward(uint64_t word) {
+  return uint32_t((word & ~BUCKET_MIGRATING) >> 32);
+}
+
+/*
+  Clones share the map of their source, so a bucket migrated through one
+  handle moves for all of them. Every bucket is a single word which is
+  changed with one atomic store.
+*/
 struct memcached_virtual_bucket_t {
   bool has_forward;
   uint32_t size;
   uint32_t replicas;
-  struct bucket_t buckets[];
+  std::atomic<uint32_t> references;
+  std::atomic<uint32_t> migrating; // number of buckets being migrated
+  std::atomic<uint64_t> buckets[];
 };
 
 memcached_return_t memcached_virtual_bucket_create(memcached_st *self, const uint32_t *host_map,
@@ -38,34 +64,44 @@ memcached_return_t memcached_virtual_bucket_create(memcached_st *self, const uin
 
   memcached_virtual_bucket_free(self);
 
-  struct memcached_virtual_bucket_t *virtual_bucket = (struct memcached_virtual_bucket_t *) malloc(
-      sizeof(struct memcached_virtual_bucket_t) + sizeof(struct bucket_t) * buckets);
+  void *memory = malloc(sizeof(struct memcached_virtual_bucket_t)
+                        + sizeof(std::atomic<uint64_t>) * buckets);
 
-  if (virtual_bucket == NULL) {
+  if (memory == NULL) {
     return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
   }
 
+  struct memcached_virtual_bucket_t *virtual_bucket = new (memory) memcached_virtual_bucket_t;
+  virtual_bucket->has_forward = forward_map != NULL;
   virtual_bucket->size = buckets;
   virtual_bucket->replicas = replicas;
+  virtual_bucket->references.store(1);
+  virtual_bucket->migrating.store(0);
   self->virtual_bucket = virtual_bucket;
 
   uint32_t x = 0;
   for (; x < buckets; x++) {
-    virtual_bucket->buckets[x].master = host_map[x];
-    if (forward_map) {
-      virtual_bucket->buckets[x].forward = forward_map[x];
-    } else {
-      virtual_bucket->buckets[x].forward = 0;
-    }
+    uint32_t forward = forward_map ? forward_map[x] : 0;
+    new (&virtual_bucket->buckets[x]) std::atomic<uint64_t>(bucket_word(host_map[x], forward, false));
   }
 
   return MEMCACHED_SUCCESS;
 }
 
+void memcached_virtual_bucket_clone(memcached_st *destination, const memcached_st *source) {
+  memcached_virtual_bucket_free(destination);
+  if (source->virtual_bucket) {
+    source->virtual_bucket->references.fetch_add(1);
+    destination->virtual_bucket = source->virtual_bucket;
+  }
+}
+
 void memcached_virtual_bucket_free(memcached_st *self) {
   if (self) {
     if (self->virtual_bucket) {
-      free(self->virtual_bucket);
+      if (self->virtual_bucket->references.fetch_sub(1) == 1) {
+        free(self->virtual_bucket);
+      }
       self->virtual_bucket = NULL;
     }
   }
@@ -75,7 +111,7 @@ uint32_t memcached_virtual_bucket_get(const memcached_st *self, uint32_t digest)
   if (self) {
     if (self->virtual_bucket) {
       uint32_t result = (uint32_t)(digest & (self->virtual_bucket->size - 1));
-      return self->virtual_bucket->buckets[result].master;
+      return bucket_master(self->virtual_bucket->buckets[result].load(std::memory_order_acquire));
     }
 
     return (uint32_t)(digest & (self->number_of_hosts - 1));
@@ -83,3 +119,249 @@ uint32_t memcached_virtual_bucket_get(const memcached_st *self, uint32_t digest)
 
   return 0;
 }
+
+uint32_t memcached_virtual_bucket_forward(const memcached_st *self, uint32_t digest) {
+  if (self and self->virtual_bucket) {
+    uint32_t result = (uint32_t)(digest & (self->virtual_bucket->size - 1));
+    uint64_t word = self->virtual_bucket->buckets[result].load(std::memory_order_acquire);
+    if (word & BUCKET_MIGRATING) {
+      return bucket_forward(word);
+    }
+  }
+
+  return UINT32_MAX;
+}
+
+bool memcached_virtual_bucket_migrating(const memcached_st *self) {
+  return self->distribution == MEMCACHED_DISTRIBUTION_VIRTUAL_BUCKET and self->virtual_bucket
+      and self->virtual_bucket->migrating.load(std::memory_order_relaxed) != 0;
+}
+
+memcached_return_t memcached_bucket_migrate(memcached_st *shell, uint32_t bucket, uint32_t server) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_virtual_bucket_t *virtual_bucket = ptr->virtual_bucket;
+  if (virtual_bucket == NULL or bucket >= virtual_bucket->size
+      or server >= memcached_server_count(ptr))
+  {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("No such virtual bucket or server"));
+  }
+
+  uint64_t word = virtual_bucket->buckets[bucket].load(std::memory_order_acquire);
+  if (word & BUCKET_MIGRATING) {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("Virtual bucket is already migrating"));
+  }
+  if (bucket_master(word) == server) {
+    return MEMCACHED_SUCCESS;
+  }
+
+  if (virtual_bucket->buckets[bucket].compare_exchange_strong(
+          word, bucket_word(server, bucket_master(word), true), std::memory_order_acq_rel))
+  {
+    virtual_bucket->migrating.fetch_add(1);
+    return MEMCACHED_SUCCESS;
+  }
+
+  return memcached_set_error(*ptr, MEMCACHED_IN_PROGRESS, MEMCACHED_AT,
+                             memcached_literal_param("Virtual bucket changed meanwhile"));
+}
+
+memcached_return_t memcached_bucket_migrate_forward(memcached_st *shell) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_virtual_bucket_t *virtual_bucket = ptr->virtual_bucket;
+  if (virtual_bucket == NULL or virtual_bucket->has_forward == false) {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("No forward map"));
+  }
+
+  for (uint32_t x = 0; x < virtual_bucket->size; ++x) {
+    uint64_t word = virtual_bucket->buckets[x].load(std::memory_order_acquire);
+    if ((word & BUCKET_MIGRATING) == 0 and bucket_forward(word) != bucket_master(word)) {
+      memcached_return_t rc = memcached_bucket_migrate(ptr, x, bucket_forward(word));
+      if (memcached_failed(rc)) {
+        return rc;
+      }
+    }
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_bucket_migrate_done(memcached_st *shell, uint32_t bucket) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_virtual_bucket_t *virtual_bucket = ptr->virtual_bucket;
+  if (virtual_bucket == NULL or bucket >= virtual_bucket->size) {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("No such virtual bucket"));
+  }
+
+  uint64_t word = virtual_bucket->buckets[bucket].load(std::memory_order_acquire);
+  if (word & BUCKET_MIGRATING) {
+    // the forward entry has been used up
+    uint32_t master = bucket_master(word);
+    if (virtual_bucket->buckets[bucket].compare_exchange_strong(
+            word, bucket_word(master, master, false), std::memory_order_acq_rel))
+    {
+      virtual_bucket->migrating.fetch_sub(1);
+    }
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+// longest expiration memcached takes as relative to now, longer ones are unix times
+#define BUCKET_RELATIVE_EXPIRATION_MAX (60 * 60 * 24 * 30)
+
+struct bucket_copy_st {
+  Memcached *ptr;
+  memcached_extension_st *extension;
+  std::unordered_map<std::string, time_t> keys; // of the batch, with their listed expiration
+};
+
+/* The listed expiration of a key as memcached_add() takes it, 0 if it never expires */
+static time_t bucket_copy_expiration(const bucket_copy_st &copy, const std::string &key,
+                                     time_t now) {
+  auto found = copy.keys.find(key);
+  // it was still there: older servers print their start time for items without expiration
+  if (found == copy.keys.end() or found->second <= now) {
+    return 0;
+  }
+  return found->second - now <= BUCKET_RELATIVE_EXPIRATION_MAX ? found->second - now
+                                                                : found->second;
+}
+
+static memcached_return_t bucket_copy_batch(bucket_copy_st &copy) {
+  if (copy.keys.empty()) {
+    return MEMCACHED_SUCCESS;
+  }
+
+  std::vector<const char *> keys;
+  std::vector<size_t> key_length;
+  keys.reserve(copy.keys.size());
+  key_length.reserve(copy.keys.size());
+  for (const auto &key : copy.keys) {
+    keys.push_back(key.first.data());
+    key_length.push_back(key.first.size());
+  }
+
+  copy.extension->bucket.route = MEMCACHED_BUCKET_ROUTE_FORWARD;
+  memcached_return_t rc = memcached_mget(copy.ptr, keys.data(), key_length.data(), keys.size());
+  copy.extension->bucket.route = MEMCACHED_BUCKET_ROUTE_MASTER;
+  if (memcached_failed(rc)) {
+    return rc;
+  }
+
+  // read everything before the connections are used for storing
+  struct item_st {
+    std::string key;
+    std::string value;
+    uint32_t flags;
+  };
+  std::vector<item_st> items;
+  memcached_result_st result;
+  if (memcached_result_create(copy.ptr, &result) == NULL) {
+    return memcached_set_error(*copy.ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  while (memcached_fetch_result(copy.ptr, &result, &rc)) {
+    items.push_back({std::string(memcached_result_key_value(&result),
+                                 memcached_result_key_length(&result)),
+                     std::string(memcached_result_value(&result), memcached_result_length(&result)),
+                     memcached_result_flags(&result)});
+  }
+  memcached_result_free(&result);
+
+  time_t now = time(NULL);
+  for (const item_st &item : items) {
+    // add, so values written to the new server since the migration started win
+    rc = memcached_add(copy.ptr, item.key.data(), item.key.size(), item.value.data(),
+                       item.value.size(), bucket_copy_expiration(copy, item.key, now),
+                       item.flags);
+    if (rc == MEMCACHED_SUCCESS) {
+      copy.extension->bucket.copied++;
+    } else if (rc != MEMCACHED_NOTSTORED and rc != MEMCACHED_DATA_EXISTS) {
+      return rc;
+    }
+  }
+  copy.keys.clear();
+
+  return MEMCACHED_SUCCESS;
+}
+
+static memcached_return_t bucket_copy_item(const memcached_st *,
+                                           const memcached_dump_item_st *item, void *context) {
+  bucket_copy_st &copy = *static_cast<bucket_copy_st *>(context);
+
+  if (memcached_generate_forward(copy.ptr, item->key, item->key_length) == UINT32_MAX) {
+    return MEMCACHED_SUCCESS;
+  }
+
+  copy.keys[std::string(item->key, item->key_length)] = item->expiration;
+  if (copy.keys.size() < BUCKET_COPY_BATCH) {
+    return MEMCACHED_SUCCESS;
+  }
+  return bucket_copy_batch(copy);
+}
+
+memcached_return_t memcached_bucket_migrate_copy(memcached_st *shell) {
+  Memcached *ptr = memcached2Memcached(shell);
+  if (ptr == NULL) {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_extension_st *extension = memcached_extension_fetch(ptr);
+  if (extension == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  if (memcached_virtual_bucket_migrating(ptr) == false) {
+    return MEMCACHED_SUCCESS;
+  }
+
+  // memcached_dump_items() only speaks the text protocol and keeps its connections busy
+  memcached_st *dumper = memcached_clone(NULL, ptr);
+  if (dumper == NULL) {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  memcached_behavior_set(dumper, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, 0);
+
+  bucket_copy_st copy = {ptr, extension, {}};
+  copy.keys.reserve(BUCKET_COPY_BATCH);
+
+  memcached_return_t rc = memcached_dump_items(dumper, bucket_copy_item, &copy);
+  if (memcached_success(rc)) {
+    rc = bucket_copy_batch(copy);
+  }
+  memcached_free(dumper);
+
+  return rc;
+}
+
+void memcached_bucket_migration_stat(const memcached_st *shell,
+                                     struct memcached_bucket_migration_stat_st *stat) {
+  const Memcached *ptr = memcached2Memcached(shell);
+  if (stat == NULL) {
+    return;
+  }
+
+  memset(stat, 0, sizeof(*stat));
+  if (ptr) {
+    if (const memcached_extension_st *extension = memcached_extension(ptr)) {
+      stat->forward_reads = extension->bucket.forward_reads;
+      stat->forward_hits = extension->bucket.forward_hits;
+      stat->copied = extension->bucket.copied;
+    }
+  }
+}
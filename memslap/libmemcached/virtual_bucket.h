@@ -27,6 +27,15 @@ uint32_t memcached_virtual_bucket_get(const memcached_st *self, uint32_t digest)
 
 void memcached_virtual_bucket_free(memcached_st *self);
 
+/* Shares the map of source, see bucket_migration.h */
+void memcached_virtual_bucket_clone(memcached_st *destination, const memcached_st *source);
+
+/* Previous server of a migrating bucket, UINT32_MAX for buckets not being migrated */
+uint32_t memcached_virtual_bucket_forward(const memcached_st *self, uint32_t digest);
+
+/* True while any bucket of the map of self is being migrated */
+bool memcached_virtual_bucket_migrating(const memcached_st *self);
+
 #ifdef __cplusplus
 }
 #endif
@@ -22,22 +22,119 @@
 #define DEFAULT_INITIAL_LOAD   10000ul
 #define DEFAULT_EXECUTE_NUMBER 10000ul
 #define DEFAULT_CONCURRENCY    1ul
+#define DEFAULT_HOT_KEY_THRESHOLD 64ul
+#define DEFAULT_ADD_SHARD_AFTER   1000ul
+#define VIRTUAL_BUCKETS           1024u
+#define TIMELINE_INTERVAL_MS      100
+#define SHARD_QUEUE_SIZE          1024ul
 
 #include "options.hpp"
 #include "checks.hpp"
 #include "time.hpp"
 #include "random.hpp"
+#include "snapshot.hpp"
+#include "spsc.hpp"
 
 #include <atomic>
 #include <thread>
+#include <unordered_map>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <cstring>
+#include <fstream>
 
 static std::atomic_bool wakeup;
 
 static unsigned long test_count = DEFAULT_EXECUTE_NUMBER;
+static unsigned long hot_key_replicas = 0;
+static unsigned long hot_key_threshold = DEFAULT_HOT_KEY_THRESHOLD;
+static double zipf_exponent = 0;
+static unsigned long read_through_batch = 0;
+static unsigned long pipeline_depth = 0;
+static memcached_mux_st *mux = nullptr; // with --multiplex, shared by all threads
+static unsigned long add_shard_after = DEFAULT_ADD_SHARD_AFTER;
+static time_clock::time_point test_begin;
+
+// how cache hits are read, see --zero-copy
+enum class get_api { copy, into, view };
+static get_api value_api = get_api::copy;
+
+// libmemcached allocates from memcached_pool_malloc() and friends, see --pool-allocator
+static bool pool_allocator = false;
+
+// every ALLOCATOR_SAMPLE-th allocator call is timed
+#define ALLOCATOR_SAMPLE 64
+
+// allocations of libmemcached in the current thread, and the time spent in the allocator
+static thread_local unsigned long library_allocations = 0;
+static thread_local unsigned long allocator_calls = 0;
+static thread_local time_format_us allocator_time{0};
+
+struct allocator_sample {
+  bool timed;
+  time_clock::time_point start;
+
+  allocator_sample() : timed{++allocator_calls % ALLOCATOR_SAMPLE == 0} {
+    if (timed) {
+      start = time_clock::now();
+    }
+  }
+  ~allocator_sample() {
+    if (timed) {
+      allocator_time += (time_clock::now() - start) * ALLOCATOR_SAMPLE;
+    }
+  }
+};
+
+static void *counting_malloc(const memcached_st *ptr, const size_t size, void *context) {
+  allocator_sample sample;
+  ++library_allocations;
+  return pool_allocator ? memcached_pool_malloc(ptr, size, context) : malloc(size);
+}
+
+static void counting_free(const memcached_st *ptr, void *mem, void *context) {
+  allocator_sample sample;
+  if (pool_allocator) {
+    memcached_pool_free(ptr, mem, context);
+  } else {
+    free(mem);
+  }
+}
+
+static void *counting_realloc(const memcached_st *ptr, void *mem, const size_t size,
+                              void *context) {
+  allocator_sample sample;
+  ++library_allocations;
+  return pool_allocator ? memcached_pool_realloc(ptr, mem, size, context) : realloc(mem, size);
+}
+
+static void *counting_calloc(const memcached_st *ptr, size_t nelem, const size_t size,
+                             void *context) {
+  allocator_sample sample;
+  ++library_allocations;
+  return pool_allocator ? memcached_pool_calloc(ptr, nelem, size, context)
+                        : calloc(nelem, size);
+}
+
+// values the library returns come from the allocators of the handle, so may be pool blocks
+static void free_value(const memcached_st *memc, char *value) {
+  counting_free(memc, value, nullptr);
+}
+
+// resident set of the process
+static unsigned long resident_kb() {
+  std::ifstream statm("/proc/self/statm");
+  unsigned long size = 0, resident = 0;
+  statm >> size >> resident;
+  return resident * (unsigned long) sysconf(_SC_PAGESIZE) / 1024;
+}
+
+static memcached_return_t ignore_value(const memcached_st *, const memcached_value_view_st *,
+                                       void *) {
+  return MEMCACHED_SUCCESS;
+}
 
 static memcached_return_t counter(const memcached_st *, memcached_result_st *, void *ctx) {
   auto c = static_cast<size_t *>(ctx);
@@ -84,21 +181,86 @@ typedef struct {
   unsigned long hit_num, miss_num, retrieved;
   time_format_us cache_lookup_duration, total_lookup_duration; // avg time for cache lookup vs cache+db lookup
   time_format_us thread_elapsed; // total thread execution time
+  time_format_us cpu_time; // CPU time spent by the thread during the test
+  memcached_hotkey_stat_st hotkey;
+  memcached_compression_stat_st compression;
+  memcached_hedge_stat_st hedge;
+  memcached_read_through_stat_st read_through;
+  memcached_bounded_load_stat_st bounded_load;
+  memcached_bucket_migration_stat_st migration;
+  memcached_replica_read_stat_st replica_read;
+  memcached_epoll_stat_st epoll;
+  memcached_io_stat_st io;
+  unsigned long allocations; // by libmemcached during the test
+  time_format_us allocator_time; // estimated from ALLOCATOR_SAMPLE
+  unsigned long routed; // gets handed to the thread owning their server
+  unsigned long connections; // open server connections at the end of the test
+  memcached_buffer_stat_st buffers; // of the connections at the end of the test
+  memcached_async_stat_st async;
+  memcached_udp_stat_st udp;
 } stats;
 
+// hits and misses of all gets per TIMELINE_INTERVAL_MS since the test started
+struct timeline_slot {
+  unsigned long hits, misses;
+};
+
+// a get of the key at index key, issued by another thread
+struct routed_get {
+  size_t key;
+  time_clock::time_point issued;
+};
+
+// an asynchronous get or set of the key at index key in flight, with --depth
+struct pipelined_op {
+  size_t key;
+  time_clock::time_point issued;
+};
+
+// with --shard-affine, thread t owns the servers s with s % threads == t and their
+// connections, the other threads hand it the gets of its keys
+struct shard_router {
+  explicit shard_router(unsigned long threads_)
+  : threads{threads_}
+  , queues(threads_ * threads_)
+  , generating{threads_}
+  {
+    for (auto &queue : queues) {
+      queue.reset(new spsc_queue<routed_get>(SHARD_QUEUE_SIZE));
+    }
+  }
+
+  unsigned long owner(uint32_t server) const {
+    return server % threads;
+  }
+
+  spsc_queue<routed_get> &queue(unsigned long from, unsigned long to) {
+    return *queues[from * threads + to];
+  }
+
+  unsigned long threads;
+  std::vector<std::unique_ptr<spsc_queue<routed_get>>> queues;
+  std::atomic<unsigned long> generating; // threads which still issue gets
+};
+
 class thread_context {
 public:
-  thread_context(const client_options &opt_, const memcached_st &memc_, const keyval_st &kv_)
+  thread_context(const client_options &opt_, const memcached_st &memc_, const keyval_st &kv_,
+                 unsigned long index_, shard_router *router_)
   : opt{opt_}
   , kv{kv_}
+  , index{index_}
+  , router{router_}
   , count{}
   , root(memc_)
   , memc{}
+  , hotkey{}
   , _stats{0,0,0,time_format_us(0),time_format_us(0)}
   , thread([this] { execute(); })
   {}
 
   ~thread_context() {
+    memcached_hotkey_free(hotkey);
     if (conn) {
       PQfinish(conn);
       conn = nullptr;
@@ -114,9 +276,35 @@ public:
     // clone memcached connection
     memcached_clone(&memc, &root);
 
+    if (hot_key_replicas) {
+      hotkey = memcached_hotkey_create(&memc, hot_key_replicas, hot_key_threshold);
+      if (!hotkey) {
+        if (!opt.isset("quiet")) {
+          std::cerr << "Failed to create hot-key tracker\n";
+        }
+        return false;
+      }
+    }
+
+    if (read_through_batch) {
+      memcached_set_read_through(&memc, load, this);
+    }
+    if (pipeline_depth) {
+      memcached_async_set_callback(&memc, completed, this);
+    }
+    if (value_api == get_api::into) {
+      value_buffer.resize(1 << 20); // the default item size limit of memcached
+    }
+
     // open postgres connection
     if (!opt.postgres.host || !opt.postgres.dbname) {
       // PostgreSQL connection is optional
+      if (read_through_batch) {
+        if (!opt.isset("quiet")) {
+          std::cerr << "Read-through mode needs a PostgreSQL database\n";
+        }
+        return false;
+      }
       return true;
     }
 
@@ -171,7 +359,11 @@ public:
   int init_cache(unsigned long num, unsigned long index) {
     // For each execution, randomly select from our pool of keys
     for (auto i = 0u; i < kv.num; ++i) {
-      if (i%num != index){
+      if (router ? router->owner(memcached_generate_hash(&memc, kv.key.chr[i].data(),
+                                                         kv.key.chr[i].size()))
+                       != index
+                 : i % num != index)
+      {
         continue; // only deal with part of the keys
       }
 
@@ -194,8 +386,7 @@ public:
 
       if (PQntuples(res) > 0) {
         std::string pg_value = PQgetvalue(res, 0, 0);
-        memcached_return_t rc = memcached_set(&memc, kv.key.chr[i].data(), kv.key.chr[i].size(),
-                                              pg_value.data(), pg_value.size(), 0, 0);
+        memcached_return_t rc = cache_set(i, pg_value);
         if (rc != MEMCACHED_SUCCESS && opt.isset("verbose")) {
           std::cerr << "WARNING: storing key " << kv.key.chr[i] << " in cache failed with error: "
                     <<  memcached_strerror(&memc, rc) << std::endl;
@@ -207,96 +398,508 @@ public:
     return 0;
   }
 
-  void execute_get() {
+  // read-through loader: fetch all missing keys with one query
+  static memcached_return_t load(const memcached_st *, const char *const *keys,
+                                 const size_t *key_length, size_t number_of_keys,
+                                 memcached_result_st *results, memcached_return_t *status,
+                                 void *context) {
+    auto self = static_cast<thread_context *>(context);
+
+    std::unordered_map<std::string, size_t> index;
+    std::string array = "{";
+    for (auto i = 0u; i < number_of_keys; ++i) {
+      index.emplace(std::string(keys[i], key_length[i]), i);
+      if (i) {
+        array += ',';
+      }
+      array.append(keys[i], key_length[i]);
+    }
+    array += '}';
+
+    const char *param_values[1] = {array.data()};
+    PGresult *res = PQexecParams(self->conn, "SELECT key, value FROM test WHERE key = ANY($1::text[])",
+                                 1, nullptr, param_values, nullptr, nullptr, 0);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+      PQclear(res);
+      return MEMCACHED_FAILURE;
+    }
+
+    for (auto row = 0; row < PQntuples(res); ++row) {
+      auto found = index.find(PQgetvalue(res, row, 0));
+      if (found != index.end()) {
+        memcached_result_set_value(&results[found->second], PQgetvalue(res, row, 1),
+                                   PQgetlength(res, row, 1));
+        status[found->second] = MEMCACHED_SUCCESS;
+      }
+    }
+    PQclear(res);
+    return MEMCACHED_SUCCESS;
+  }
+
+  // cache-aside through the library: misses are loaded and written back by libmemcached
+  void execute_read_through() {
     random64 rnd{};
+    std::unique_ptr<zipf64> zipf;
+    if (zipf_exponent > 0) {
+      zipf.reset(new zipf64(kv.num, zipf_exponent));
+    }
+
+    std::vector<const char *> keys(read_through_batch);
+    std::vector<size_t> lengths(read_through_batch);
+    memcached_execute_fn callbacks[] = {&counter};
+    memcached_read_through_stat_st before, after;
 
     auto thread_start = time_clock::now();
+    auto cpu_start = thread_cpu_time();
+    library_allocations = 0;
+    allocator_time = time_format_us{0};
+    latency.reserve(test_count / read_through_batch + 1);
+
+    for (auto i = 0ul; i < test_count; i += read_through_batch) {
+      auto batch = std::min(read_through_batch, test_count - i);
+      for (auto k = 0ul; k < batch; ++k) {
+        auto r = zipf ? (*zipf)() : rnd(0, kv.num);
+        keys[k] = kv.key.chr[r].data();
+        lengths[k] = kv.key.chr[r].size();
+      }
+
+      memcached_read_through_stat(&memc, &before);
+      auto start = time_clock::now();
 
-    // For each execution, randomly select from our pool of keys
-    for (auto i = 0u; i < test_count; ++i) {
       memcached_return_t rc;
-      auto r = rnd(0, kv.num); // Select random key from our pool
+      size_t fetched = 0;
+      if (batch == 1) {
+        free_value(&memc, memcached_get(&memc, keys[0], lengths[0], nullptr, nullptr, &rc));
+      } else {
+        rc = memcached_mget_read_through(&memc, keys.data(), lengths.data(), batch, callbacks,
+                                         &fetched, 1);
+      }
 
-      auto start = time_clock::now();
-      auto restart = time_clock::now();
+      auto elapsed = time_clock::now() - start;
+      latency.push_back(uint32_t(time_format_us(elapsed).count()));
+      memcached_read_through_stat(&memc, &after);
 
-      free(memcached_get(&memc, kv.key.chr[r].data(), kv.key.chr[r].size(), nullptr, nullptr,
-                         &rc));
-      ++_stats.retrieved;
+      if (!memcached_success(rc) && opt.isset("verbose")) {
+        std::cerr << "WARNING: read-through of " << batch << " keys failed with error: "
+                  << memcached_strerror(&memc, rc) << std::endl;
+      }
 
-      if (rc == MEMCACHED_SUCCESS) {
-        if (opt.isset("verbose")) {
-          std::cout << "FOUND KEY "  << kv.key.chr[r] << " IN CACHE" << std::endl;
-        }
-        ++_stats.hit_num;
-        auto elapsed = time_clock::now() - start;
-        _stats.cache_lookup_duration = _stats.cache_lookup_duration + elapsed;
-        continue;
+      auto missed = after.keys_missed - before.keys_missed;
+      _stats.retrieved += batch;
+      _stats.miss_num += missed;
+      _stats.hit_num += batch - missed;
+      if (missed) {
+        _stats.total_lookup_duration += elapsed;
+      } else {
+        _stats.cache_lookup_duration += elapsed;
       }
+    }
 
+    _stats.thread_elapsed = time_clock::now() - thread_start;
+    _stats.cpu_time = thread_cpu_time() - cpu_start;
+    _stats.allocations = library_allocations;
+    _stats.allocator_time = allocator_time;
+    memcached_compression_stat(&memc, &_stats.compression);
+    memcached_hedge_stat(&memc, &_stats.hedge);
+    memcached_read_through_stat(&memc, &_stats.read_through);
+    memcached_bounded_load_stat(&memc, &_stats.bounded_load);
+    memcached_epoll_stat(&memc, &_stats.epoll);
+    memcached_io_stat(&memc, &_stats.io);
+    memcached_udp_stat(&memc, &_stats.udp);
+  }
+
+  // one cache-aside read of the key at index r, issued at start
+  void lookup(size_t r, time_clock::time_point start) {
+    memcached_return_t rc;
+    auto restart = time_clock::now();
+
+    rc = cache_get(r);
+    ++_stats.retrieved;
+    latency.push_back(uint32_t(time_format_us(time_clock::now() - start).count()));
+
+    auto slot = size_t(std::chrono::duration_cast<std::chrono::milliseconds>(
+                           time_clock::now() - test_begin).count() / TIMELINE_INTERVAL_MS);
+    if (slot >= timeline.size()) {
+      timeline.resize(slot + 1);
+    }
+    ++(rc == MEMCACHED_SUCCESS ? timeline[slot].hits : timeline[slot].misses);
+
+    if (rc == MEMCACHED_SUCCESS) {
       if (opt.isset("verbose")) {
-        std::cout << "NOT FOUND KEY "  << kv.key.chr[r] << " IN CACHE" << std::endl;
+        std::cout << "FOUND KEY "  << kv.key.chr[r] << " IN CACHE" << std::endl;
       }
+      ++_stats.hit_num;
+      auto elapsed = time_clock::now() - start;
+      _stats.cache_lookup_duration = _stats.cache_lookup_duration + elapsed;
+      return;
+    }
 
-      ++_stats.miss_num;
+    if (opt.isset("verbose")) {
+      std::cout << "NOT FOUND KEY "  << kv.key.chr[r] << " IN CACHE" << std::endl;
+    }
 
-      // Cache miss - query PostgreSQL
-      std::string query = "SELECT value FROM test WHERE key = $1";
-      const char *param_values[1] = {kv.key.chr[r].data()};
-      const int param_lengths[1] = {static_cast<int>(kv.key.chr[r].size())};
-      const int param_formats[1] = {0}; // text format
+    ++_stats.miss_num;
 
-      PGresult *res = PQexecParams(conn, query.data(), 1, nullptr, param_values,
-                                   param_lengths, param_formats, 0);
+    // Cache miss - query PostgreSQL
+    PGresult *res = db_get(r);
 
-      if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
-        std::cerr << "WARNING: key " << kv.key.chr[r] << " not found in database" << std::endl;
-        auto elapsed = time_clock::now() - restart;
-        _stats.total_lookup_duration += elapsed;
-        PQclear(res);
-        continue;
+    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
+      std::cerr << "WARNING: key " << kv.key.chr[r] << " not found in database" << std::endl;
+      auto elapsed = time_clock::now() - restart;
+      _stats.total_lookup_duration += elapsed;
+      PQclear(res);
+      return;
+    }
+
+    if (opt.isset("verbose")) {
+      std::cout << "STORING KEY IN CACHE: " << kv.key.chr[r] << std::endl;
+    }
+
+    if (PQntuples(res) > 0) {
+      std::string pg_value = PQgetvalue(res, 0, 0);
+      rc = cache_set(r, pg_value);
+
+      if (rc != MEMCACHED_SUCCESS) {
+        // if (rc != MEMCACHED_SUCCESS && opt.isset("verbose")) {
+        std::cerr << "WARNING: storing key " << kv.key.chr[r] << " in cache failed with error: "
+                  <<  memcached_strerror(&memc, rc) << std::endl;
+      }
+    }
+    auto reelapsed = time_clock::now() - restart;
+    _stats.total_lookup_duration += reelapsed;
+    PQclear(res);
+  }
+
+  void execute_get() {
+    random64 rnd{};
+    std::unique_ptr<zipf64> zipf;
+    if (zipf_exponent > 0) {
+      zipf.reset(new zipf64(kv.num, zipf_exponent));
+    }
+
+    auto thread_start = time_clock::now();
+    auto cpu_start = thread_cpu_time();
+    library_allocations = 0;
+    allocator_time = time_format_us{0};
+    latency.reserve(test_count);
+
+    // For each execution, randomly select from our pool of keys
+    for (auto i = 0u; i < test_count; ++i) {
+      auto r = zipf ? (*zipf)() : rnd(0, kv.num); // Select random key from our pool
+      lookup(r, time_clock::now());
+    }
+
+    _stats.thread_elapsed = time_clock::now() - thread_start;
+    _stats.cpu_time = thread_cpu_time() - cpu_start;
+    _stats.allocations = library_allocations;
+    _stats.allocator_time = allocator_time;
+    memcached_hotkey_stat(hotkey, &_stats.hotkey);
+    memcached_compression_stat(&memc, &_stats.compression);
+    memcached_hedge_stat(&memc, &_stats.hedge);
+    memcached_bounded_load_stat(&memc, &_stats.bounded_load);
+    memcached_epoll_stat(&memc, &_stats.epoll);
+    memcached_io_stat(&memc, &_stats.io);
+    memcached_udp_stat(&memc, &_stats.udp);
+    memcached_bucket_migration_stat(&memc, &_stats.migration);
+    memcached_replica_read_stat(&memc, &_stats.replica_read);
+  }
+
+  // gets with up to pipeline_depth in flight per server; the values of misses are loaded
+  // after the completions of each poll and written back asynchronously as well
+  void execute_pipelined() {
+    random64 rnd{};
+    std::unique_ptr<zipf64> zipf;
+    if (zipf_exponent > 0) {
+      zipf.reset(new zipf64(kv.num, zipf_exponent));
+    }
+
+    // every connection may have a full pipeline
+    ops.resize(pipeline_depth * memcached_server_count(&memc));
+    free_ops.clear();
+    for (auto x = ops.size(); x > 0; --x) {
+      free_ops.push_back(x - 1);
+    }
+
+    auto thread_start = time_clock::now();
+    auto cpu_start = thread_cpu_time();
+    library_allocations = 0;
+    allocator_time = time_format_us{0};
+    latency.reserve(test_count);
+
+    for (auto i = 0u; i < test_count; ++i) {
+      auto r = zipf ? (*zipf)() : rnd(0, kv.num);
+      while (free_ops.empty()) {
+        memcached_async_poll(&memc, -1, nullptr);
       }
+      auto op = submit_op(r, time_clock::now());
+      memcached_return_t rc =
+          memcached_async_get(&memc, kv.key.chr[r].data(), kv.key.chr[r].size(), op);
+      if (!memcached_success(rc)) {
+        if (opt.isset("verbose")) {
+          std::cerr << "WARNING: get of key " << kv.key.chr[r] << " failed with error: "
+                    << memcached_strerror(&memc, rc) << std::endl;
+        }
+        release_op(op);
+      }
+      memcached_async_poll(&memc, 0, nullptr);
+      load_misses();
+    }
 
-      if (opt.isset("verbose")) {
-        std::cout << "STORING KEY IN CACHE: " << kv.key.chr[r] << std::endl;
+    while (memcached_async_pending(&memc) || !misses.empty()) {
+      memcached_async_poll(&memc, -1, nullptr);
+      load_misses();
+    }
+
+    _stats.thread_elapsed = time_clock::now() - thread_start;
+    _stats.cpu_time = thread_cpu_time() - cpu_start;
+    _stats.allocations = library_allocations;
+    _stats.allocator_time = allocator_time;
+    memcached_compression_stat(&memc, &_stats.compression);
+    memcached_bounded_load_stat(&memc, &_stats.bounded_load);
+    memcached_epoll_stat(&memc, &_stats.epoll);
+    memcached_io_stat(&memc, &_stats.io);
+    memcached_udp_stat(&memc, &_stats.udp);
+    memcached_async_stat(&memc, &_stats.async);
+  }
+
+  // executes the gets of keys on owned servers, issued here or routed from other threads
+  bool drain() {
+    auto drained = false;
+    routed_get get;
+    for (auto from = 0ul; from < router->threads; ++from) {
+      if (from == index) {
+        continue;
       }
+      auto &queue = router->queue(from, index);
+      while (queue.pop(get)) {
+        lookup(get.key, get.issued);
+        drained = true;
+      }
+    }
+    return drained;
+  }
 
-      if (PQntuples(res) > 0) {
-        std::string pg_value = PQgetvalue(res, 0, 0);
-        rc = memcached_set(&memc, kv.key.chr[r].data(), kv.key.chr[r].size(),
-                           pg_value.data(), pg_value.size(), 0, 0);
+  // like execute_get(), but gets of keys on servers owned by other threads are handed to them
+  void execute_shard_affine() {
+    random64 rnd{};
+    std::unique_ptr<zipf64> zipf;
+    if (zipf_exponent > 0) {
+      zipf.reset(new zipf64(kv.num, zipf_exponent));
+    }
 
-        if (rc != MEMCACHED_SUCCESS) {
-          // if (rc != MEMCACHED_SUCCESS && opt.isset("verbose")) {
-          std::cerr << "WARNING: storing key " << kv.key.chr[i] << " in cache failed with error: "
-                    <<  memcached_strerror(&memc, rc) << std::endl;
+    auto thread_start = time_clock::now();
+    auto cpu_start = thread_cpu_time();
+    library_allocations = 0;
+    allocator_time = time_format_us{0};
+    latency.reserve(test_count);
+
+    for (auto i = 0u; i < test_count; ++i) {
+      auto r = zipf ? (*zipf)() : rnd(0, kv.num);
+      auto issued = time_clock::now();
+      auto owner =
+          router->owner(memcached_generate_hash(&memc, kv.key.chr[r].data(), kv.key.chr[r].size()));
+      if (owner == index) {
+        lookup(r, issued);
+      } else {
+        // a full queue drains ours, so two threads waiting on each other make progress
+        while (!router->queue(index, owner).push(routed_get{r, issued})) {
+          drain();
         }
+        ++_stats.routed;
+      }
+      drain();
+    }
+
+    // keep serving the others until every thread has issued all its gets
+    router->generating.fetch_sub(1, std::memory_order_release);
+    while (router->generating.load(std::memory_order_acquire)) {
+      if (!drain()) {
+        std::this_thread::yield();
       }
-      auto reelapsed = time_clock::now() - restart;
-      _stats.total_lookup_duration += reelapsed;
-      PQclear(res);
     }
+    drain();
 
     _stats.thread_elapsed = time_clock::now() - thread_start;
+    _stats.cpu_time = thread_cpu_time() - cpu_start;
+    _stats.allocations = library_allocations;
+    _stats.allocator_time = allocator_time;
+    memcached_hotkey_stat(hotkey, &_stats.hotkey);
+    memcached_compression_stat(&memc, &_stats.compression);
+    memcached_hedge_stat(&memc, &_stats.hedge);
+    memcached_bounded_load_stat(&memc, &_stats.bounded_load);
+    memcached_epoll_stat(&memc, &_stats.epoll);
+    memcached_io_stat(&memc, &_stats.io);
+    memcached_udp_stat(&memc, &_stats.udp);
+    memcached_bucket_migration_stat(&memc, &_stats.migration);
+    memcached_replica_read_stat(&memc, &_stats.replica_read);
   }
 
   stats get_stats(){return _stats;}
 
+  const std::vector<timeline_slot> &get_timeline() const { return timeline; }
+
+  // cache lookup latency of every get in microseconds
+  const std::vector<uint32_t> &get_latency() const { return latency; }
+
 private:
   const client_options &opt;
   const keyval_st &kv;
+  unsigned long index;
+  shard_router *router;
   size_t count;
   const memcached_st &root;
   memcached_st memc;
+  memcached_hotkey_st *hotkey;
   std::thread thread;
   PGconn *conn;
   stats _stats;
+  std::vector<uint32_t> latency;
+  std::vector<timeline_slot> timeline;
+  std::vector<char> value_buffer; // of memcached_get_into()
+  std::vector<pipelined_op> ops; // of execute_pipelined(), those in free_ops are unused
+  std::vector<size_t> free_ops;
+  std::vector<pipelined_op> misses; // gets completed with MEMCACHED_NOTFOUND
+
+  PGresult *db_get(size_t r) {
+    const char *param_values[1] = {kv.key.chr[r].data()};
+    const int param_lengths[1] = {static_cast<int>(kv.key.chr[r].size())};
+    const int param_formats[1] = {0}; // text format
+
+    return PQexecParams(conn, "SELECT value FROM test WHERE key = $1", 1, nullptr, param_values,
+                        param_lengths, param_formats, 0);
+  }
+
+  pipelined_op *submit_op(size_t r, time_clock::time_point issued) {
+    auto op = &ops[free_ops.back()];
+    free_ops.pop_back();
+    *op = pipelined_op{r, issued};
+    return op;
+  }
+
+  void release_op(pipelined_op *op) {
+    free_ops.push_back(size_t(op - ops.data()));
+  }
+
+  static void completed(const memcached_st *, const memcached_async_result_st *result,
+                        void *context) {
+    auto self = static_cast<thread_context *>(context);
+    auto op = static_cast<pipelined_op *>(result->user_data);
+    self->release_op(op);
+
+    if (result->op == MEMCACHED_ASYNC_SET) {
+      if (!memcached_success(result->rc)) {
+        std::cerr << "WARNING: storing key " << self->kv.key.chr[op->key]
+                  << " in cache failed with error: " << memcached_strerror(&self->memc, result->rc)
+                  << std::endl;
+      }
+      return;
+    }
+
+    auto elapsed = time_clock::now() - op->issued;
+    ++self->_stats.retrieved;
+    self->latency.push_back(uint32_t(time_format_us(elapsed).count()));
+    if (result->rc == MEMCACHED_SUCCESS) {
+      ++self->_stats.hit_num;
+      self->_stats.cache_lookup_duration += elapsed;
+    } else {
+      if (result->rc != MEMCACHED_NOTFOUND && self->opt.isset("verbose")) {
+        std::cerr << "WARNING: get of key " << self->kv.key.chr[op->key]
+                  << " failed with error: " << memcached_strerror(&self->memc, result->rc)
+                  << std::endl;
+      }
+      ++self->_stats.miss_num;
+      self->misses.push_back(*op);
+    }
+  }
+
+  // the database reads are blocking, the sets join the pipeline
+  void load_misses() {
+    while (!misses.empty()) {
+      auto miss = misses.back();
+      misses.pop_back();
+
+      PGresult *res = db_get(miss.key);
+      if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
+        while (free_ops.empty()) {
+          memcached_async_poll(&memc, -1, nullptr);
+        }
+        auto op = submit_op(miss.key, miss.issued);
+        memcached_return_t rc =
+            memcached_async_set(&memc, kv.key.chr[miss.key].data(), kv.key.chr[miss.key].size(),
+                                PQgetvalue(res, 0, 0), size_t(PQgetlength(res, 0, 0)), 0, 0, op);
+        if (!memcached_success(rc)) {
+          std::cerr << "WARNING: storing key " << kv.key.chr[miss.key]
+                    << " in cache failed with error: " << memcached_strerror(&memc, rc)
+                    << std::endl;
+          release_op(op);
+        }
+      } else {
+        std::cerr << "WARNING: key " << kv.key.chr[miss.key] << " not found in database"
+                  << std::endl;
+      }
+      PQclear(res);
+      _stats.total_lookup_duration += time_clock::now() - miss.issued;
+    }
+  }
+
+  // hits are only counted, the value is dropped right away
+  memcached_return_t cache_get(size_t r) {
+    memcached_return_t rc;
+    const auto &key = kv.key.chr[r];
+    if (mux) {
+      free_value(&memc, memcached_mux_get(mux, key.data(), key.size(), nullptr, nullptr, &rc));
+    } else if (hotkey) {
+      free_value(&memc,
+                 memcached_hotkey_get(hotkey, key.data(), key.size(), nullptr, nullptr, &rc));
+    } else if (value_api == get_api::into) {
+      rc = memcached_get_into(&memc, key.data(), key.size(), value_buffer.data(),
+                              value_buffer.size(), nullptr, nullptr);
+    } else if (value_api == get_api::view) {
+      rc = memcached_get_view(&memc, key.data(), key.size(), ignore_value, nullptr);
+    } else {
+      free_value(&memc, memcached_get(&memc, key.data(), key.size(), nullptr, nullptr, &rc));
+    }
+    return rc;
+  }
+
+  memcached_return_t cache_set(size_t r, const std::string &value) {
+    if (mux) {
+      return memcached_mux_set(mux, kv.key.chr[r].data(), kv.key.chr[r].size(), value.data(),
+                               value.size(), 0, 0);
+    }
+    if (hotkey) {
+      return memcached_hotkey_set(hotkey, kv.key.chr[r].data(), kv.key.chr[r].size(),
+                                  value.data(), value.size(), 0, 0);
+    }
+    return memcached_set(&memc, kv.key.chr[r].data(), kv.key.chr[r].size(), value.data(),
+                         value.size(), 0, 0);
+  }
 
   void execute() {
     while (!wakeup.load(std::memory_order_acquire)) {
       std::this_thread::yield();
     }
-    execute_get();
+    if (read_through_batch) {
+      execute_read_through();
+    } else if (pipeline_depth) {
+      execute_pipelined();
+    } else if (router) {
+      execute_shard_affine();
+    } else {
+      execute_get();
+    }
+    _stats.connections = open_connections();
+    memcached_buffer_stat(&memc, &_stats.buffers);
+  }
+
+  unsigned long open_connections() const {
+    auto open = 0ul;
+    for (auto x = 0u; x < memcached_server_count(&memc); ++x) {
+      if (memcached_server_instance_by_position(&memc, x)->fd != INVALID_SOCKET) {
+        ++open;
+      }
+    }
+    return open;
   }
 };
 
@@ -331,6 +934,79 @@ static std::ostream &align(std::ostream &io) {
   return io << std::right << std::setw(8);
 }
 
+struct server_load {
+  uint64_t gets;   // get commands processed so far
+  uint64_t items;  // items currently stored
+  uint64_t bytes;  // bytes used by those items
+  uint64_t cpu_us; // user and system CPU time of the server process
+};
+
+static std::vector<server_load> server_stats(memcached_st *memc) {
+  std::vector<server_load> load;
+  memcached_return_t rc;
+  auto stat = memcached_stat(memc, nullptr, &rc);
+  if (stat) {
+    for (auto x = 0u; x < memcached_server_count(memc); ++x) {
+      load.push_back(server_load{
+          stat[x].cmd_get, stat[x].curr_items, stat[x].bytes,
+          uint64_t(stat[x].rusage_user_seconds + stat[x].rusage_system_seconds) * 1000000
+              + stat[x].rusage_user_microseconds + stat[x].rusage_system_microseconds});
+    }
+    memcached_stat_free(memc, stat);
+  }
+  return load;
+}
+
+struct shard_addition {
+  time_format started; // into the test
+  time_format copy_time;
+  unsigned long buckets;
+  uint64_t copied;
+  memcached_return_t rc;
+};
+
+// move the buckets b with b % servers == servers - 1 to the last server
+static shard_addition add_shard(const memcached_st *root, bool live) {
+  shard_addition result{time_format(0), time_format(0), 0, 0, MEMCACHED_SUCCESS};
+  auto memc = memcached_clone(nullptr, root); // shares the bucket map with the test threads
+  if (!memc) {
+    result.rc = MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+    return result;
+  }
+
+  auto servers = memcached_server_count(memc);
+  std::vector<uint32_t> moved;
+  for (auto b = 0u; b < VIRTUAL_BUCKETS; ++b) {
+    if (b % servers == servers - 1) {
+      moved.push_back(b);
+    }
+  }
+  result.buckets = moved.size();
+  result.started = time_clock::now() - test_begin;
+
+  for (auto b : moved) {
+    result.rc = memcached_bucket_migrate(memc, b, servers - 1);
+    if (!memcached_success(result.rc)) {
+      break;
+    }
+  }
+  if (live && memcached_success(result.rc)) {
+    auto copy_start = time_clock::now();
+    result.rc = memcached_bucket_migrate_copy(memc);
+    result.copy_time = time_clock::now() - copy_start;
+  }
+  // a cold cutover flips right away, leaving the items behind on the previous servers
+  for (auto b : moved) {
+    memcached_bucket_migrate_done(memc, b);
+  }
+
+  memcached_bucket_migration_stat_st migration;
+  memcached_bucket_migration_stat(memc, &migration);
+  result.copied = migration.copied;
+  memcached_free(memc);
+  return result;
+}
+
 int main(int argc, char *argv[]) {
   client_options opt{PROGRAM_NAME, PROGRAM_VERSION, PROGRAM_DESCRIPTION};
   auto concurrency = DEFAULT_CONCURRENCY;
@@ -366,11 +1042,37 @@ int main(int argc, char *argv[]) {
       return true;
     };
 
-  opt.add("distribution-mode", 'm', required_argument, "Distribution mode (modulo-hash|consistent|random, default:modulo-hash).")
+  opt.add("meta", 'Y', no_argument,
+          "Use the meta protocol (mg/ms/md/ma/mn) instead of the text protocol.")
+      .apply = [](const client_options &opt_, const client_options::extended_option &ext,
+                  memcached_st *memc) {
+        if (!ext.set) {
+          return true;
+        }
+        if (opt_.isset("binary")) {
+          if (!opt_.isset("quiet")) {
+            std::cerr << "--meta and --binary are mutually exclusive\n";
+          }
+          return false;
+        }
+        if (MEMCACHED_SUCCESS
+            != memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL,
+                                      MEMCACHED_PROTOCOL_META))
+        {
+          if (!opt_.isset("quiet")) {
+            std::cerr << memcached_last_error_message(memc) << "\n";
+          }
+          return false;
+        }
+        return true;
+      };
+
+  opt.add("distribution-mode", 'm', required_argument, "Distribution mode (modulo-hash|consistent|random|jump|rendezvous|maglev|bounded|"
+          "\n\t\tvbucket, default:modulo-hash).")
     .apply =
     [](const client_options &opt_, const client_options::extended_option &ext,
        memcached_st *memc) {
-      auto server_distribution =  MEMCACHED_DISTRIBUTION_MODULA;
+      uint64_t server_distribution =  MEMCACHED_DISTRIBUTION_MODULA;
       std::string mode(ext.arg);
       if (mode == "modulo-hash") {
         server_distribution = MEMCACHED_DISTRIBUTION_MODULA;
@@ -378,6 +1080,30 @@ int main(int argc, char *argv[]) {
         server_distribution = MEMCACHED_DISTRIBUTION_CONSISTENT;
       } else if (mode == "random") {
         server_distribution = MEMCACHED_DISTRIBUTION_RANDOM;
+      } else if (mode == "jump") {
+        server_distribution = MEMCACHED_DISTRIBUTION_JUMP;
+      } else if (mode == "rendezvous") {
+        server_distribution = MEMCACHED_DISTRIBUTION_RENDEZVOUS;
+      } else if (mode == "maglev") {
+        server_distribution = MEMCACHED_DISTRIBUTION_MAGLEV;
+      } else if (mode == "bounded") {
+        server_distribution = MEMCACHED_DISTRIBUTION_BOUNDED_LOAD;
+      } else if (mode == "vbucket") {
+        // with --add-shard the last server starts without buckets
+        auto servers = memcached_server_count(memc) - (opt_.isset("add-shard") ? 1 : 0);
+        std::vector<uint32_t> host_map(VIRTUAL_BUCKETS);
+        for (auto b = 0u; b < VIRTUAL_BUCKETS; ++b) {
+          host_map[b] = servers ? b % servers : 0;
+        }
+        if (MEMCACHED_SUCCESS
+            != memcached_bucket_set(memc, host_map.data(), nullptr, VIRTUAL_BUCKETS, 0))
+        {
+          if (!opt_.isset("quiet")) {
+            std::cerr << memcached_last_error_message(memc) << "\n";
+          }
+          return false;
+        }
+        return true;
       }
       if (MEMCACHED_SUCCESS != memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_DISTRIBUTION, server_distribution)){
         if (!opt_.isset("quiet")) {
@@ -388,6 +1114,193 @@ int main(int argc, char *argv[]) {
       return true;
     };
 
+  opt.add("load-bound", 'a', required_argument,
+          "Let no server take more than (1 + epsilon) times the average load with"
+          "\n\t\t--distribution-mode=bounded (default: 0.25).")
+      .apply = [](const client_options &opt_, const client_options::extended_option &ext,
+                  memcached_st *memc) {
+        if (ext.arg && *ext.arg) {
+          if (MEMCACHED_SUCCESS != memcached_set_bounded_load(memc, std::stod(ext.arg))) {
+            if (!opt_.isset("quiet")) {
+              std::cerr << memcached_last_error_message(memc) << "\n";
+            }
+            return false;
+          }
+        }
+        return true;
+      };
+
+  opt.add("add-shard", 'g', required_argument,
+          "With --distribution-mode=vbucket, give the last server its share of buckets during"
+          "\n\t\tthe test, migrating them live or in a cold cutover (live|cold).")
+      .apply = [](const client_options &opt_, const client_options::extended_option &ext,
+                  memcached_st *memc) {
+        std::string mode(ext.arg ? ext.arg : "");
+        if (mode != "live" && mode != "cold") {
+          if (!opt_.isset("quiet")) {
+            std::cerr << "Invalid shard addition: " << mode << "\n";
+          }
+          return false;
+        }
+        if (memcached_server_count(memc) < 2) {
+          if (!opt_.isset("quiet")) {
+            std::cerr << "Adding a shard needs at least 2 servers\n";
+          }
+          return false;
+        }
+        return true;
+      };
+  opt.add("add-shard-after", 'i', required_argument,
+          "Milliseconds into the test after which the shard is added (default: 1000).")
+      .apply = wrap_stoul(add_shard_after);
+
+  opt.add("zipf", 'z', required_argument,
+          "Draw keys from a Zipf distribution with the given exponent (default: uniform).")
+      .apply = [](const client_options &opt_, const client_options::extended_option &ext,
+                  memcached_st *) {
+        if (ext.arg && *ext.arg) {
+          zipf_exponent = std::stod(ext.arg);
+          if (zipf_exponent < 0) {
+            if (!opt_.isset("quiet")) {
+              std::cerr << "Invalid Zipf exponent: " << ext.arg << "\n";
+            }
+            return false;
+          }
+        }
+        return true;
+      };
+  opt.add("hot-key-replicas", 'K', required_argument,
+          "Replicate hot keys to this many additional servers (default: 0, disabled).")
+      .apply = wrap_stoul(hot_key_replicas);
+  opt.add("hot-key-threshold", 'T', required_argument,
+          "Reads per window after which a key is considered hot (default: 64).")
+      .apply = wrap_stoul(hot_key_threshold);
+
+  opt.add("compress", 'C', required_argument,
+          "Compress values of at least this many bytes (default: 0, disabled).")
+      .apply = [](const client_options &opt_, const client_options::extended_option &ext,
+                  memcached_st *memc) {
+        if (ext.arg && *ext.arg) {
+          if (MEMCACHED_SUCCESS
+              != memcached_set_compression(memc, std::stoul(ext.arg),
+                                           MEMCACHED_COMPRESSION_LEVEL_DEFAULT))
+          {
+            if (!opt_.isset("quiet")) {
+              std::cerr << memcached_last_error_message(memc) << "\n";
+            }
+            return false;
+          }
+        }
+        return true;
+      };
+
+  opt.add("replicas", 'r', required_argument,
+          "Store every key on this many additional servers and read it from the least loaded"
+          "\n\t\tcopy (binary protocol only, default: 0).")
+      .apply = [](const client_options &opt_, const client_options::extended_option &ext,
+                  memcached_st *memc) {
+        if (ext.arg && *ext.arg) {
+          auto replicas = std::stoul(ext.arg);
+          if (MEMCACHED_SUCCESS
+                  != memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS, replicas)
+              || MEMCACHED_SUCCESS != memcached_set_replica_reads(memc, replicas > 0))
+          {
+            if (!opt_.isset("quiet")) {
+              std::cerr << memcached_last_error_message(memc) << "\n";
+            }
+            return false;
+          }
+        }
+        return true;
+      };
+  opt.add("hedge", 'E', required_argument,
+          "Hedge gets to a replica once the primary is slower than this latency percentile"
+          "\n\t\t(e.g. 95, requires --replicas; default: 0, disabled).")
+      .apply = [](const client_options &opt_, const client_options::extended_option &ext,
+                  memcached_st *memc) {
+        if (ext.arg && *ext.arg) {
+          if (MEMCACHED_SUCCESS != memcached_set_hedging(memc, std::stoul(ext.arg))) {
+            if (!opt_.isset("quiet")) {
+              std::cerr << memcached_last_error_message(memc) << "\n";
+            }
+            return false;
+          }
+        }
+        return true;
+      };
+
+  opt.add("epoll", 'y', no_argument,
+          "Wait for server responses with epoll instead of poll().")
+      .apply = [](const client_options &opt_, const client_options::extended_option &ext,
+                  memcached_st *memc) {
+        // also with poll(), so that its calls are counted
+        if (MEMCACHED_SUCCESS != memcached_set_epoll(memc, ext.set)) {
+          if (!opt_.isset("quiet")) {
+            std::cerr << memcached_last_error_message(memc) << "\n";
+          }
+          return false;
+        }
+        return true;
+      };
+
+  opt.add("zero-copy", 'Z', required_argument,
+          "Read cache hits into a buffer of the thread with memcached_get_into(), or look at"
+          "\n\t\tthem in place with memcached_get_view(), instead of memcached_get() (into|view).")
+      .apply = [](const client_options &opt_, const client_options::extended_option &ext,
+                  memcached_st *) {
+        if (!ext.set) {
+          return true;
+        }
+        std::string mode(ext.arg ? ext.arg : "");
+        if (mode == "into") {
+          value_api = get_api::into;
+        } else if (mode == "view") {
+          value_api = get_api::view;
+        } else {
+          if (!opt_.isset("quiet")) {
+            std::cerr << "Invalid zero-copy mode: " << mode << "\n";
+          }
+          return false;
+        }
+        return true;
+      };
+
+  opt.add("pool-allocator", 'M', no_argument,
+          "Let libmemcached allocate from thread-local size-class pools instead of malloc().");
+
+  opt.add("depth", 'Q', required_argument,
+          "Keep up to this many asynchronous gets and sets in flight per server connection,"
+          "\n\t\twith --binary or --meta (default: 0, one blocking get at a time).")
+      .apply = [](const client_options &opt_, const client_options::extended_option &ext,
+                  memcached_st *memc) {
+        if (!ext.set) {
+          return true;
+        }
+        pipeline_depth = std::stoul(ext.arg ? ext.arg : "0");
+        if (MEMCACHED_SUCCESS != memcached_async_set_depth(memc, uint32_t(pipeline_depth))) {
+          if (!opt_.isset("quiet")) {
+            std::cerr << "Invalid pipeline depth: " << ext.arg << "\n";
+          }
+          return false;
+        }
+        return true;
+      };
+
+  opt.add("multiplex", 'x', no_argument,
+          "Share one connection per server among all threads instead of a clone of the handle"
+          "\n\t\tper thread, with --binary or --meta.");
+
+  opt.add("read-through", 'j', required_argument,
+          "Let libmemcached load misses from the database, fetching this many keys per request"
+          "\n\t\t(1 uses memcached_get; default: 0, cache-aside in memslap).")
+      .apply = wrap_stoul(read_through_batch);
+
+  opt.add("warm-from-snapshot", 'w', required_argument,
+          "Warm up the cache from a snapshot file written by memsnap instead of the database.");
+
+  opt.add("shard-affine", 'A', no_argument,
+          "Each thread connects only to every concurrency-th server, and the other threads hand"
+          "\n\t\tit the gets of keys on those servers.");
   opt.add("output", 'o', required_argument, "Output csv file (default: stdout).");
   opt.add("flush", 'F', no_argument, "Flush all servers prior test.");
   opt.add("test", 't', required_argument, "Test to perform (options: get,mget,set; default: get).");
@@ -414,11 +1327,89 @@ int main(int argc, char *argv[]) {
     exit(EXIT_FAILURE);
   }
 
+  // counted per thread, clones take the allocators along; decided before the handle
+  // allocates anything, as pool blocks cannot be freed by free() and vice versa
+  pool_allocator = opt.isset("pool-allocator");
+  memcached_set_memory_allocators(&memc, counting_malloc, counting_free, counting_realloc,
+                                  counting_calloc, nullptr);
+
   if (!opt.apply(&memc)) {
     memcached_free(&memc);
     exit(EXIT_FAILURE);
   }
 
+  if (opt.isset("add-shard")
+      && memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_DISTRIBUTION)
+             != MEMCACHED_DISTRIBUTION_VIRTUAL_BUCKET)
+  {
+    if (!opt.isset("quiet")) {
+      std::cerr << "--add-shard needs --distribution-mode=vbucket\n";
+    }
+    memcached_free(&memc);
+    exit(EXIT_FAILURE);
+  }
+
+  if (opt.isset("shard-affine") && read_through_batch) {
+    if (!opt.isset("quiet")) {
+      std::cerr << "--shard-affine does not support --read-through\n";
+    }
+    memcached_free(&memc);
+    exit(EXIT_FAILURE);
+  }
+
+  if (pipeline_depth
+      && (memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL)
+              == MEMCACHED_PROTOCOL_TEXT
+          || opt.isset("udp")))
+  {
+    if (!opt.isset("quiet")) {
+      std::cerr << "--depth needs --binary or --meta over TCP\n";
+    }
+    memcached_free(&memc);
+    exit(EXIT_FAILURE);
+  }
+
+  if (pipeline_depth && (read_through_batch || opt.isset("shard-affine") || hot_key_replicas)) {
+    if (!opt.isset("quiet")) {
+      std::cerr << "--depth does not support --read-through, --shard-affine or --hot-key-replicas\n";
+    }
+    memcached_free(&memc);
+    exit(EXIT_FAILURE);
+  }
+
+  if (opt.isset("udp")
+      && (memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL)
+              != MEMCACHED_PROTOCOL_TEXT
+          || opt.isset("multiplex")))
+  {
+    if (!opt.isset("quiet")) {
+      std::cerr << "--udp needs the text protocol and does not support --multiplex\n";
+    }
+    memcached_free(&memc);
+    exit(EXIT_FAILURE);
+  }
+
+  if (opt.isset("multiplex")) {
+    if (pipeline_depth || read_through_batch || opt.isset("shard-affine") || hot_key_replicas
+        || opt.isset("zero-copy"))
+    {
+      if (!opt.isset("quiet")) {
+        std::cerr << "--multiplex does not support --depth, --read-through, --shard-affine,"
+                     " --hot-key-replicas or --zero-copy\n";
+      }
+      memcached_free(&memc);
+      exit(EXIT_FAILURE);
+    }
+    mux = memcached_mux_create(&memc);
+    if (!mux) {
+      if (!opt.isset("quiet")) {
+        std::cerr << "--multiplex needs --binary or --meta\n";
+      }
+      memcached_free(&memc);
+      exit(EXIT_FAILURE);
+    }
+  }
+
   if (opt.has("output")) {
     output_filename = opt.get("output").arg;
     if (opt.isset("verbose")) {
@@ -429,10 +1420,47 @@ int main(int argc, char *argv[]) {
   std::string distribution_mode;
   if (opt.has("distribution-mode")) {
     distribution_mode = opt.get("distribution-mode").arg;
-    if (opt.isset("verbose")) {
-      std::cout << "Distribution mode: " << distribution_mode << std::endl;
+    if (distribution_mode == "bounded") {
+      // tell the epsilon values of a sweep apart in the CSV
+      std::ostringstream mode;
+      mode << distribution_mode << "-" << memcached_get_bounded_load(&memc);
+      distribution_mode = mode.str();
     }
   }
+  if (opt.isset("shard-affine")) {
+    distribution_mode += "-affine";
+  }
+  if (auto replicas = memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS)) {
+    distribution_mode += "-r" + std::to_string(replicas);
+  }
+  auto protocol = memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL);
+  if (protocol == MEMCACHED_PROTOCOL_META) {
+    distribution_mode += "-meta";
+  } else if (protocol == MEMCACHED_PROTOCOL_BINARY
+             && !memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS)) {
+    distribution_mode += "-binary";
+  }
+  if (opt.isset("epoll")) {
+    distribution_mode += "-epoll";
+  }
+  if (opt.isset("zero-copy")) {
+    distribution_mode += value_api == get_api::into ? "-into" : "-view";
+  }
+  if (pool_allocator) {
+    distribution_mode += "-pool";
+  }
+  if (pipeline_depth) {
+    distribution_mode += "-d" + std::to_string(pipeline_depth);
+  }
+  if (mux) {
+    distribution_mode += "-mux";
+  }
+  if (opt.isset("udp")) {
+    distribution_mode += "-udp";
+  }
+  if (opt.isset("verbose") && !distribution_mode.empty()) {
+    std::cout << "Distribution mode: " << distribution_mode << std::endl;
+  }
 
   std::ostream *output = nullptr; // Pointer to an output stream
   std::ofstream outFile;             // File stream for writing to a file
@@ -496,10 +1524,14 @@ int main(int argc, char *argv[]) {
     std::cout << "- Starting " << concurrency << " threads ...\n";
   }
   auto thread_start = time_clock::now();
+  std::unique_ptr<shard_router> router;
+  if (opt.isset("shard-affine")) {
+    router.reset(new shard_router(concurrency));
+  }
   std::vector<thread_context *> threads{};
   threads.reserve(concurrency);
   for (auto i = 0ul; i < concurrency; ++i) {
-    auto t = new thread_context(opt, memc, kv);
+    auto t = new thread_context(opt, memc, kv, i, router.get());
     if (!t->init()) {
       exit(EXIT_FAILURE);
     }
@@ -519,14 +1551,32 @@ int main(int argc, char *argv[]) {
               << " keys ...\n";
   }
   keyval_start = time_clock::now();
-  for (auto i = 0ul; i < concurrency; ++i) {
-    if (threads[i]->init_cache(concurrency, i) < 0) {
+  if (opt.isset("warm-from-snapshot")) {
+    std::ifstream snapshot{opt.argof("warm-from-snapshot"), std::ios::binary};
+    snapshot_stats loaded;
+    auto rc = snapshot ? snapshot_restore(&memc, snapshot, loaded) : MEMCACHED_ERRNO;
+    if (!memcached_success(rc)) {
       if (!opt.isset("quiet")) {
-        std::cerr << "Failed to warmup cache at thread " << i << " out of " << concurrency << "threads\n";
+        std::cerr << "Failed to warmup cache from snapshot " << opt.argof("warm-from-snapshot")
+                  << ": " << memcached_strerror(&memc, rc) << "\n";
       }
       memcached_free(&memc);
       exit(EXIT_FAILURE);
-  }
+    }
+    if (opt.isset("verbose")) {
+      std::cout << "- Restored " << loaded.items << " items (" << loaded.bytes
+                << " bytes) from snapshot\n";
+    }
+  } else {
+    for (auto i = 0ul; i < concurrency; ++i) {
+      if (threads[i]->init_cache(concurrency, i) < 0) {
+        if (!opt.isset("quiet")) {
+          std::cerr << "Failed to warmup cache at thread " << i << " out of " << concurrency << "threads\n";
+        }
+        memcached_free(&memc);
+        exit(EXIT_FAILURE);
+      }
+    }
   }
   keyval_elapsed = time_clock::now() - keyval_start;
 
@@ -542,14 +1592,42 @@ int main(int argc, char *argv[]) {
     std::cout << "- Starting test: " << test_count << " x " << opt.argof("test") << " x "
               << concurrency << " ...\n";
   }
+  auto load_before = server_stats(&memc);
   auto count = 0ul;
   auto test_start = time_clock::now();
+  test_begin = test_start;
   wakeup.store(true, std::memory_order_release);
 
+  std::thread shard_thread;
+  shard_addition shard{time_format(0), time_format(0), 0, 0, MEMCACHED_SUCCESS};
+  if (opt.isset("add-shard")) {
+    bool live = std::string(opt.argof("add-shard")) == "live";
+    shard_thread = std::thread([&memc, &shard, live] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(add_shard_after));
+      shard = add_shard(&memc, live);
+    });
+  }
+
   if (!opt.isset("quiet")) {
     std::cout << "--------------------------------------------------------------------\n";
   }
   unsigned long hit_num=0, miss_num=0, i=1;
+  memcached_hotkey_stat_st hotkey{};
+  memcached_compression_stat_st compression{};
+  memcached_hedge_stat_st hedge{};
+  memcached_read_through_stat_st read_through{};
+  memcached_bounded_load_stat_st bounded_load{};
+  memcached_bucket_migration_stat_st migration{};
+  memcached_replica_read_stat_st replica_read{};
+  memcached_epoll_stat_st epoll{};
+  memcached_io_stat_st io{};
+  unsigned long allocations = 0, routed = 0, connections = 0;
+  memcached_buffer_stat_st buffers{};
+  memcached_async_stat_st async{};
+  memcached_udp_stat_st udp{};
+  std::vector<uint32_t> latency;
+  std::vector<timeline_slot> timeline;
+  time_format_us cpu_time{0}, allocator_time{0};
   double retrieved=0.0;
   double cache_lookup_time = 0.0, db_lookup_time = 0.0;
   for (auto &thread : threads) {
@@ -561,6 +1639,61 @@ int main(int argc, char *argv[]) {
     hit_num += stats.hit_num;
     miss_num += stats.miss_num;
     retrieved += (double)stats.retrieved;
+    hotkey.hot_reads += stats.hotkey.hot_reads;
+    hotkey.replica_reads += stats.hotkey.replica_reads;
+    hotkey.replica_fills += stats.hotkey.replica_fills;
+    hotkey.invalidations += stats.hotkey.invalidations;
+    hotkey.hot_keys = std::max(hotkey.hot_keys, stats.hotkey.hot_keys);
+    compression.values_compressed += stats.compression.values_compressed;
+    compression.bytes_in += stats.compression.bytes_in;
+    compression.bytes_out += stats.compression.bytes_out;
+    compression.values_decompressed += stats.compression.values_decompressed;
+    hedge.requests += stats.hedge.requests;
+    hedge.hedged += stats.hedge.hedged;
+    hedge.replica_wins += stats.hedge.replica_wins;
+    hedge.wasted += stats.hedge.wasted;
+    read_through.loads += stats.read_through.loads;
+    read_through.keys_missed += stats.read_through.keys_missed;
+    read_through.keys_loaded += stats.read_through.keys_loaded;
+    bounded_load.requests += stats.bounded_load.requests;
+    bounded_load.overflows += stats.bounded_load.overflows;
+    bounded_load.probes += stats.bounded_load.probes;
+    bounded_load.probe_hits += stats.bounded_load.probe_hits;
+    migration.forward_reads += stats.migration.forward_reads;
+    migration.forward_hits += stats.migration.forward_hits;
+    replica_read.reads += stats.replica_read.reads;
+    replica_read.replica_reads += stats.replica_read.replica_reads;
+    epoll.polls += stats.epoll.polls;
+    epoll.epoll_waits += stats.epoll.epoll_waits;
+    epoll.epoll_ctls += stats.epoll.epoll_ctls;
+    io.sends += stats.io.sends;
+    io.recvs += stats.io.recvs;
+    allocations += stats.allocations;
+    allocator_time += stats.allocator_time;
+    routed += stats.routed;
+    connections += stats.connections;
+    buffers.servers += stats.buffers.servers;
+    buffers.server_bytes += stats.buffers.server_bytes;
+    buffers.read_bytes += stats.buffers.read_bytes;
+    buffers.write_bytes += stats.buffers.write_bytes;
+    buffers.direct_reads += stats.buffers.direct_reads;
+    async.submitted += stats.async.submitted;
+    async.completed += stats.async.completed;
+    async.waits += stats.async.waits;
+    async.polls += stats.async.polls;
+    udp.requests += stats.udp.requests;
+    udp.datagrams_received += stats.udp.datagrams_received;
+    udp.lost += stats.udp.lost;
+    udp.fallback_keys += stats.udp.fallback_keys;
+    if (thread->get_timeline().size() > timeline.size()) {
+      timeline.resize(thread->get_timeline().size());
+    }
+    for (auto x = 0u; x < thread->get_timeline().size(); ++x) {
+      timeline[x].hits += thread->get_timeline()[x].hits;
+      timeline[x].misses += thread->get_timeline()[x].misses;
+    }
+    latency.insert(latency.end(), thread->get_latency().begin(), thread->get_latency().end());
+    cpu_time += stats.cpu_time;
     cache_lookup_time += time_format_us(stats.cache_lookup_duration).count() / stats.hit_num;
     db_lookup_time += time_format_us(stats.total_lookup_duration).count() / stats.retrieved;
 
@@ -575,6 +1708,9 @@ int main(int argc, char *argv[]) {
 
     delete thread;
   }
+  if (shard_thread.joinable()) {
+    shard_thread.join();
+  }
   cache_lookup_time /= concurrency;
   db_lookup_time /= concurrency;
   auto test_elapsed = time_clock::now() - test_start;
@@ -589,8 +1725,222 @@ int main(int argc, char *argv[]) {
               << "%), #miss="  << miss_num << " (rate=" << float(miss_num*100)/float(retrieved)
               << "%), #avg_cache_lookup_time="  << cache_lookup_time
               << "us, #avg_db_lookup_time="  << db_lookup_time
+              << "us, #avg_cpu_time_per_op=" << cpu_time.count() / retrieved
               << "us" << std::endl;
 
+    if (mux) {
+      // the clones of the threads stay closed
+      connections = memcached_server_count(&memc);
+    }
+    std::cout << "Connections: #open=" << connections << " (all-to-all="
+              << concurrency * memcached_server_count(&memc) << ")";
+    if (router) {
+      std::cout << ", #routed=" << routed << " (rate=" << float(routed * 100) / float(retrieved)
+                << "%)";
+    }
+    std::cout << std::endl;
+
+    {
+      auto buffer_bytes = buffers.read_bytes + buffers.write_bytes;
+      std::cout << "Memory: #rss_kb=" << resident_kb() << ", #server_bytes="
+                << buffers.server_bytes << ", #read_buffer_bytes=" << buffers.read_bytes
+                << ", #write_buffer_bytes=" << buffers.write_bytes << " (per connection="
+                << (connections ? double(buffer_bytes) / double(connections) : 0)
+                << "), #direct_reads=" << buffers.direct_reads << std::endl;
+    }
+
+    if (!latency.empty()) {
+      auto percentile = [&latency](double p) {
+        auto nth = latency.begin() + std::min(latency.size() - 1, size_t(p * latency.size()));
+        std::nth_element(latency.begin(), nth, latency.end());
+        return *nth;
+      };
+      std::cout << "Cache lookup latency: #p50=" << percentile(0.5) << "us, #p99="
+                << percentile(0.99) << "us, #p99.9=" << percentile(0.999) << "us" << std::endl;
+    }
+
+    {
+      auto syscalls = epoll.polls + epoll.epoll_waits + epoll.epoll_ctls;
+      std::cout << "Readiness: #poll=" << epoll.polls << ", #epoll_wait=" << epoll.epoll_waits
+                << ", #epoll_ctl=" << epoll.epoll_ctls << " (per request="
+                << (latency.empty() ? 0 : double(syscalls) / double(latency.size())) << ")"
+                << std::endl;
+    }
+
+    {
+      auto syscalls = io.sends + io.recvs + epoll.polls + epoll.epoll_waits + epoll.epoll_ctls;
+      auto cpu_seconds = double(cpu_time.count()) / 1e6;
+      std::cout << "I/O: #send=" << io.sends << ", #recv=" << io.recvs << ", #syscalls_per_request="
+                << (latency.empty() ? 0 : double(syscalls) / double(latency.size()))
+                << ", #ops_per_cpu_second=" << (cpu_seconds > 0 ? retrieved / cpu_seconds : 0)
+                << std::endl;
+    }
+
+    std::cout << "Allocations: #library=" << allocations << " (per request="
+              << (latency.empty() ? 0 : double(allocations) / double(latency.size()))
+              << "), #allocator_us=" << allocator_time.count() << " (per request="
+              << (latency.empty() ? 0 : allocator_time.count() / double(latency.size())) << ")"
+              << std::endl;
+
+    if (pool_allocator) {
+      memcached_pool_stat_st pool;
+      memcached_pool_stat(&pool);
+      std::cout << "Pool: #heaps=" << pool.heaps << ", #allocations=" << pool.allocations
+                << ", #remote_frees=" << pool.remote_frees << ", #large=" << pool.large
+                << ", #slab_bytes=" << pool.slab_bytes << std::endl;
+    }
+
+    if (mux) {
+      memcached_mux_stat_st multiplex;
+      memcached_mux_stat(mux, &multiplex);
+      std::cout << "Multiplex: #requests=" << multiplex.requests << ", #owner_turns="
+                << multiplex.turns << ", #batches=" << multiplex.batches << " (requests per batch="
+                << (multiplex.batches ? double(multiplex.requests) / double(multiplex.batches) : 0)
+                << "), #polls=" << multiplex.polls << std::endl;
+    }
+
+    if (pipeline_depth) {
+      std::cout << "Async: #depth=" << pipeline_depth << ", #submitted=" << async.submitted
+                << ", #completed=" << async.completed << ", #full_waits=" << async.waits
+                << ", #polls=" << async.polls << " (completions per poll="
+                << (async.polls ? double(async.completed) / double(async.polls) : 0) << ")"
+                << std::endl;
+    }
+
+    if (opt.isset("udp")) {
+      std::cout << "UDP: #requests=" << udp.requests << ", #datagrams_received="
+                << udp.datagrams_received << ", #lost=" << udp.lost << " (rate="
+                << (udp.requests ? float(udp.lost * 100) / float(udp.requests) : 0)
+                << "%), #fallback_keys=" << udp.fallback_keys << std::endl;
+    }
+
+    if (read_through_batch) {
+      std::cout << "Read-through: #loads=" << read_through.loads << ", #keys_missed="
+                << read_through.keys_missed << ", #keys_loaded=" << read_through.keys_loaded
+                << ", #avg_keys_per_load="
+                << (read_through.loads ? double(read_through.keys_missed) / double(read_through.loads) : 0)
+                << std::endl;
+    }
+
+    if (memcached_get_hedging(&memc)) {
+      std::cout << "Hedging: #requests=" << hedge.requests << ", #hedged=" << hedge.hedged
+                << " (rate=" << (hedge.requests ? float(hedge.hedged * 100) / float(hedge.requests) : 0)
+                << "%), #replica_wins=" << hedge.replica_wins << ", #wasted=" << hedge.wasted
+                << " (extra load="
+                << (hedge.requests ? float(hedge.wasted * 100) / float(hedge.requests) : 0) << "%)"
+                << std::endl;
+    }
+
+    if (memcached_get_replica_reads(&memc)) {
+      std::cout << "Replica reads: #replicas="
+                << memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS)
+                << ", #reads=" << replica_read.reads << ", #replica_reads="
+                << replica_read.replica_reads << " (rate="
+                << (replica_read.reads ? float(replica_read.replica_reads * 100) / float(replica_read.reads) : 0)
+                << "%)" << std::endl;
+    }
+
+    if (memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_DISTRIBUTION)
+        == MEMCACHED_DISTRIBUTION_BOUNDED_LOAD)
+    {
+      std::cout << "Bounded loads: #epsilon=" << memcached_get_bounded_load(&memc)
+                << ", #requests=" << bounded_load.requests << ", #overflows=" << bounded_load.overflows
+                << " (remapped="
+                << (bounded_load.requests ? float(bounded_load.overflows * 100) / float(bounded_load.requests) : 0)
+                << "%), #probes=" << bounded_load.probes << ", #probe_hits=" << bounded_load.probe_hits
+                << std::endl;
+    }
+
+    if (opt.isset("add-shard")) {
+      auto rate = [](const timeline_slot &slot) {
+        return slot.hits + slot.misses ? float(slot.hits * 100) / float(slot.hits + slot.misses) : 0;
+      };
+      auto added = size_t(shard.started.count() * 1000 / TIMELINE_INTERVAL_MS);
+      timeline_slot before{0, 0};
+      for (auto x = 0u; x < std::min(added, timeline.size()); ++x) {
+        before.hits += timeline[x].hits;
+        before.misses += timeline[x].misses;
+      }
+      // lowest hit rate after the addition, and when it is back within one point of before
+      float lowest = 100;
+      long recovered = -1;
+      for (auto x = added; x < timeline.size(); ++x) {
+        lowest = std::min(lowest, rate(timeline[x]));
+        if (recovered < 0 && x > added && rate(timeline[x]) >= rate(before) - 1) {
+          recovered = long(x - added) * TIMELINE_INTERVAL_MS;
+        }
+      }
+
+      std::cout << "Shard addition (" << opt.argof("add-shard") << "): #buckets=" << shard.buckets
+                << ", #at=" << shard.started.count() << "s, #copied=" << shard.copied
+                << ", #copy_time=" << shard.copy_time.count() << "s, #forward_reads="
+                << migration.forward_reads << ", #forward_hits=" << migration.forward_hits;
+      if (!memcached_success(shard.rc)) {
+        std::cout << ", #error=" << memcached_strerror(&memc, shard.rc);
+      }
+      std::cout << "\nHit rate around the addition: #before=" << rate(before)
+                << "%, #lowest_after=" << lowest << "%, #recovered_after=";
+      if (recovered < 0) {
+        std::cout << "never";
+      } else {
+        std::cout << recovered << "ms";
+      }
+      std::cout << "\nHit rate per " << TIMELINE_INTERVAL_MS << "ms (| marks the addition):";
+      for (auto x = 0u; x < timeline.size(); ++x) {
+        std::cout << (x == added ? " | " : " ") << std::setprecision(1) << rate(timeline[x]);
+      }
+      std::cout << std::setprecision(6) << std::endl;
+    }
+
+    if (memcached_get_compression_threshold(&memc)) {
+      std::cout << "Compression: #compressed=" << compression.values_compressed
+                << ", #decompressed=" << compression.values_decompressed << ", #ratio="
+                << (compression.bytes_out ? double(compression.bytes_in) / double(compression.bytes_out) : 1.0)
+                << std::endl;
+    }
+
+    if (hot_key_replicas) {
+      std::cout << "Hot keys: #hot_keys=" << hotkey.hot_keys << ", #hot_reads=" << hotkey.hot_reads
+                << ", #replica_reads=" << hotkey.replica_reads << ", #replica_fills="
+                << hotkey.replica_fills << ", #invalidations=" << hotkey.invalidations << std::endl;
+    }
+
+    auto load_after = server_stats(&memc);
+    if (!load_before.empty() && load_after.size() == load_before.size()) {
+      std::vector<uint64_t> gets_after(load_after.size());
+      uint64_t total = 0, max = 0, items = 0, bytes = 0, cpu_us = 0;
+      for (auto x = 0u; x < gets_after.size(); ++x) {
+        gets_after[x] = load_after[x].gets - load_before[x].gets;
+        cpu_us += load_after[x].cpu_us - load_before[x].cpu_us;
+        total += gets_after[x];
+        max = std::max(max, gets_after[x]);
+        items += load_after[x].items;
+        bytes += load_after[x].bytes;
+      }
+      std::cout << "--------------------------------------------------------------------\n"
+                << "Per-server load (get commands):\n";
+      for (auto x = 0u; x < gets_after.size(); ++x) {
+        auto instance = memcached_server_instance_by_position(&memc, x);
+        std::cout << "  " << memcached_server_name(instance) << ":" << memcached_server_port(instance)
+                  << " " << gets_after[x] << " (" << (total ? float(gets_after[x] * 100) / float(total) : 0)
+                  << "%)\n";
+      }
+      if (total) {
+        auto mean = double(total) / double(gets_after.size());
+        auto variance = 0.0;
+        for (auto gets : gets_after) {
+          variance += (double(gets) - mean) * (double(gets) - mean);
+        }
+        variance /= double(gets_after.size());
+        std::cout << "Load imbalance (max/avg): " << double(max) / mean
+                  << ", #stddev/avg=" << std::sqrt(variance) / mean << std::endl;
+      }
+      std::cout << "Cached items: " << items << " (avg "
+                << (items ? double(bytes) / double(items) : 0) << " bytes/item)" << std::endl;
+      std::cout << "Server CPU: #cpu_us=" << cpu_us << " (per get="
+                << (total ? double(cpu_us) / double(total) : 0) << "us)" << std::endl;
+    }
+
     std::cout << "--------------------------------------------------------------------\n"
               << "Time total:                                    " << align << std::setw(12)
               << time_format(time_clock::now() - total_start).count() << " seconds.\n";
@@ -606,6 +1956,7 @@ int main(int argc, char *argv[]) {
   if (outFile.is_open()) {
     outFile.close();
   }
+  memcached_mux_free(mux);
   memcached_free(&memc);
   exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,113 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "libmemcached/mem_config.h"
+
+#define PROGRAM_NAME        "memsnap"
+#define PROGRAM_DESCRIPTION "Save the contents of a memcached cluster to a file, or load it back."
+#define PROGRAM_VERSION     "1.0"
+
+#include "options.hpp"
+#include "checks.hpp"
+#include "time.hpp"
+#include "snapshot.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+int main(int argc, char *argv[]) {
+  client_options opt{PROGRAM_NAME, PROGRAM_VERSION, PROGRAM_DESCRIPTION};
+
+  for (const auto &def : opt.defaults) {
+    // the database options only matter to memslap
+    if (strncmp(def.opt.name, "pg-", 3) && strcmp(def.opt.name, "num-keys")) {
+      opt.add(def);
+    }
+  }
+  opt.add("save", 'S', required_argument, "Write a snapshot of all servers to this file (- for stdout).");
+  opt.add("load", 'L', required_argument, "Load a snapshot from this file (- for stdin) into the servers.");
+
+  if (!opt.parse(argc, argv)) {
+    exit(EXIT_FAILURE);
+  }
+  if (opt.isset("save") == opt.isset("load")) {
+    if (!opt.isset("quiet")) {
+      std::cerr << "Exactly one of --save or --load is required.\n";
+    }
+    exit(EXIT_FAILURE);
+  }
+
+  memcached_st memc;
+  if (!check_memcached(opt, memc)) {
+    exit(EXIT_FAILURE);
+  }
+  if (!opt.apply(&memc)) {
+    memcached_free(&memc);
+    exit(EXIT_FAILURE);
+  }
+
+  snapshot_stats stats;
+  memcached_return_t rc;
+  auto start = time_clock::now();
+
+  if (opt.isset("save")) {
+    std::ofstream file;
+    auto out = check_ostream(opt, opt.argof("save"), file);
+    if (out == &std::cout && strcmp(opt.argof("save"), "-")) {
+      memcached_free(&memc);
+      exit(EXIT_FAILURE);
+    }
+    rc = snapshot_save(&memc, *out, stats);
+  } else {
+    std::ifstream file;
+    auto in = check_istream(opt, opt.argof("load"), file);
+    if (!in) {
+      memcached_free(&memc);
+      exit(EXIT_FAILURE);
+    }
+    rc = snapshot_restore(&memc, *in, stats);
+  }
+
+  auto elapsed = time_clock::now() - start;
+  if (!check_return(opt, memc, rc)) {
+    memcached_free(&memc);
+    exit(EXIT_FAILURE);
+  }
+
+  if (opt.isset("verbose")) {
+    std::cerr << std::fixed << std::setprecision(3)
+              << (opt.isset("save") ? "Saved " : "Loaded ") << stats.items << " items ("
+              << stats.bytes << " bytes) in " << time_format(elapsed).count() << " seconds.\n";
+    if (stats.missing) {
+      std::cerr << stats.missing << " keys expired or were evicted while saving.\n";
+    }
+    if (stats.expired) {
+      std::cerr << stats.expired << " items had expired and were not loaded.\n";
+    }
+  }
+
+  memcached_free(&memc);
+
+  // a slab class with more keys than fit into the output of stats cachedump
+  if (stats.unlisted) {
+    if (!opt.isset("quiet")) {
+      std::cerr << "Incomplete snapshot: " << stats.unlisted
+                << " items were not listed by the servers' stats cachedump.\n";
+    }
+    exit(EXIT_FAILURE);
+  }
+  exit(EXIT_SUCCESS);
+}
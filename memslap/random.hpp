@@ -16,7 +16,10 @@
 #pragma once
 
 #include "time.hpp"
+#include <algorithm>
+#include <cmath>
 #include <random>
+#include <vector>
 #undef max
 
 class random64 {
@@ -43,3 +46,31 @@ private:
   std::mt19937_64 gen;
   std::uniform_int_distribution<typ> dst;
 };
+
+class zipf64 {
+public:
+  zipf64(size_t num, double exponent)
+  : rnd{}
+  , cdf(num)
+  {
+    double sum = 0;
+    for (auto i = 0ul; i < num; ++i) {
+      sum += 1.0 / std::pow(double(i + 1), exponent);
+      cdf[i] = sum;
+    }
+    for (auto &c : cdf) {
+      c /= sum;
+    }
+  }
+
+  // rank 0 is the most popular item
+  size_t operator()() {
+    double u = double(rnd() >> 11) / 9007199254740992.0; // 2^53
+    auto it = std::lower_bound(cdf.begin(), cdf.end(), u);
+    return it == cdf.end() ? cdf.size() - 1 : it - cdf.begin();
+  }
+
+private:
+  random64 rnd;
+  std::vector<double> cdf;
+};
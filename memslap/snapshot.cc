@@ -0,0 +1,283 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#include "snapshot.hpp"
+
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// longest expiration memcached takes as relative to now, longer ones are unix times
+#define SNAPSHOT_RELATIVE_EXPIRATION_MAX (60 * 60 * 24 * 30)
+
+static void put32(std::ostream &out, uint32_t value) {
+  value = htonl(value);
+  out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void put64(std::ostream &out, uint64_t value) {
+  put32(out, uint32_t(value >> 32));
+  put32(out, uint32_t(value));
+}
+
+static bool get32(std::istream &in, uint32_t &value) {
+  if (!in.read(reinterpret_cast<char *>(&value), sizeof(value))) {
+    return false;
+  }
+  value = ntohl(value);
+  return true;
+}
+
+static bool get64(std::istream &in, uint64_t &value) {
+  uint32_t hi, lo;
+  if (!get32(in, hi) || !get32(in, lo)) {
+    return false;
+  }
+  value = (uint64_t(hi) << 32) | lo;
+  return true;
+}
+
+typedef std::pair<uint32_t, uint32_t> server_slab;
+
+struct dump_context {
+  memcached_st *memc;
+  std::ostream &out;
+  snapshot_stats &stats;
+  std::unordered_map<std::string, uint64_t> keys; // of the batch, with their expiration
+  std::map<server_slab, unsigned long> listed;
+};
+
+static memcached_return_t fetch_batch(dump_context &ctx) {
+  if (ctx.keys.empty()) {
+    return MEMCACHED_SUCCESS;
+  }
+
+  std::vector<const char *> key;
+  std::vector<size_t> len;
+  key.reserve(ctx.keys.size());
+  len.reserve(ctx.keys.size());
+  for (const auto &batched : ctx.keys) {
+    key.push_back(batched.first.data());
+    len.push_back(batched.first.size());
+  }
+
+  auto rc = memcached_mget(ctx.memc, key.data(), len.data(), key.size());
+  if (!memcached_success(rc)) {
+    return rc;
+  }
+
+  memcached_result_st result;
+  if (!memcached_result_create(ctx.memc, &result)) {
+    return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+  }
+
+  auto fetched = 0ul;
+  auto now = uint64_t(time(nullptr));
+  while (memcached_fetch_result(ctx.memc, &result, &rc)) {
+    auto klen = memcached_result_key_length(&result);
+    auto vlen = memcached_result_length(&result);
+
+    auto found = ctx.keys.find(std::string(memcached_result_key_value(&result), klen));
+    auto expiration = found == ctx.keys.end() ? 0 : found->second;
+    if (expiration <= now) {
+      // it was still there: older servers print their start time for items without expiration
+      expiration = 0;
+    }
+
+    ctx.out.put(char(klen));
+    put32(ctx.out, memcached_result_flags(&result));
+    put32(ctx.out, uint32_t(vlen));
+    put64(ctx.out, expiration);
+    ctx.out.write(memcached_result_key_value(&result), klen);
+    ctx.out.write(memcached_result_value(&result), vlen);
+
+    ++fetched;
+    ctx.stats.bytes += vlen;
+  }
+  memcached_result_free(&result);
+
+  ctx.stats.items += fetched;
+  ctx.stats.missing += ctx.keys.size() - fetched;
+  ctx.keys.clear();
+
+  if (!ctx.out) {
+    return MEMCACHED_ERRNO;
+  }
+  return rc == MEMCACHED_END || rc == MEMCACHED_NOTFOUND ? MEMCACHED_SUCCESS : rc;
+}
+
+static memcached_return_t dump_item(const memcached_st *, const memcached_dump_item_st *item,
+                                    void *context) {
+  auto &ctx = *static_cast<dump_context *>(context);
+
+  ++ctx.listed[server_slab(item->server_key, item->slab)];
+  ctx.keys[std::string(item->key, item->key_length)] = uint64_t(item->expiration);
+  if (ctx.keys.size() < SNAPSHOT_BATCH_SIZE) {
+    return MEMCACHED_SUCCESS;
+  }
+  return fetch_batch(ctx);
+}
+
+struct count_context {
+  memcached_st *memc;
+  std::map<server_slab, unsigned long> counted;
+};
+
+// "items:<slab>:number" of stats items, per server
+static memcached_return_t count_items(const memcached_instance_st *server, const char *key,
+                                     size_t key_length, const char *value, size_t,
+                                     void *context) {
+  auto &ctx = *static_cast<count_context *>(context);
+  unsigned slab;
+  int end = 0;
+  if (sscanf(std::string(key, key_length).c_str(), "items:%u:number%n", &slab, &end) != 1
+      || size_t(end) != key_length) {
+    return MEMCACHED_SUCCESS;
+  }
+
+  for (auto x = 0u; x < memcached_server_count(ctx.memc); ++x) {
+    if (memcached_server_instance_by_position(ctx.memc, x) == server) {
+      ctx.counted[server_slab(x, slab)] += strtoul(value, nullptr, 10);
+      break;
+    }
+  }
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t snapshot_save(memcached_st *memc, std::ostream &out, snapshot_stats &stats) {
+  stats = snapshot_stats{0, 0, 0, 0, 0};
+
+  // memcached_dump_items() only speaks the text protocol and keeps its connections busy
+  auto dumper = memcached_clone(nullptr, memc);
+  if (!dumper) {
+    return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+  }
+  memcached_behavior_set(dumper, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, 0);
+
+  // what the servers hold, to tell which slabs cachedump listed only in part
+  count_context counts{dumper, {}};
+  auto rc = memcached_stat_execute(dumper, "items", count_items, &counts);
+  if (!memcached_success(rc)) {
+    memcached_free(dumper);
+    return rc;
+  }
+
+  out.write(SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC));
+
+  dump_context ctx{memc, out, stats, {}, {}};
+  ctx.keys.reserve(SNAPSHOT_BATCH_SIZE);
+
+  rc = memcached_dump_items(dumper, dump_item, &ctx);
+  if (memcached_success(rc)) {
+    rc = fetch_batch(ctx);
+  }
+  memcached_free(dumper);
+
+  for (const auto &count : counts.counted) {
+    auto listed = ctx.listed.find(count.first);
+    auto seen = listed == ctx.listed.end() ? 0ul : listed->second;
+    if (count.second > seen) {
+      stats.unlisted += count.second - seen;
+    }
+  }
+
+  out.put(0);
+  put64(out, stats.items);
+  out.flush();
+
+  if (memcached_success(rc) && !out) {
+    return MEMCACHED_ERRNO;
+  }
+  return rc;
+}
+
+memcached_return_t snapshot_restore(memcached_st *memc, std::istream &in, snapshot_stats &stats) {
+  stats = snapshot_stats{0, 0, 0, 0, 0};
+
+  char magic[sizeof(SNAPSHOT_MAGIC) - 1];
+  if (!in.read(magic, sizeof(magic))) {
+    return MEMCACHED_PROTOCOL_ERROR;
+  }
+  bool with_expiration = memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+  if (!with_expiration && memcmp(magic, SNAPSHOT_MAGIC_V1, sizeof(magic))) {
+    return MEMCACHED_PROTOCOL_ERROR;
+  }
+
+  // quiet, buffered sets: nothing is read back until the final flush
+  auto loader = memcached_clone(nullptr, memc);
+  if (!loader) {
+    return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+  }
+  memcached_behavior_set(loader, MEMCACHED_BEHAVIOR_NOREPLY, 1);
+  memcached_behavior_set(loader, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 1);
+
+  auto rc = MEMCACHED_SUCCESS;
+  char key[MEMCACHED_MAX_KEY];
+  std::vector<char> value;
+  uint64_t records = 0;
+
+  while (true) {
+    int key_length = in.get();
+    if (key_length <= 0) {
+      uint64_t items;
+      if (key_length < 0 || !get64(in, items) || items != records) {
+        rc = MEMCACHED_PROTOCOL_ERROR;
+      }
+      break;
+    }
+
+    uint32_t flags, value_length;
+    uint64_t expiration = 0;
+    if (!get32(in, flags) || !get32(in, value_length)
+        || (with_expiration && !get64(in, expiration))) {
+      rc = MEMCACHED_PROTOCOL_ERROR;
+      break;
+    }
+    value.resize(value_length);
+    if (!in.read(key, key_length) || !in.read(value.data(), value_length)) {
+      rc = MEMCACHED_PROTOCOL_ERROR;
+      break;
+    }
+
+    ++records;
+    auto now = uint64_t(time(nullptr));
+    if (expiration && expiration <= now) {
+      ++stats.expired;
+      continue;
+    }
+    // relative while memcached takes it as such, it does not depend on the clocks agreeing then
+    auto ttl = expiration && expiration - now <= SNAPSHOT_RELATIVE_EXPIRATION_MAX
+        ? time_t(expiration - now)
+        : time_t(expiration);
+
+    rc = memcached_set(loader, key, key_length, value.data(), value_length, ttl, flags);
+    if (!memcached_success(rc)) {
+      break;
+    }
+
+    ++stats.items;
+    stats.bytes += value_length;
+  }
+
+  if (memcached_success(rc)) {
+    rc = memcached_flush_buffers(loader);
+  }
+  memcached_free(loader);
+
+  return rc;
+}
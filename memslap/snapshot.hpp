@@ -0,0 +1,60 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+#include "libmemcached/common.h"
+
+#include <iostream>
+
+/*
+ * Snapshot file layout, all integers in network byte order:
+ *
+ *   "MEMSNAP2"
+ *   { uint8 key_length, uint32 flags, uint32 value_length, uint64 expiration, key, value } ...
+ *   uint8 0, uint64 number_of_items
+ *
+ * The expiration is an absolute unix time, 0 for items which never expire.
+ * "MEMSNAP1" snapshots have no expiration field and are loaded without one.
+ */
+#define SNAPSHOT_MAGIC      "MEMSNAP2"
+#define SNAPSHOT_MAGIC_V1   "MEMSNAP1"
+#define SNAPSHOT_BATCH_SIZE 1000ul
+
+struct snapshot_stats {
+  unsigned long items;    // items written or loaded
+  unsigned long bytes;    // value bytes written or loaded
+  unsigned long missing;  // keys dumped but gone by the time they were fetched
+  unsigned long unlisted; // items counted by "stats items" but not listed by "stats cachedump"
+  unsigned long expired;  // items whose expiration passed before they were loaded
+};
+
+/*
+ * Stream the contents of all servers into out. Keys and expirations are
+ * enumerated with memcached_dump_items() on a text protocol clone of memc.
+ * Values are fetched in batches of pipelined multi-gets on memc itself.
+ *
+ * stats cachedump caps its output per slab class, so slabs with many keys are
+ * only partly listed. Such items are counted in stats.unlisted and missing
+ * from the snapshot.
+ */
+memcached_return_t snapshot_save(memcached_st *memc, std::ostream &out, snapshot_stats &stats);
+
+/*
+ * Load a snapshot with buffered quiet sets. Items are routed through the
+ * current distribution of memc, which may differ from the one saved. They
+ * keep their expiration, items which expired since are skipped.
+ */
+memcached_return_t snapshot_restore(memcached_st *memc, std::istream &in, snapshot_stats &stats);
@@ -0,0 +1,83 @@
+/*
+    +--------------------------------------------------------------------+
+    | libmemcached-awesome - C/C++ Client Library for memcached          |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted under the terms of the BSD license.    |
+    | You should have received a copy of the license in a bundled file   |
+    | named LICENSE; in case you did not receive a copy you can review   |
+    | the terms online at: https://opensource.org/licenses/BSD-3-Clause  |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2006-2014 Brian Aker   https://datadifferential.com/ |
+    | Copyright (c) 2020-2021 Michael Wallner        https://awesome.co/ |
+    +--------------------------------------------------------------------+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// bounded lock-free queue between exactly one producer and one consumer thread
+template <typename T>
+class spsc_queue {
+public:
+  // capacity is rounded up to a power of 2
+  explicit spsc_queue(size_t capacity)
+  : slots(round_up(capacity))
+  , mask{slots.size() - 1}
+  , head{0}
+  , tail_cache{0}
+  , tail{0}
+  , head_cache{0}
+  {}
+
+  // producer: false if the queue is full
+  bool push(const T &item) {
+    auto at = tail.load(std::memory_order_relaxed);
+    if (at - head_cache == slots.size()) {
+      head_cache = head.load(std::memory_order_acquire);
+      if (at - head_cache == slots.size()) {
+        return false;
+      }
+    }
+    slots[at & mask] = item;
+    tail.store(at + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer: false if the queue is empty
+  bool pop(T &item) {
+    auto at = head.load(std::memory_order_relaxed);
+    if (at == tail_cache) {
+      tail_cache = tail.load(std::memory_order_acquire);
+      if (at == tail_cache) {
+        return false;
+      }
+    }
+    item = slots[at & mask];
+    head.store(at + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  static size_t round_up(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+  std::vector<T> slots;
+  size_t mask;
+  // the consumer and the producer side each on their own cache line
+  char pad0[64];
+  std::atomic<size_t> head;
+  size_t tail_cache;
+  char pad1[64];
+  std::atomic<size_t> tail;
+  size_t head_cache;
+  char pad2[64];
+};
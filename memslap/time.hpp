@@ -16,6 +16,7 @@
 #pragma once
 
 #include <chrono>
+#include <ctime>
 
 using time_clock = std::chrono::high_resolution_clock;
 using time_point = std::chrono::time_point<time_clock>;
@@ -23,3 +24,10 @@ using time_format = std::chrono::duration<double, std::ratio<1,1>>;
 using time_format_ms = std::chrono::duration<double, std::ratio<1, 1000>>;
 using time_format_us = std::chrono::duration<double, std::ratio<1, 1000000>>;
 using time_format_ns = std::chrono::duration<double, std::ratio<1, 1000000000>>;
+
+// CPU time consumed by the calling thread
+static inline time_format_us thread_cpu_time() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
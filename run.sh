@@ -23,7 +23,7 @@ for i in {1..17}; do
     THREADS=$(($i*3))
     ITERATIONS=$(($EXEC/$THREADS))
 
-    for mode in "modulo-hash" "random"; do
+    for mode in "modulo-hash" "random" "jump" "rendezvous" "maglev"; do
     
         COMMAND="./memslap/memslap -s $SERVERS -F -t get --pg-host=localhost --pg-port=5432 --pg-db=test --pg-user=postgres --pg-pass=test -e $ITERATIONS -k $KEYS -c $THREADS -m $mode -o $OUTPUT"
         echo "$COMMAND"
@@ -31,6 +31,114 @@ for i in {1..17}; do
 
     done
 
+    COMMAND="./memslap/memslap -s $SERVERS -F -t get --pg-host=localhost --pg-port=5432 --pg-db=test --pg-user=postgres --pg-pass=test -e $ITERATIONS -k $KEYS -c $THREADS -m modulo-hash --shard-affine -o $OUTPUT"
+    echo "$COMMAND"
+    $COMMAND
+
+    for replicas in 1 2; do
+
+        COMMAND="./memslap/memslap -s $SERVERS -F -t get --binary --pg-host=localhost --pg-port=5432 --pg-db=test --pg-user=postgres --pg-pass=test -e $ITERATIONS -k $KEYS -c $THREADS -m modulo-hash --replicas=$replicas -o $OUTPUT"
+        echo "$COMMAND"
+        $COMMAND
+
+    done
+
+    for api in "into" "view"; do
+
+        COMMAND="./memslap/memslap -s $SERVERS -F -t get --pg-host=localhost --pg-port=5432 --pg-db=test --pg-user=postgres --pg-pass=test -e $ITERATIONS -k $KEYS -c $THREADS -m modulo-hash --zero-copy=$api -o $OUTPUT"
+        echo "$COMMAND"
+        $COMMAND
+
+    done
+
+    for epsilon in 0.1 0.25 1; do
+
+        COMMAND="./memslap/memslap -s $SERVERS -F -t get --pg-host=localhost --pg-port=5432 --pg-db=test --pg-user=postgres --pg-pass=test -e $ITERATIONS -k $KEYS -c $THREADS -m bounded --load-bound=$epsilon -o $OUTPUT"
+        echo "$COMMAND"
+        $COMMAND
+
+    done
+
+done
+
+# libmemcached allocating from malloc() and from its thread-local pools at 17 servers, 51 threads
+SERVERS="localhost:11211"
+for (( j=2; j<=17; j++ )); do
+    SERVERS="${SERVERS},localhost:$((11210+j))"
+done
+THREADS=$((17*$THREAD_MULTIPLIER))
+ITERATIONS=$(($EXEC/$THREADS))
+
+for allocator in "" "--pool-allocator"; do
+
+    COMMAND="./memslap/memslap -s $SERVERS -F -t get --pg-host=localhost --pg-port=5432 --pg-db=test --pg-user=postgres --pg-pass=test -e $ITERATIONS -k $KEYS -c $THREADS -m modulo-hash $allocator -o $OUTPUT"
+    echo "$COMMAND"
+    $COMMAND
+
+done
+
+# the same workload over the text, binary and meta protocols, with single gets and multi-gets of 16 keys
+for fetch in "" "--read-through=16"; do
+    for protocol in "" "--binary" "--meta"; do
+
+        COMMAND="./memslap/memslap -s $SERVERS -F -t get --pg-host=localhost --pg-port=5432 --pg-db=test --pg-user=postgres --pg-pass=test -e $ITERATIONS -k $KEYS -c $THREADS -m modulo-hash $fetch $protocol -o $OUTPUT"
+        echo "$COMMAND"
+        $COMMAND
+
+    done
+done
+
+# asynchronous gets pipelined up to a depth per connection, over the binary and meta protocols
+for protocol in "--binary" "--meta"; do
+    for depth in 1 4 16 64; do
+
+        COMMAND="./memslap/memslap -s $SERVERS -F -t get --pg-host=localhost --pg-port=5432 --pg-db=test --pg-user=postgres --pg-pass=test -e $ITERATIONS -k $KEYS -c $THREADS -m modulo-hash $protocol --depth=$depth -o $OUTPUT"
+        echo "$COMMAND"
+        $COMMAND
+
+    done
+done
+
+# a clone per thread against one connection per server shared by all threads
+for protocol in "--binary" "--meta"; do
+    for connections in "" "--multiplex"; do
+
+        COMMAND="./memslap/memslap -s $SERVERS -F -t get --pg-host=localhost --pg-port=5432 --pg-db=test --pg-user=postgres --pg-pass=test -e $ITERATIONS -k $KEYS -c $THREADS -m modulo-hash $protocol $connections -o $OUTPUT"
+        echo "$COMMAND"
+        $COMMAND
+
+    done
+done
+
+# gets and multi-gets of 16 keys over TCP and UDP, text protocol
+for fetch in "" "--read-through=16"; do
+    for transport in "" "--udp"; do
+
+        COMMAND="./memslap/memslap -s $SERVERS -F -t get --pg-host=localhost --pg-port=5432 --pg-db=test --pg-user=postgres --pg-pass=test -e $ITERATIONS -k $KEYS -c $THREADS -m modulo-hash $fetch $transport -o $OUTPUT"
+        echo "$COMMAND"
+        $COMMAND
+
+    done
+done
+
+# multi-gets of 16 keys waiting with poll() and with epoll, needs 64 memcached instances
+for i in 1 2 4 8 16 32 64; do
+    SERVERS="localhost:11211"
+    for (( j=2; j<=${i}; j++ )); do
+        SERVERS="${SERVERS},localhost:$((11210+j))"
+    done
+
+    THREADS=$THREAD_MULTIPLIER
+    ITERATIONS=$(($EXEC/$THREADS))
+
+    for epoll in "" "--epoll"; do
+
+        COMMAND="./memslap/memslap -s $SERVERS -F -t get --pg-host=localhost --pg-port=5432 --pg-db=test --pg-user=postgres --pg-pass=test -e $ITERATIONS -k $KEYS -c $THREADS -m modulo-hash --read-through=16 $epoll -o $OUTPUT"
+        echo "$COMMAND"
+        $COMMAND
+
+    done
+
 done
 
 exit 0